@@ -0,0 +1,304 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ClusterLodBuilder.h"
+#include "Meshletizer.h"
+#include "MeshletSort.h"
+#include "MeshSimplifier.h"
+#include "ParallelFor.h"
+
+#include <numeric>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	// A coarser level must have at most this fraction of the triangles of the previous one.
+	const float MaxLevelShrink = 0.9f;
+
+	const XMFLOAT3& GetPosition(const uint8_t* pVertices, uint32_t vertexStride, uint32_t i, uint32_t positionOffset)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(&pVertices[static_cast<size_t>(vertexStride) * i + positionOffset]);
+	}
+
+	// Appends count 2- or 4-byte indices, offset by base, as 32-bit indices.
+	void AppendIndices(vector<uint32_t>& dst, const uint8_t* pSrc, uint32_t indexSize, uint32_t count, uint32_t base)
+	{
+		for (auto i = 0u; i < count; ++i)
+			dst.emplace_back(base + (indexSize == 4 ? reinterpret_cast<const uint32_t*>(pSrc)[i] :
+				reinterpret_cast<const uint16_t*>(pSrc)[i]));
+	}
+
+	void StoreIndices(vector<uint8_t>& dst, const vector<uint32_t>& src, uint32_t indexSize)
+	{
+		dst.resize((src.size() * indexSize + 3) & ~static_cast<size_t>(3)); // Raw buffers are addressed in 4-byte units
+		if (indexSize == 4) memcpy(dst.data(), src.data(), sizeof(uint32_t) * src.size());
+		else
+		{
+			const auto pDst = reinterpret_cast<uint16_t*>(dst.data());
+			for (size_t i = 0; i < src.size(); ++i) pDst[i] = static_cast<uint16_t>(src[i]);
+		}
+	}
+}
+
+ClusterLodBuilder::ClusterLodBuilder(uint32_t maxVerts, uint32_t maxPrims, uint32_t numThreads) :
+	m_maxVerts(maxVerts),
+	m_maxPrims(maxPrims),
+	m_numThreads(numThreads)
+{
+}
+
+ClusterLodBuilder::~ClusterLodBuilder()
+{
+}
+
+bool ClusterLodBuilder::Build(MeshData& mesh, const uint8_t* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+	const uint32_t* pIndices, uint32_t indexCount, uint32_t maxLevelCount, float levelRatio, uint32_t regionTriCount) const
+{
+	if (!pVertices || !pIndices || indexCount == 0 || indexCount % 3) return false;
+	if (maxLevelCount == 0 || levelRatio <= 0.0f || levelRatio >= 1.0f || regionTriCount == 0) return false;
+
+	const auto positionOffset = mesh.AttributeOffsets[Attribute::Position];
+	const auto normalOffset = mesh.AttributeOffsets[Attribute::Normal];
+	if (positionOffset == UINT32_MAX || positionOffset + sizeof(XMFLOAT3) > vertexStride) return false;
+
+	for (auto i = 0u; i < indexCount; ++i) if (pIndices[i] >= vertexCount) return false;
+
+	// Sort the triangles along a Morton curve of their centroids in the mesh bounds.
+	const auto triCount = indexCount / 3;
+	const auto loadCentroid = [&](uint32_t t)
+	{
+		const auto pTri = &pIndices[3 * t];
+
+		return (XMLoadFloat3(&GetPosition(pVertices, vertexStride, pTri[0], positionOffset)) +
+			XMLoadFloat3(&GetPosition(pVertices, vertexStride, pTri[1], positionOffset)) +
+			XMLoadFloat3(&GetPosition(pVertices, vertexStride, pTri[2], positionOffset))) / 3.0f;
+	};
+
+	auto vMin = XMVectorReplicate(FLT_MAX);
+	auto vMax = XMVectorReplicate(-FLT_MAX);
+	for (auto t = 0u; t < triCount; ++t)
+	{
+		const auto centroid = loadCentroid(t);
+		vMin = XMVectorMin(vMin, centroid);
+		vMax = XMVectorMax(vMax, centroid);
+	}
+
+	const auto extent = XMVectorMax(vMax - vMin, XMVectorReplicate(FLT_MIN));
+	vector<uint64_t> keys(triCount);
+	ParallelFor(triCount, 4096, [&](uint32_t begin, uint32_t end)
+	{
+		for (auto t = begin; t < end; ++t)
+			keys[t] = (static_cast<uint64_t>(MortonCode((loadCentroid(t) - vMin) / extent)) << 32) | t;
+	}, m_numThreads);
+	sort(keys.begin(), keys.end());
+
+	vector<uint32_t> triangles(triCount);
+	for (auto p = 0u; p < triCount; ++p) triangles[p] = static_cast<uint32_t>(keys[p]);
+	keys = vector<uint64_t>();
+
+	// Split the curve into regions of about equal triangle counts.
+	const auto regionCount = (triCount + regionTriCount - 1) / regionTriCount;
+	const auto getRegionBegin = [triCount, regionCount](uint32_t r)
+	{
+		return static_cast<uint32_t>(static_cast<uint64_t>(triCount) * r / regionCount);
+	};
+
+	// Lock the vertices at positions that more than one region uses. Positions are compared
+	// rather than indices, so that the vertices split at attribute seams are locked as well.
+	vector<uint8_t> lockedVertices(vertexCount);
+	{
+		const auto lessPosition = [&](uint32_t a, uint32_t b)
+		{
+			const auto& pa = GetPosition(pVertices, vertexStride, a, positionOffset);
+			const auto& pb = GetPosition(pVertices, vertexStride, b, positionOffset);
+
+			return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+		};
+
+		vector<uint32_t> byPosition(vertexCount);
+		iota(byPosition.begin(), byPosition.end(), 0);
+		sort(byPosition.begin(), byPosition.end(), lessPosition);
+
+		vector<uint32_t> positionIds(vertexCount);
+		auto positionCount = 0u;
+		for (auto i = 0u; i < vertexCount; ++i)
+		{
+			if (i > 0 && lessPosition(byPosition[i - 1], byPosition[i])) ++positionCount;
+			positionIds[byPosition[i]] = positionCount;
+		}
+		++positionCount;
+
+		vector<uint32_t> owners(positionCount, UINT32_MAX);
+		vector<uint8_t> shared(positionCount);
+		for (auto r = 0u; r < regionCount; ++r)
+		{
+			for (auto p = getRegionBegin(r); p < getRegionBegin(r + 1); ++p)
+			{
+				for (uint8_t k = 0; k < 3; ++k)
+				{
+					const auto position = positionIds[pIndices[3 * triangles[p] + k]];
+					if (owners[position] == UINT32_MAX) owners[position] = r;
+					else if (owners[position] != r) shared[position] = 1;
+				}
+			}
+		}
+
+		for (auto v = 0u; v < vertexCount; ++v) lockedVertices[v] = shared[positionIds[v]];
+	}
+
+	// Simplify the regions in parallel.
+	vector<Region> regions(regionCount);
+	ParallelFor(regionCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (auto r = begin; r < end; ++r)
+		{
+			const auto first = getRegionBegin(r);
+			buildRegion(regions[r], pVertices, vertexStride, positionOffset, normalOffset, pIndices,
+				&triangles[first], getRegionBegin(r + 1) - first, lockedVertices.data(), maxLevelCount, levelRatio);
+		}
+	}, m_numThreads);
+
+	// Meshletize every level of every region on its own, so that each is one meshlet subset.
+	vector<uint32_t> firstParts(regionCount + 1);
+	for (auto r = 0u; r < regionCount; ++r)
+		firstParts[r + 1] = firstParts[r] + static_cast<uint32_t>(regions[r].Levels.size());
+
+	const auto partCount = firstParts[regionCount];
+	vector<MeshData> parts(partCount);
+	atomic<bool> isFailed(false);
+	ParallelFor(regionCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		const Meshletizer meshletizer(m_maxVerts, m_maxPrims, 1);
+		for (auto r = begin; r < end; ++r)
+		{
+			for (size_t l = 0; l < regions[r].Levels.size(); ++l)
+			{
+				const auto& level = regions[r].Levels[l];
+				auto& part = parts[firstParts[r] + l];
+				copy_n(mesh.AttributeOffsets, static_cast<uint32_t>(Attribute::Count), part.AttributeOffsets);
+				if (!meshletizer.Build(part, level.Vertices.data(), vertexStride,
+					static_cast<uint32_t>(level.Vertices.size() / vertexStride), level.Indices.data(),
+					static_cast<uint32_t>(level.Indices.size())) || part.Meshlets.empty()) isFailed = true;
+			}
+		}
+	}, m_numThreads);
+
+	if (isFailed) return false;
+
+	// Concatenate the parts, region by region and finest level first.
+	vector<uint32_t> indices, uniqueVertexIndices;
+	mesh.VertexStride = vertexStride;
+	mesh.VertexCount = 0;
+	mesh.Vertices.clear();
+	mesh.IndexSubsets.resize(partCount);
+	mesh.MeshletSubsets.resize(partCount);
+	mesh.SubsetLods.resize(partCount);
+	mesh.Meshlets.clear();
+	mesh.PrimitiveIndices.clear();
+	mesh.CullingData.clear();
+	for (auto r = 0u; r < regionCount; ++r)
+	{
+		const auto& region = regions[r];
+		const auto& sphere = region.BoundingSphere;
+		for (size_t l = 0; l < region.Levels.size(); ++l)
+		{
+			const auto p = firstParts[r] + static_cast<uint32_t>(l);
+			const auto& part = parts[p];
+			const auto vertexBase = mesh.VertexCount;
+			const auto uniqueVertexBase = static_cast<uint32_t>(uniqueVertexIndices.size());
+			const auto primBase = static_cast<uint32_t>(mesh.PrimitiveIndices.size());
+
+			mesh.IndexSubsets[p] = { static_cast<uint32_t>(indices.size()), part.IndexCount };
+			mesh.MeshletSubsets[p] = { static_cast<uint32_t>(mesh.Meshlets.size()), static_cast<uint32_t>(part.Meshlets.size()) };
+			mesh.SubsetLods[p] = { XMFLOAT4(sphere.Center.x, sphere.Center.y, sphere.Center.z, sphere.Radius),
+				region.Levels[l].Error, l + 1 < region.Levels.size() ? region.Levels[l + 1].Error : FLT_MAX };
+
+			mesh.Vertices.insert(mesh.Vertices.end(), part.Vertices.cbegin(), part.Vertices.cend());
+			mesh.VertexCount += part.VertexCount;
+			AppendIndices(indices, part.Indices.data(), part.IndexSize, part.IndexCount, vertexBase);
+
+			// The unique vertex indices of a part are padded to 4 bytes, so count them by the meshlets.
+			auto uniqueVertexCount = 0u;
+			for (const auto& meshlet : part.Meshlets) uniqueVertexCount = (max)(meshlet.VertOffset + meshlet.VertCount, uniqueVertexCount);
+			AppendIndices(uniqueVertexIndices, part.UniqueVertexIndices.data(), part.IndexSize, uniqueVertexCount, vertexBase);
+
+			for (auto meshlet : part.Meshlets)
+			{
+				meshlet.VertOffset += uniqueVertexBase;
+				meshlet.PrimOffset += primBase;
+				mesh.Meshlets.emplace_back(meshlet);
+			}
+			mesh.PrimitiveIndices.insert(mesh.PrimitiveIndices.end(), part.PrimitiveIndices.cbegin(), part.PrimitiveIndices.cend());
+			mesh.CullingData.insert(mesh.CullingData.end(), part.CullingData.cbegin(), part.CullingData.cend());
+		}
+	}
+
+	mesh.IndexSize = mesh.VertexCount > 0xffff ? 4 : 2;
+	mesh.IndexCount = static_cast<uint32_t>(indices.size());
+	StoreIndices(mesh.Indices, indices, mesh.IndexSize);
+	mesh.Indices.resize(static_cast<size_t>(mesh.IndexSize) * mesh.IndexCount);
+	StoreIndices(mesh.UniqueVertexIndices, uniqueVertexIndices, mesh.IndexSize);
+
+	return true;
+}
+
+void ClusterLodBuilder::buildRegion(Region& region, const uint8_t* pVertices, uint32_t vertexStride,
+	uint32_t positionOffset, uint32_t normalOffset, const uint32_t* pIndices, const uint32_t* pTriangles,
+	uint32_t triCount, const uint8_t* pLockedVertices, uint32_t maxLevelCount, float levelRatio) const
+{
+	// Gather the vertices of the region into a local vertex buffer.
+	vector<uint32_t> vertexIds(3 * static_cast<size_t>(triCount));
+	for (auto t = 0u; t < triCount; ++t)
+		for (uint8_t k = 0; k < 3; ++k) vertexIds[3 * t + k] = pIndices[3 * pTriangles[t] + k];
+
+	vector<uint32_t> indices(vertexIds);
+	sort(vertexIds.begin(), vertexIds.end());
+	vertexIds.erase(unique(vertexIds.begin(), vertexIds.end()), vertexIds.end());
+	const auto vertexCount = static_cast<uint32_t>(vertexIds.size());
+
+	region.Levels.resize(1);
+	auto& finest = region.Levels[0];
+	finest.Error = 0.0f;
+	finest.Vertices.resize(static_cast<size_t>(vertexStride) * vertexCount);
+	vector<uint8_t> lockedVertices(vertexCount);
+	for (auto i = 0u; i < vertexCount; ++i)
+	{
+		memcpy(&finest.Vertices[static_cast<size_t>(vertexStride) * i],
+			&pVertices[static_cast<size_t>(vertexStride) * vertexIds[i]], vertexStride);
+		lockedVertices[i] = pLockedVertices[vertexIds[i]];
+	}
+
+	for (auto& index : indices) index = static_cast<uint32_t>(lower_bound(vertexIds.cbegin(), vertexIds.cend(), index) - vertexIds.cbegin());
+	finest.Indices = move(indices);
+
+	BoundingSphere::CreateFromPoints(region.BoundingSphere, vertexCount,
+		reinterpret_cast<const XMFLOAT3*>(&finest.Vertices[positionOffset]), vertexStride);
+
+	// Simplify every coarser level from the finest one, so that the error of each level is the
+	// distance that its vertices moved from the original surface.
+	const MeshSimplifier simplifier(1);
+	auto targetTriCount = static_cast<float>(triCount);
+	for (auto l = 1u; l < maxLevelCount; ++l)
+	{
+		targetTriCount *= levelRatio;
+
+		Level level;
+		const auto& source = region.Levels[0];
+		if (!simplifier.Simplify(level.Vertices, level.Indices, source.Vertices.data(), vertexStride, vertexCount,
+			source.Indices.data(), static_cast<uint32_t>(source.Indices.size()), positionOffset, normalOffset,
+			static_cast<uint32_t>(targetTriCount), lockedVertices.data(), &level.Error)) break;
+
+		// Stop where the locked vertices keep the region from meeting the budget or from shrinking.
+		const auto levelTriCount = static_cast<uint32_t>(level.Indices.size() / 3);
+		const auto& prev = region.Levels.back();
+		if (levelTriCount == 0 || levelTriCount > static_cast<uint32_t>(targetTriCount) ||
+			levelTriCount > prev.Indices.size() / 3 * MaxLevelShrink) break;
+
+		// Keep the errors monotonic, which makes exactly one level of the region pass the selection.
+		level.Error = (max)(level.Error, prev.Error);
+		region.Levels.emplace_back(move(level));
+	}
+}
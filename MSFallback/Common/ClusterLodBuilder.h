@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+// Builds cluster LODs for the selection in the AS. The triangles are split along a Morton curve
+// into regions, and each region is simplified into coarser levels on its own, with the vertices
+// it shares with other regions locked, so that neighboring regions meet at any mix of levels.
+// Every level of a region becomes a meshlet subset, whose LodBounds hold the error of the level
+// and of its parent, the next coarser level of the same region.
+class ClusterLodBuilder
+{
+public:
+	ClusterLodBuilder(uint32_t maxVerts, uint32_t maxPrims, uint32_t numThreads = 0);
+	virtual ~ClusterLodBuilder();
+
+	// Builds up to maxLevelCount levels per region, each with about levelRatio times the triangles
+	// of the previous one. A region stops at the level that its locked vertices keep from shrinking.
+	// The caller fills mesh.AttributeOffsets beforehand, as for Meshletizer::Build(); normals are
+	// renormalized in the coarser levels if present.
+	bool Build(MeshData& mesh, const uint8_t* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+		const uint32_t* pIndices, uint32_t indexCount, uint32_t maxLevelCount, float levelRatio,
+		uint32_t regionTriCount = DefaultRegionTriCount) const;
+
+	static const uint32_t DefaultRegionTriCount = 4096;
+
+protected:
+	struct Level
+	{
+		std::vector<uint8_t>	Vertices;
+		std::vector<uint32_t>	Indices;
+		float					Error;
+	};
+
+	struct Region
+	{
+		std::vector<Level>		Levels;
+		DirectX::BoundingSphere	BoundingSphere;
+	};
+
+	void buildRegion(Region& region, const uint8_t* pVertices, uint32_t vertexStride,
+		uint32_t positionOffset, uint32_t normalOffset, const uint32_t* pIndices, const uint32_t* pTriangles,
+		uint32_t triCount, const uint8_t* pLockedVertices, uint32_t maxLevelCount, float levelRatio) const;
+
+	uint32_t m_maxVerts;
+	uint32_t m_maxPrims;
+	uint32_t m_numThreads;
+};
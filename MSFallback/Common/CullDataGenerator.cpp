@@ -0,0 +1,141 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "CullDataGenerator.h"
+#include "ParallelFor.h"
+
+using namespace std;
+using namespace DirectX;
+
+const float CullDataGenerator::MinConeDot = 0.1f;
+
+namespace
+{
+	void SetDegenerate(CullData& cullData)
+	{
+		cullData.NormalCone[0] = cullData.NormalCone[1] = cullData.NormalCone[2] = 0x7f;
+		cullData.NormalCone[3] = 0xff;
+		cullData.ApexOffset = 0.0f;
+	}
+}
+
+CullDataGenerator::CullDataGenerator(uint32_t numThreads) :
+	m_numThreads(numThreads)
+{
+}
+
+CullDataGenerator::~CullDataGenerator()
+{
+}
+
+void CullDataGenerator::Generate(CullData* pCullData, const Meshlet* pMeshlets, uint32_t meshletCount,
+	const uint32_t* pUniqueVertexIndices, const PackedTriangle* pPrimitiveIndices,
+	const uint8_t* pPositions, uint32_t positionStride) const
+{
+	ParallelFor(meshletCount, 256, [&](uint32_t begin, uint32_t end)
+	{
+		vector<XMFLOAT3> positions;
+		vector<XMFLOAT4> normals;
+		for (auto i = begin; i < end; ++i)
+			generate(pCullData[i], pMeshlets[i], pUniqueVertexIndices, pPrimitiveIndices,
+				pPositions, positionStride, positions, normals);
+	}, m_numThreads);
+}
+
+bool CullDataGenerator::Generate(MeshData& mesh) const
+{
+	const auto posOffset = mesh.AttributeOffsets[Attribute::Position];
+	if (posOffset == UINT32_MAX || mesh.Vertices.empty()) return false;
+	if (mesh.IndexSize != 2 && mesh.IndexSize != 4) return false;
+
+	const auto indexCount = mesh.UniqueVertexIndices.size() / mesh.IndexSize;
+	vector<uint32_t> uniqueVertexIndices(indexCount);
+	if (mesh.IndexSize == 4) memcpy(uniqueVertexIndices.data(), mesh.UniqueVertexIndices.data(), sizeof(uint32_t) * indexCount);
+	else
+	{
+		const auto pIndices = reinterpret_cast<const uint16_t*>(mesh.UniqueVertexIndices.data());
+		for (size_t i = 0; i < indexCount; ++i) uniqueVertexIndices[i] = pIndices[i];
+	}
+
+	mesh.CullingData.resize(mesh.Meshlets.size());
+	Generate(mesh.CullingData.data(), mesh.Meshlets.data(), static_cast<uint32_t>(mesh.Meshlets.size()),
+		uniqueVertexIndices.data(), mesh.PrimitiveIndices.data(), &mesh.Vertices[posOffset], mesh.VertexStride);
+
+	return true;
+}
+
+void CullDataGenerator::generate(CullData& cullData, const Meshlet& meshlet, const uint32_t* pUniqueVertexIndices,
+	const PackedTriangle* pPrimitiveIndices, const uint8_t* pPositions, uint32_t positionStride,
+	vector<XMFLOAT3>& positions, vector<XMFLOAT4>& normals) const
+{
+	// Bounding sphere
+	positions.resize(meshlet.VertCount);
+	for (auto i = 0u; i < meshlet.VertCount; ++i)
+	{
+		const auto v = pUniqueVertexIndices[meshlet.VertOffset + i];
+		positions[i] = *reinterpret_cast<const XMFLOAT3*>(&pPositions[static_cast<size_t>(positionStride) * v]);
+	}
+
+	BoundingSphere sphere;
+	BoundingSphere::CreateFromPoints(sphere, meshlet.VertCount, positions.data(), sizeof(XMFLOAT3));
+	cullData.BoundingSphere = XMFLOAT4(sphere.Center.x, sphere.Center.y, sphere.Center.z, sphere.Radius);
+
+	// Outward unit normals of the clockwise triangles; degenerate triangles never face the viewer.
+	normals.clear();
+	for (auto i = 0u; i < meshlet.PrimCount; ++i)
+	{
+		const auto& prim = pPrimitiveIndices[meshlet.PrimOffset + i];
+		const auto p0 = XMLoadFloat3(&positions[prim.i0]);
+		const auto n = XMVector3Cross(XMLoadFloat3(&positions[prim.i1]) - p0, XMLoadFloat3(&positions[prim.i2]) - p0);
+		if (XMVectorGetX(XMVector3LengthSq(n)) <= FLT_MIN) continue;
+
+		// Keep the triangle plane, so that w = dot(p0, normal).
+		const auto normal = XMVector3Normalize(n);
+		normals.emplace_back();
+		XMStoreFloat4(&normals.back(), XMVectorSelect(normal, XMVector3Dot(p0, normal), g_XMSelect1110));
+	}
+
+	if (normals.empty()) return SetDegenerate(cullData);
+
+	// Take the center of the normals' bounding sphere as the cone axis.
+	BoundingSphere normalBounds;
+	BoundingSphere::CreateFromPoints(normalBounds, normals.size(), reinterpret_cast<const XMFLOAT3*>(normals.data()), sizeof(XMFLOAT4));
+	auto axis = XMLoadFloat3(&normalBounds.Center);
+	if (XMVectorGetX(XMVector3LengthSq(axis)) <= FLT_MIN) return SetDegenerate(cullData);
+	axis = XMVector3Normalize(axis);
+
+	// Quantize the axis the same way UnpackCone() decodes it: v / 255 * 2 - 1.
+	XMUINT3 packedAxis;
+	XMStoreUInt3(&packedAxis, XMConvertVectorFloatToUInt(XMVectorRound(
+		XMVectorSaturate(XMVectorMultiplyAdd(axis, g_XMOneHalf, g_XMOneHalf)) * 255.0f), 0));
+	const auto decodedAxis = XMVector3Normalize(XMVectorMultiplyAdd(
+		XMConvertVectorUIntToFloat(XMLoadUInt3(&packedAxis), 0), XMVectorReplicate(2.0f / 255.0f), g_XMNegativeOne));
+
+	// The spread is bounded by the least aligned normal around the decoded axis.
+	auto minDot = g_XMOne.v;
+	for (const auto& normal : normals) minDot = XMVectorMin(minDot, XMVector3Dot(decodedAxis, XMLoadFloat4(&normal)));
+	const auto cosSpread = XMVectorGetX(minDot);
+	if (cosSpread <= MinConeDot) return SetDegenerate(cullData);
+
+	// w = -cos(spread + 90 deg) = sin(spread), rounded up so that a triangle is never culled early.
+	const auto cutoff = ceilf(sqrtf(1.0f - cosSpread * cosSpread) * 255.0f);
+	if (cutoff >= 255.0f) return SetDegenerate(cullData); // 0xff would read as degenerate anyway
+
+	// Offset the apex back along the axis until it lies behind every triangle plane.
+	const auto center = XMLoadFloat3(&sphere.Center);
+	auto maxOffset = 0.0f;
+	for (const auto& plane : normals)
+	{
+		const auto normal = XMLoadFloat4(&plane);
+		const auto dc = XMVectorGetX(XMVector3Dot(center, normal)) - plane.w;
+		const auto dn = XMVectorGetX(XMVector3Dot(decodedAxis, normal)); // > MinConeDot
+		maxOffset = (max)(maxOffset, dc / dn);
+	}
+
+	cullData.NormalCone[0] = static_cast<uint8_t>(packedAxis.x);
+	cullData.NormalCone[1] = static_cast<uint8_t>(packedAxis.y);
+	cullData.NormalCone[2] = static_cast<uint8_t>(packedAxis.z);
+	cullData.NormalCone[3] = static_cast<uint8_t>(cutoff);
+	cullData.ApexOffset = maxOffset;
+}
@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+// Computes per-meshlet CullData for IsVisible() in ASMeshlet.hlsl. Normal cones are
+// quantized exactly as UnpackCone() decodes them, and the cone spread and apex offset
+// are measured against the decoded axis so that culling stays conservative.
+class CullDataGenerator
+{
+public:
+	CullDataGenerator(uint32_t numThreads = 0);
+	virtual ~CullDataGenerator();
+
+	// Triangles are expected in clockwise winding, as the renderer draws them.
+	void Generate(CullData* pCullData, const Meshlet* pMeshlets, uint32_t meshletCount,
+		const uint32_t* pUniqueVertexIndices, const PackedTriangle* pPrimitiveIndices,
+		const uint8_t* pPositions, uint32_t positionStride) const;
+	bool Generate(MeshData& mesh) const;
+
+	// A cone whose spread reaches this close to a hemisphere rarely culls anything.
+	static const float MinConeDot;
+
+protected:
+	void generate(CullData& cullData, const Meshlet& meshlet, const uint32_t* pUniqueVertexIndices,
+		const PackedTriangle* pPrimitiveIndices, const uint8_t* pPositions, uint32_t positionStride,
+		std::vector<DirectX::XMFLOAT3>& positions, std::vector<DirectX::XMFLOAT4>& normals) const;
+
+	uint32_t m_numThreads;
+};
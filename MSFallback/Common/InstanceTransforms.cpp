@@ -0,0 +1,174 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "InstanceTransforms.h"
+#include "ParallelFor.h"
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t MinParallelCount = 1 << 14;	// Fewer dirty instances are not worth spawning threads
+}
+
+InstanceTransforms::InstanceTransforms(uint32_t numThreads) :
+	m_count(0),
+	m_dirtyCount(0),
+	m_numThreads(numThreads)
+{
+}
+
+InstanceTransforms::~InstanceTransforms()
+{
+}
+
+uint32_t InstanceTransforms::Add(const XMFLOAT3& position, const XMFLOAT4& rotation, float scale, uint32_t flags)
+{
+	const auto i = m_count++;
+	if (i % Width == 0)
+	{
+		const auto size = static_cast<size_t>(i) + Width;
+		m_positionX.resize(size);
+		m_positionY.resize(size);
+		m_positionZ.resize(size);
+		m_rotationX.resize(size);
+		m_rotationY.resize(size);
+		m_rotationZ.resize(size);
+		m_rotationW.resize(size);
+		m_scale.resize(size);
+		m_flags.resize(size);
+		m_dirty.resize(size);
+	}
+
+	m_flags[i] = flags;
+	Set(i, position, rotation, scale);
+
+	return i;
+}
+
+void InstanceTransforms::Set(uint32_t i, const XMFLOAT3& position, const XMFLOAT4& rotation, float scale)
+{
+	m_positionX[i] = position.x;
+	m_positionY[i] = position.y;
+	m_positionZ[i] = position.z;
+	m_rotationX[i] = rotation.x;
+	m_rotationY[i] = rotation.y;
+	m_rotationZ[i] = rotation.z;
+	m_rotationW[i] = rotation.w;
+	m_scale[i] = scale;
+	setDirty(i);
+}
+
+uint32_t InstanceTransforms::Update(Instance* pInstances)
+{
+	if (m_dirtyCount == 0) return 0;
+
+	// Update() runs on the render thread every frame, where a few moving instances must not
+	// pay for starting the workers.
+	const auto numThreads = m_dirtyCount < MinParallelCount ? 1 : m_numThreads;
+	const auto batchCount = (m_count + Width - 1) / Width;
+	ParallelFor(batchCount, 256, [&](uint32_t begin, uint32_t end)
+	{
+		for (auto b = begin; b < end; ++b)
+		{
+			const auto base = Width * b;
+			uint32_t dirtyMask;
+			memcpy(&dirtyMask, &m_dirty[base], sizeof(dirtyMask));
+			if (dirtyMask == 0) continue;
+
+			const auto load = [base](const vector<float>& v) { return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&v[base])); };
+			const auto qx = load(m_rotationX);
+			const auto qy = load(m_rotationY);
+			const auto qz = load(m_rotationZ);
+			const auto qw = load(m_rotationW);
+			const auto s = load(m_scale);
+
+			// Rotation matrices of 4 quaternions, laid out as in XMMatrixRotationQuaternion()
+			const auto x2 = qx + qx, y2 = qy + qy, z2 = qz + qz;
+			const auto xx = qx * x2, yy = qy * y2, zz = qz * z2;
+			const auto xy = qx * y2, xz = qx * z2, yz = qy * z2;
+			const auto wx = qw * x2, wy = qw * y2, wz = qw * z2;
+			const XMVECTOR rotation[9] =
+			{
+				g_XMOne - yy - zz, xy + wz, xz - wy,
+				xy - wz, g_XMOne - xx - zz, yz + wx,
+				xz + wy, yz - wx, g_XMOne - xx - yy
+			};
+
+			// The 3x3 block of the world matrix is the rotation times the scale, and that of
+			// its inverse is the transposed rotation over the scale.
+			const auto invScale = XMVectorReciprocal(s);
+			XMFLOAT4A world[9], inverse[9];
+			for (auto k = 0u; k < 9; ++k)
+			{
+				XMStoreFloat4A(&world[k], rotation[k] * s);
+				XMStoreFloat4A(&inverse[k], rotation[k] * invScale);
+			}
+
+			for (auto j = 0u; j < Width; ++j)
+			{
+				const auto i = base + j;
+				if (i >= m_count || !m_dirty[i]) continue;
+
+				// World is stored transposed, and WorldIT as the first 3 rows of the inverse.
+				const auto lane = [j](const XMFLOAT4A& v) { return reinterpret_cast<const float*>(&v)[j]; };
+				auto& instance = pInstances[i];
+				for (auto r = 0u; r < 3; ++r)
+				{
+					for (auto c = 0u; c < 3; ++c)
+					{
+						instance.World.m[r][c] = lane(world[3 * c + r]);
+						instance.WorldIT.m[r][c] = lane(inverse[3 * c + r]);
+					}
+					instance.World.m[3][r] = 0.0f;
+					instance.WorldIT.m[r][3] = 0.0f;
+				}
+				instance.World.m[0][3] = m_positionX[i];
+				instance.World.m[1][3] = m_positionY[i];
+				instance.World.m[2][3] = m_positionZ[i];
+				instance.World.m[3][3] = 1.0f;
+				instance.Scale = m_scale[i];
+				instance.Flags = m_flags[i];
+
+				m_dirty[i] = 0;
+			}
+		}
+	}, numThreads);
+
+	const auto dirtyCount = m_dirtyCount;
+	m_dirtyCount = 0;
+
+	return dirtyCount;
+}
+
+XMMATRIX InstanceTransforms::GetWorld(uint32_t i) const
+{
+	return XMMatrixAffineTransformation(XMVectorReplicate(m_scale[i]), g_XMZero,
+		XMVectorSet(m_rotationX[i], m_rotationY[i], m_rotationZ[i], m_rotationW[i]),
+		XMVectorSet(m_positionX[i], m_positionY[i], m_positionZ[i], 1.0f));
+}
+
+float InstanceTransforms::GetScale(uint32_t i) const
+{
+	return m_scale[i];
+}
+
+uint32_t InstanceTransforms::GetCount() const
+{
+	return m_count;
+}
+
+uint32_t InstanceTransforms::GetDirtyCount() const
+{
+	return m_dirtyCount;
+}
+
+void InstanceTransforms::setDirty(uint32_t i)
+{
+	if (m_dirty[i]) return;
+
+	m_dirty[i] = 1;
+	++m_dirtyCount;
+}
@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+#include "SharedConst.h"
+
+// Transforms of all instances as structure of arrays (position, rotation quaternion and uniform
+// scale), with a dirty flag per instance. Update() only rebuilds the Instance data of the dirty
+// instances, Width instances per DirectXMath vector operation, so static instances cost nothing.
+class InstanceTransforms
+{
+public:
+	InstanceTransforms(uint32_t numThreads = 0);
+	virtual ~InstanceTransforms();
+
+	// Returns the index of the new instance, which starts dirty.
+	uint32_t Add(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT4& rotation, float scale, uint32_t flags);
+	void Set(uint32_t i, const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT4& rotation, float scale);
+
+	// Writes the World, WorldIT, Scale and Flags of the dirty instances to pInstances, indexed
+	// as the transforms, and clears their flags. Returns the number of instances written.
+	uint32_t Update(Instance* pInstances);
+
+	DirectX::XMMATRIX GetWorld(uint32_t i) const;
+	float GetScale(uint32_t i) const;
+	uint32_t GetCount() const;
+	uint32_t GetDirtyCount() const;
+
+	static const uint32_t Width = 4;
+
+protected:
+	void setDirty(uint32_t i);
+
+	// Every array is padded to a multiple of Width entries.
+	std::vector<float>    m_positionX;
+	std::vector<float>    m_positionY;
+	std::vector<float>    m_positionZ;
+	std::vector<float>    m_rotationX;
+	std::vector<float>    m_rotationY;
+	std::vector<float>    m_rotationZ;
+	std::vector<float>    m_rotationW;
+	std::vector<float>    m_scale;
+	std::vector<uint32_t> m_flags;
+	std::vector<uint8_t>  m_dirty;
+
+	uint32_t m_count;
+	uint32_t m_dirtyCount;
+	uint32_t m_numThreads;
+};
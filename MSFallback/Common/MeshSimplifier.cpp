@@ -0,0 +1,197 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "MeshSimplifier.h"
+#include "ParallelFor.h"
+
+#include <unordered_map>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	struct Triangle
+	{
+		uint32_t Indices[3];
+
+		bool operator<(const Triangle& rhs) const
+		{
+			return lexicographical_compare(begin(Indices), end(Indices), begin(rhs.Indices), end(rhs.Indices));
+		}
+
+		bool operator==(const Triangle& rhs) const
+		{
+			return equal(begin(Indices), end(Indices), begin(rhs.Indices));
+		}
+	};
+
+	const XMFLOAT3& GetFloat3(const uint8_t* pVertices, uint32_t vertexStride, uint32_t i, uint32_t offset)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(&pVertices[static_cast<size_t>(vertexStride) * i + offset]);
+	}
+}
+
+MeshSimplifier::MeshSimplifier(uint32_t numThreads) :
+	m_numThreads(numThreads)
+{
+}
+
+MeshSimplifier::~MeshSimplifier()
+{
+}
+
+bool MeshSimplifier::Simplify(vector<uint8_t>& vertices, vector<uint32_t>& indices,
+	const uint8_t* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+	const uint32_t* pIndices, uint32_t indexCount, uint32_t positionOffset,
+	uint32_t normalOffset, uint32_t targetTriCount, const uint8_t* pLockedVertices, float* pMaxError) const
+{
+	if (!pVertices || !pIndices || indexCount % 3) return false;
+	if (positionOffset + sizeof(XMFLOAT3) > vertexStride) return false;
+	if (normalOffset != UINT32_MAX && normalOffset + sizeof(XMFLOAT3) > vertexStride) return false;
+	for (auto i = 0u; i < indexCount; ++i) if (pIndices[i] >= vertexCount) return false;
+
+	if (pMaxError) *pMaxError = 0.0f;
+
+	// Nothing to do if the mesh is already within the budget.
+	if (indexCount / 3 <= targetTriCount)
+	{
+		vertices.assign(pVertices, pVertices + static_cast<size_t>(vertexStride) * vertexCount);
+		indices.assign(pIndices, pIndices + indexCount);
+
+		return true;
+	}
+
+	// Cubic cells over the longest axis of the bounds
+	auto vMin = XMVectorReplicate(FLT_MAX);
+	auto vMax = XMVectorReplicate(-FLT_MAX);
+	for (auto i = 0u; i < vertexCount; ++i)
+	{
+		const auto pos = XMLoadFloat3(&GetFloat3(pVertices, vertexStride, i, positionOffset));
+		vMin = XMVectorMin(vMin, pos);
+		vMax = XMVectorMax(vMax, pos);
+	}
+
+	XMFLOAT3 boundsMin, extent;
+	XMStoreFloat3(&boundsMin, vMin);
+	XMStoreFloat3(&extent, vMax - vMin);
+	const auto maxExtent = (max)((max)((max)(extent.x, extent.y), extent.z), FLT_MIN);
+
+	// Search for the finest grid that meets the triangle budget; a single cell always does.
+	vector<uint32_t> clusterIds;
+	auto resolution = 1u;
+	for (auto lo = 2u, hi = MaxResolution; lo <= hi;)
+	{
+		const auto mid = lo + (hi - lo) / 2;
+		cluster(clusterIds, indices, pVertices, vertexStride, vertexCount, pIndices,
+			indexCount, positionOffset, boundsMin, maxExtent / mid, mid, pLockedVertices);
+
+		if (indices.size() / 3 <= targetTriCount)
+		{
+			resolution = mid;
+			lo = mid + 1;
+		}
+		else hi = mid - 1;
+	}
+
+	const auto clusterCount = cluster(clusterIds, indices, pVertices, vertexStride, vertexCount,
+		pIndices, indexCount, positionOffset, boundsMin, maxExtent / resolution, resolution, pLockedVertices);
+
+	// Merge the vertices of each cluster.
+	vector<XMFLOAT3> positions(clusterCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	vector<XMFLOAT3> normals(normalOffset != UINT32_MAX ? clusterCount : 0, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	vector<uint32_t> counts(clusterCount);
+	vertices.resize(static_cast<size_t>(vertexStride) * clusterCount);
+	for (auto i = 0u; i < vertexCount; ++i)
+	{
+		const auto c = clusterIds[i];
+		if (counts[c]++ == 0) memcpy(&vertices[static_cast<size_t>(vertexStride) * c],
+			&pVertices[static_cast<size_t>(vertexStride) * i], vertexStride);
+
+		XMStoreFloat3(&positions[c], XMLoadFloat3(&positions[c]) +
+			XMLoadFloat3(&GetFloat3(pVertices, vertexStride, i, positionOffset)));
+		if (!normals.empty()) XMStoreFloat3(&normals[c], XMLoadFloat3(&normals[c]) +
+			XMLoadFloat3(&GetFloat3(pVertices, vertexStride, i, normalOffset)));
+	}
+
+	for (auto c = 0u; c < clusterCount; ++c)
+	{
+		const auto pVertex = &vertices[static_cast<size_t>(vertexStride) * c];
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&pVertex[positionOffset]),
+			XMLoadFloat3(&positions[c]) / static_cast<float>(counts[c]));
+
+		// Keep the first normal if the cluster's normals cancel out.
+		if (normals.empty()) continue;
+		const auto normal = XMLoadFloat3(&normals[c]);
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > FLT_MIN)
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&pVertex[normalOffset]), XMVector3Normalize(normal));
+	}
+
+	if (pMaxError)
+	{
+		auto maxErrorSq = 0.0f;
+		for (auto i = 0u; i < vertexCount; ++i)
+		{
+			const auto error = XMLoadFloat3(&GetFloat3(pVertices, vertexStride, i, positionOffset)) -
+				XMLoadFloat3(&GetFloat3(vertices.data(), vertexStride, clusterIds[i], positionOffset));
+			maxErrorSq = (max)(XMVectorGetX(XMVector3LengthSq(error)), maxErrorSq);
+		}
+		*pMaxError = sqrtf(maxErrorSq);
+	}
+
+	return true;
+}
+
+uint32_t MeshSimplifier::cluster(vector<uint32_t>& clusterIds, vector<uint32_t>& indices,
+	const uint8_t* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+	const uint32_t* pIndices, uint32_t indexCount, uint32_t positionOffset,
+	const XMFLOAT3& boundsMin, float cellSize, uint32_t resolution, const uint8_t* pLockedVertices) const
+{
+	// Grid cell of each vertex; locked vertices get keys of their own above all cells.
+	vector<uint64_t> cells(vertexCount);
+	ParallelFor(vertexCount, 4096, [&](uint32_t begin, uint32_t end)
+	{
+		const auto vMin = XMLoadFloat3(&boundsMin);
+		const auto vMaxCell = XMVectorReplicate(static_cast<float>(resolution - 1));
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pos = XMLoadFloat3(&GetFloat3(pVertices, vertexStride, i, positionOffset));
+			XMUINT3 cell;
+			XMStoreUInt3(&cell, XMConvertVectorFloatToUInt(XMVectorClamp((pos - vMin) / cellSize, g_XMZero, vMaxCell), 0));
+			cells[i] = pLockedVertices && pLockedVertices[i] ? (1ull << 63) | i :
+				(static_cast<uint64_t>(cell.z) * resolution + cell.y) * resolution + cell.x;
+		}
+	}, m_numThreads);
+
+	// Number the occupied cells in the order of their first vertices.
+	unordered_map<uint64_t, uint32_t> clusterMap;
+	clusterMap.reserve(vertexCount);
+	clusterIds.resize(vertexCount);
+	for (auto i = 0u; i < vertexCount; ++i)
+		clusterIds[i] = clusterMap.emplace(cells[i], static_cast<uint32_t>(clusterMap.size())).first->second;
+
+	// Drop collapsed triangles, then duplicates with the same winding.
+	vector<Triangle> triangles;
+	triangles.reserve(indexCount / 3);
+	for (auto i = 0u; i < indexCount; i += 3)
+	{
+		const auto a = clusterIds[pIndices[i]];
+		const auto b = clusterIds[pIndices[i + 1]];
+		const auto c = clusterIds[pIndices[i + 2]];
+		if (a == b || b == c || c == a) continue;
+
+		// Rotate the smallest index to the front, which keeps the winding.
+		if (a < b && a < c) triangles.push_back({ a, b, c });
+		else if (b < c) triangles.push_back({ b, c, a });
+		else triangles.push_back({ c, a, b });
+	}
+
+	sort(triangles.begin(), triangles.end());
+	triangles.erase(unique(triangles.begin(), triangles.end()), triangles.end());
+
+	indices.resize(triangles.size() * 3);
+	if (!triangles.empty()) memcpy(indices.data(), triangles.data(), sizeof(uint32_t) * indices.size());
+
+	return static_cast<uint32_t>(clusterMap.size());
+}
@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+// Reduces indexed triangle lists for coarser LODs by clustering vertices on a uniform grid.
+// The grid resolution is searched for the finest one that meets the triangle budget.
+class MeshSimplifier
+{
+public:
+	MeshSimplifier(uint32_t numThreads = 0);
+	virtual ~MeshSimplifier();
+
+	// Positions are averaged per cell and normals (if normalOffset is not -1) are summed and
+	// renormalized; the other attributes are taken from the first vertex in each cell.
+	// Triangles collapsed by the clustering and duplicated triangles are dropped.
+	// Vertices with a nonzero entry in pLockedVertices stay unmerged, so that pieces simplified
+	// separately still meet at the locked vertices they share; the budget may then be out of
+	// reach, in which case all unlocked vertices fall into a single cell. pMaxError receives the
+	// largest distance that a vertex moved.
+	bool Simplify(std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices,
+		const uint8_t* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+		const uint32_t* pIndices, uint32_t indexCount, uint32_t positionOffset,
+		uint32_t normalOffset, uint32_t targetTriCount, const uint8_t* pLockedVertices = nullptr,
+		float* pMaxError = nullptr) const;
+
+	static const uint32_t MaxResolution = 4096;
+
+protected:
+	uint32_t cluster(std::vector<uint32_t>& clusterIds, std::vector<uint32_t>& indices,
+		const uint8_t* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+		const uint32_t* pIndices, uint32_t indexCount, uint32_t positionOffset,
+		const DirectX::XMFLOAT3& boundsMin, float cellSize, uint32_t resolution,
+		const uint8_t* pLockedVertices) const;
+
+	uint32_t m_numThreads;
+};
@@ -0,0 +1,302 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "MeshletCuller.h"
+#include "ParallelFor.h"
+
+#include <atomic>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	// Normal cone bytes decoded as UnpackCone() does: snorm axis components and the unorm cosine
+	struct ConeTables
+	{
+		ConeTables()
+		{
+			for (auto i = 0u; i < 256; ++i)
+			{
+				Unorm[i] = static_cast<float>(i) / 255.0f;
+				Snorm[i] = Unorm[i] * 2.0f - 1.0f;
+			}
+		}
+
+		float Unorm[256];
+		float Snorm[256];
+	};
+
+	const ConeTables& GetConeTables()
+	{
+		static const ConeTables tables;
+
+		return tables;
+	}
+
+	XMVECTOR GatherConeBytes(const uint32_t* pCones, uint8_t byteIndex, const float* pTable)
+	{
+		const auto shift = 8 * byteIndex;
+
+		return XMVectorSet(pTable[(pCones[0] >> shift) & 0xff], pTable[(pCones[1] >> shift) & 0xff],
+			pTable[(pCones[2] >> shift) & 0xff], pTable[(pCones[3] >> shift) & 0xff]);
+	}
+
+	XMVECTOR LoadLanes(const vector<float>& data, uint32_t i)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&data[i]));
+	}
+
+	// (x, y, z) * m + t for Width lanes of x, y and z, with the same rounding as the scalar path
+	XMVECTOR TransformLanes(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, float m0, float m1, float m2, float t)
+	{
+		return z * m2 + (y * m1 + (x * m0 + XMVectorReplicate(t)));
+	}
+}
+
+void ConvertCullData(CullDataSoA& cullDataSoA, const CullData* pCullData, uint32_t count)
+{
+	const auto paddedCount = (count + CullDataSoA::Width - 1) / CullDataSoA::Width * CullDataSoA::Width;
+	cullDataSoA.CenterX.assign(paddedCount, 0.0f);
+	cullDataSoA.CenterY.assign(paddedCount, 0.0f);
+	cullDataSoA.CenterZ.assign(paddedCount, 0.0f);
+	cullDataSoA.Radius.assign(paddedCount, 0.0f);
+	cullDataSoA.NormalCone.assign(paddedCount, 0xff000000);
+	cullDataSoA.ApexOffset.assign(paddedCount, 0.0f);
+	cullDataSoA.Count = count;
+
+	for (auto i = 0u; i < count; ++i)
+	{
+		const auto& cullData = pCullData[i];
+		cullDataSoA.CenterX[i] = cullData.BoundingSphere.x;
+		cullDataSoA.CenterY[i] = cullData.BoundingSphere.y;
+		cullDataSoA.CenterZ[i] = cullData.BoundingSphere.z;
+		cullDataSoA.Radius[i] = cullData.BoundingSphere.w;
+		memcpy(&cullDataSoA.NormalCone[i], cullData.NormalCone, sizeof(uint32_t));
+		cullDataSoA.ApexOffset[i] = cullData.ApexOffset;
+	}
+}
+
+void ConvertCullData(vector<CullData>& cullData, const CullDataSoA& cullDataSoA)
+{
+	cullData.resize(cullDataSoA.Count);
+	for (auto i = 0u; i < cullDataSoA.Count; ++i)
+	{
+		auto& data = cullData[i];
+		data.BoundingSphere = XMFLOAT4(cullDataSoA.CenterX[i], cullDataSoA.CenterY[i],
+			cullDataSoA.CenterZ[i], cullDataSoA.Radius[i]);
+		memcpy(data.NormalCone, &cullDataSoA.NormalCone[i], sizeof(uint32_t));
+		data.ApexOffset = cullDataSoA.ApexOffset[i];
+	}
+}
+
+bool IsMeshletVisible(const CullData& cullData, const CullView& view)
+{
+	if ((view.Flags & CULL_FLAG) == 0) return true;
+
+	const auto& m = view.World.m;
+	const auto& sphere = cullData.BoundingSphere;
+
+	// Do a cull test of the bounding sphere against the view frustum planes.
+	const auto cx = sphere.z * m[2][0] + (sphere.y * m[1][0] + (sphere.x * m[0][0] + m[3][0]));
+	const auto cy = sphere.z * m[2][1] + (sphere.y * m[1][1] + (sphere.x * m[0][1] + m[3][1]));
+	const auto cz = sphere.z * m[2][2] + (sphere.y * m[1][2] + (sphere.x * m[0][2] + m[3][2]));
+	const auto negRadius = -(sphere.w * view.Scale);
+	for (const auto& plane : view.Planes)
+		if (cz * plane.z + (cy * plane.y + (cx * plane.x + plane.w)) < negRadius) return false;
+
+	// Do normal cone culling, unless the cone is degenerate.
+	if (cullData.NormalCone[3] == 0xff) return true;
+
+	const auto& tables = GetConeTables();
+	const auto nx = tables.Snorm[cullData.NormalCone[0]];
+	const auto ny = tables.Snorm[cullData.NormalCone[1]];
+	const auto nz = tables.Snorm[cullData.NormalCone[2]];
+
+	// Transform the axis to world space.
+	auto ax = nz * m[2][0] + (ny * m[1][0] + (nx * m[0][0] + 0.0f));
+	auto ay = nz * m[2][1] + (ny * m[1][1] + (nx * m[0][1] + 0.0f));
+	auto az = nz * m[2][2] + (ny * m[1][2] + (nx * m[0][2] + 0.0f));
+	const auto axisLength = sqrtf(az * az + (ay * ay + ax * ax));
+	ax = ax / axisLength;
+	ay = ay / axisLength;
+	az = az / axisLength;
+
+	// Offset the apex from the center, and test the view direction against the cone.
+	const auto apexOffset = cullData.ApexOffset * view.Scale;
+	const auto vx = view.ViewPosition.x - (cx - ax * apexOffset);
+	const auto vy = view.ViewPosition.y - (cy - ay * apexOffset);
+	const auto vz = view.ViewPosition.z - (cz - az * apexOffset);
+	const auto viewLength = sqrtf(vz * vz + (vy * vy + vx * vx));
+	const auto d = -(vz * az + (vy * ay + vx * ax)) / viewLength;
+
+	return !(d > tables.Unorm[cullData.NormalCone[3]]);
+}
+
+bool IsLodSelected(const LodBounds& lodBounds, const LodView& view)
+{
+	const auto& m = view.World.m;
+	const auto& sphere = lodBounds.BoundingSphere;
+
+	// Project the errors from the nearest point of the bounding sphere.
+	const auto cx = sphere.z * m[2][0] + (sphere.y * m[1][0] + (sphere.x * m[0][0] + m[3][0]));
+	const auto cy = sphere.z * m[2][1] + (sphere.y * m[1][1] + (sphere.x * m[0][1] + m[3][1]));
+	const auto cz = sphere.z * m[2][2] + (sphere.y * m[1][2] + (sphere.x * m[0][2] + m[3][2]));
+	const auto vx = cx - view.ViewPosition.x;
+	const auto vy = cy - view.ViewPosition.y;
+	const auto vz = cz - view.ViewPosition.z;
+	const auto distance = (max)(sqrtf(vz * vz + (vy * vy + vx * vx)) - sphere.w * view.Scale, 0.0f);
+
+	const auto threshold = view.ErrorThreshold * distance;
+	const auto errorScale = view.ErrorScale * view.Scale;
+
+	return lodBounds.Error * errorScale <= threshold && lodBounds.ParentError * errorScale > threshold;
+}
+
+uint32_t CullMeshlets(uint32_t* pVisible, const CullDataSoA& cullData, uint32_t begin, uint32_t end,
+	const CullView& view)
+{
+	const auto& m = view.World.m;
+	const auto& tables = GetConeTables();
+	const auto scale = XMVectorReplicate(view.Scale);
+	const auto viewX = XMVectorReplicate(view.ViewPosition.x);
+	const auto viewY = XMVectorReplicate(view.ViewPosition.y);
+	const auto viewZ = XMVectorReplicate(view.ViewPosition.z);
+	const auto degenerateMask = XMVectorReplicateInt(0xff000000);
+
+	XMVECTOR planes[6][4];
+	for (uint8_t i = 0; i < 6; ++i)
+	{
+		planes[i][0] = XMVectorReplicate(view.Planes[i].x);
+		planes[i][1] = XMVectorReplicate(view.Planes[i].y);
+		planes[i][2] = XMVectorReplicate(view.Planes[i].z);
+		planes[i][3] = XMVectorReplicate(view.Planes[i].w);
+	}
+
+	end = (min)(end, cullData.Count);
+	auto visibleCount = 0u;
+	if ((view.Flags & CULL_FLAG) == 0)
+	{
+		for (auto i = begin; i < end; ++i) pVisible[visibleCount++] = i;
+
+		return visibleCount;
+	}
+
+	for (auto i = begin; i < end; i += CullDataSoA::Width)
+	{
+		// Do a cull test of the bounding spheres against the view frustum planes.
+		const auto x = LoadLanes(cullData.CenterX, i);
+		const auto y = LoadLanes(cullData.CenterY, i);
+		const auto z = LoadLanes(cullData.CenterZ, i);
+		const auto cx = TransformLanes(x, y, z, m[0][0], m[1][0], m[2][0], m[3][0]);
+		const auto cy = TransformLanes(x, y, z, m[0][1], m[1][1], m[2][1], m[3][1]);
+		const auto cz = TransformLanes(x, y, z, m[0][2], m[1][2], m[2][2], m[3][2]);
+		const auto negRadius = -(LoadLanes(cullData.Radius, i) * scale);
+
+		auto visible = XMVectorTrueInt();
+		for (const auto& plane : planes)
+		{
+			const auto d = cz * plane[2] + (cy * plane[1] + (cx * plane[0] + plane[3]));
+			visible = XMVectorAndCInt(visible, XMVectorLess(d, negRadius));
+		}
+
+		if (XMVector4EqualInt(visible, XMVectorFalseInt())) continue;
+
+		// Do normal cone culling of the lanes with non-degenerate cones.
+		const auto pCones = &cullData.NormalCone[i];
+		const auto degenerate = XMVectorEqualInt(XMVectorAndInt(XMLoadInt4(pCones), degenerateMask), degenerateMask);
+		if (!XMVector4EqualInt(degenerate, XMVectorTrueInt()))
+		{
+			const auto nx = GatherConeBytes(pCones, 0, tables.Snorm);
+			const auto ny = GatherConeBytes(pCones, 1, tables.Snorm);
+			const auto nz = GatherConeBytes(pCones, 2, tables.Snorm);
+			const auto cosine = GatherConeBytes(pCones, 3, tables.Unorm);
+
+			// Transform the axes to world space.
+			auto ax = TransformLanes(nx, ny, nz, m[0][0], m[1][0], m[2][0], 0.0f);
+			auto ay = TransformLanes(nx, ny, nz, m[0][1], m[1][1], m[2][1], 0.0f);
+			auto az = TransformLanes(nx, ny, nz, m[0][2], m[1][2], m[2][2], 0.0f);
+			const auto axisLength = XMVectorSqrt(az * az + (ay * ay + ax * ax));
+			ax /= axisLength;
+			ay /= axisLength;
+			az /= axisLength;
+
+			// Offset the apexes from the centers, and test the view directions against the cones.
+			const auto apexOffset = LoadLanes(cullData.ApexOffset, i) * scale;
+			const auto vx = viewX - (cx - ax * apexOffset);
+			const auto vy = viewY - (cy - ay * apexOffset);
+			const auto vz = viewZ - (cz - az * apexOffset);
+			const auto viewLength = XMVectorSqrt(vz * vz + (vy * vy + vx * vx));
+			const auto d = -(vz * az + (vy * ay + vx * ax)) / viewLength;
+
+			visible = XMVectorAndCInt(visible, XMVectorAndCInt(XMVectorGreater(d, cosine), degenerate));
+		}
+
+		// Compact the indices of the visible lanes.
+		uint32_t lanes[CullDataSoA::Width];
+		XMStoreInt4(lanes, visible);
+		const auto laneCount = end - i < CullDataSoA::Width ? end - i : CullDataSoA::Width;
+		for (auto j = 0u; j < laneCount; ++j)
+			if (lanes[j]) pVisible[visibleCount++] = i + j;
+	}
+
+	return visibleCount;
+}
+
+MeshletCuller::MeshletCuller(uint32_t numThreads) :
+	m_numThreads(numThreads)
+{
+}
+
+MeshletCuller::~MeshletCuller()
+{
+}
+
+uint32_t MeshletCuller::Cull(DispatchArgs* pDispatchArgs, const CullDataSoA& cullData, const CullView& view) const
+{
+	static_assert(AS_GROUP_SIZE % CullDataSoA::Width == 0, "AS batches must consist of whole SIMD vectors.");
+
+	atomic<uint32_t> visibleCount(0);
+	ParallelFor(GetBatchCount(cullData.Count), 16, [&](uint32_t begin, uint32_t end)
+	{
+		auto chunkVisibleCount = 0u;
+		for (auto i = begin; i < end; ++i)
+		{
+			auto& dispatchArgs = pDispatchArgs[i];
+			const auto meshletOffset = AS_GROUP_SIZE * i;
+			const auto batchVisibleCount = CullMeshlets(dispatchArgs.ASDispatchArgs.MeshletIndices,
+				cullData, meshletOffset, meshletOffset + AS_GROUP_SIZE, view);
+			SetDispatchArgs(dispatchArgs, i, batchVisibleCount);
+			chunkVisibleCount += batchVisibleCount;
+		}
+		visibleCount += chunkVisibleCount;
+	}, m_numThreads);
+
+	return visibleCount;
+}
+
+uint32_t MeshletCuller::GetBatchCount(uint32_t meshletCount)
+{
+	return (meshletCount + AS_GROUP_SIZE - 1) / AS_GROUP_SIZE;
+}
+
+void MeshletCuller::SetDispatchArgs(DispatchArgs& dispatchArgs, uint32_t batchIdx, uint32_t visibleCount)
+{
+	const auto indexCount = 3 * MAX_PRIMS * AS_GROUP_SIZE;
+
+	auto& drawArgs = dispatchArgs.DrawArgs;
+	drawArgs.BatchIdx = batchIdx;
+	drawArgs.IndexCountPerInstance = indexCount;
+	drawArgs.InstanceCount = 1;
+	drawArgs.StartIndexLocation = indexCount * batchIdx;
+	drawArgs.BaseVertexLocation = 0;
+	drawArgs.StartInstanceLocation = 0;
+
+	auto& asDispatchArgs = dispatchArgs.ASDispatchArgs;
+	asDispatchArgs.BatchIdx = batchIdx;
+	asDispatchArgs.x = visibleCount;
+	asDispatchArgs.y = 1;
+	asDispatchArgs.z = 1;
+	asDispatchArgs.InstanceIndex = 0;
+}
@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+#include "SharedConst.h"
+
+// Structure-of-arrays form of CullData. Every array is padded to a multiple of Width
+// entries, so that the culling kernel always loads whole vectors.
+struct CullDataSoA
+{
+	std::vector<float>    CenterX;
+	std::vector<float>    CenterY;
+	std::vector<float>    CenterZ;
+	std::vector<float>    Radius;
+	std::vector<uint32_t> NormalCone; // Packed as CullData::NormalCone
+	std::vector<float>    ApexOffset;
+	uint32_t              Count;
+
+	static const uint32_t Width = 4;
+};
+
+// Transform and view of a meshlet culling pass, as in the Instance and Constants of IsVisible()
+// in ASMeshlet.hlsl. World is the DirectXMath (row-vector) matrix, not the transposed CB copy.
+struct CullView
+{
+	DirectX::XMFLOAT4X4 World;
+	float               Scale;
+	DirectX::XMFLOAT4   Planes[6];
+	DirectX::XMFLOAT3   ViewPosition;
+	uint32_t            Flags;        // Meshlets are only culled with CULL_FLAG
+};
+
+// Transform and view of the meshlet LOD selection, as in the Instance and Constants of IsLodSelected()
+// in ASMeshlet.hlsl
+struct LodView
+{
+	DirectX::XMFLOAT4X4 World;
+	float               Scale;
+	DirectX::XMFLOAT3   ViewPosition;
+	float               ErrorThreshold; // Pixels
+	float               ErrorScale;     // Pixels per unit of error at unit distance
+};
+
+void ConvertCullData(CullDataSoA& cullDataSoA, const CullData* pCullData, uint32_t count);
+void ConvertCullData(std::vector<CullData>& cullData, const CullDataSoA& cullDataSoA);
+
+// Frustum and normal-cone test of one meshlet with the semantics of IsVisible() in ASMeshlet.hlsl.
+// The arithmetic follows CullMeshlets() lane by lane, so both agree exactly on the same build.
+bool IsMeshletVisible(const CullData& cullData, const CullView& view);
+
+// LOD selection of one meshlet subset with the semantics of IsLodSelected() in ASMeshlet.hlsl. The
+// subset is drawn if its projected error is within the threshold and that of its parent is not.
+bool IsLodSelected(const LodBounds& lodBounds, const LodView& view);
+
+// Tests CullDataSoA::Width meshlets per DirectXMath vector operation, and writes the indices of
+// the visible meshlets in [begin, end) to pVisible in order. Begin must be a multiple of Width.
+// Returns the number of visible meshlets.
+uint32_t CullMeshlets(uint32_t* pVisible, const CullDataSoA& cullData, uint32_t begin, uint32_t end,
+	const CullView& view);
+
+// Culls all meshlets of a mesh on the CPU, in batches of AS_GROUP_SIZE meshlets as CSMeshletAS.hlsl
+// does, and writes the DispatchArgs of each batch the same way, ready for the fallback MS and VS
+// stages. Idle threads grab the next chunk of batches, so uneven culling costs balance out.
+class MeshletCuller
+{
+public:
+	MeshletCuller(uint32_t numThreads = 0);
+	virtual ~MeshletCuller();
+
+	// pDispatchArgs holds GetBatchCount() entries. Returns the number of visible meshlets.
+	uint32_t Cull(DispatchArgs* pDispatchArgs, const CullDataSoA& cullData, const CullView& view) const;
+
+	static uint32_t GetBatchCount(uint32_t meshletCount);
+
+	// Fills all arguments but the meshlet indices, as DispatchMesh() in CSMeshletAS.hlsl does for
+	// the first instance of a dispatch.
+	static void SetDispatchArgs(DispatchArgs& dispatchArgs, uint32_t batchIdx, uint32_t visibleCount);
+
+protected:
+	uint32_t m_numThreads;
+};
@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "MeshletSort.h"
+
+#include <numeric>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	// Spreads the lower 10 bits of v so that there are two zero bits between each.
+	uint32_t SpreadBits(uint32_t v)
+	{
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+
+		return v;
+	}
+}
+
+uint32_t MortonCode(FXMVECTOR unitPos)
+{
+	XMUINT3 cell;
+	XMStoreUInt3(&cell, XMConvertVectorFloatToUInt(XMVectorClamp(unitPos * 1023.0f, g_XMZero, XMVectorReplicate(1023.0f)), 0));
+
+	return (SpreadBits(cell.x) << 2) | (SpreadBits(cell.y) << 1) | SpreadBits(cell.z);
+}
+
+void SortMeshlets(Meshlet* pMeshlets, CullData* pCullData, uint32_t meshletCount,
+	const Subset* pSubsets, uint32_t subsetCount, uint8_t* pUniqueVertexIndices,
+	size_t uniqueVertexIndexBytes, uint32_t indexSize, PackedTriangle* pPrimitiveIndices,
+	size_t primitiveCount)
+{
+	if (meshletCount == 0) return;
+
+	// Sort the meshlet order of each subset by the Morton codes of the sphere centers in the subset bounds.
+	vector<uint32_t> order(meshletCount);
+	iota(order.begin(), order.end(), 0);
+
+	vector<uint64_t> keys;
+	vector<uint32_t> subsetOrder;
+	for (auto s = 0u; s < subsetCount; ++s)
+	{
+		const auto& subset = pSubsets[s];
+		if (subset.Count < 2 || static_cast<uint64_t>(subset.Offset) + subset.Count > meshletCount) continue;
+
+		auto vMin = XMVectorReplicate(FLT_MAX);
+		auto vMax = XMVectorReplicate(-FLT_MAX);
+		for (auto i = 0u; i < subset.Count; ++i)
+		{
+			const auto center = XMLoadFloat4(&pCullData[order[subset.Offset + i]].BoundingSphere);
+			vMin = XMVectorMin(vMin, center);
+			vMax = XMVectorMax(vMax, center);
+		}
+
+		const auto extent = XMVectorMax(vMax - vMin, XMVectorReplicate(FLT_MIN));
+		keys.resize(subset.Count);
+		for (auto i = 0u; i < subset.Count; ++i)
+		{
+			const auto center = XMLoadFloat4(&pCullData[order[subset.Offset + i]].BoundingSphere);
+			keys[i] = (static_cast<uint64_t>(MortonCode((center - vMin) / extent)) << 32) | i;
+		}
+		sort(keys.begin(), keys.end());
+
+		subsetOrder.assign(&order[subset.Offset], &order[subset.Offset] + subset.Count);
+		for (auto i = 0u; i < subset.Count; ++i)
+			order[subset.Offset + i] = subsetOrder[static_cast<uint32_t>(keys[i])];
+	}
+
+	// Permute the meshlets and their cull data.
+	{
+		const vector<Meshlet> meshlets(pMeshlets, pMeshlets + meshletCount);
+		const vector<CullData> cullData(pCullData, pCullData + meshletCount);
+		for (auto i = 0u; i < meshletCount; ++i)
+		{
+			pMeshlets[i] = meshlets[order[i]];
+			pCullData[i] = cullData[order[i]];
+		}
+	}
+
+	// Repack the vertex and primitive indices in meshlet order, so that the MS reads them sequentially.
+	if (indexSize != 2 && indexSize != 4) return;
+
+	const auto uniqueVertexIndexCount = uniqueVertexIndexBytes / indexSize;
+	uint64_t vertCount = 0, primCount = 0;
+	for (auto i = 0u; i < meshletCount; ++i)
+	{
+		const auto& meshlet = pMeshlets[i];
+		if (static_cast<uint64_t>(meshlet.VertOffset) + meshlet.VertCount > uniqueVertexIndexCount) return;
+		if (static_cast<uint64_t>(meshlet.PrimOffset) + meshlet.PrimCount > primitiveCount) return;
+		vertCount += meshlet.VertCount;
+		primCount += meshlet.PrimCount;
+	}
+	if (vertCount > uniqueVertexIndexCount || primCount > primitiveCount) return;
+
+	const vector<uint8_t> uniqueVertexIndices(pUniqueVertexIndices, pUniqueVertexIndices + uniqueVertexIndexBytes);
+	const vector<PackedTriangle> primitiveIndices(pPrimitiveIndices, pPrimitiveIndices + primitiveCount);
+	auto vertOffset = 0u, primOffset = 0u;
+	for (auto i = 0u; i < meshletCount; ++i)
+	{
+		auto& meshlet = pMeshlets[i];
+		memcpy(&pUniqueVertexIndices[static_cast<size_t>(indexSize) * vertOffset],
+			&uniqueVertexIndices[static_cast<size_t>(indexSize) * meshlet.VertOffset], indexSize * meshlet.VertCount);
+		memcpy(&pPrimitiveIndices[primOffset], &primitiveIndices[meshlet.PrimOffset], sizeof(PackedTriangle) * meshlet.PrimCount);
+		meshlet.VertOffset = vertOffset;
+		meshlet.PrimOffset = primOffset;
+		vertOffset += meshlet.VertCount;
+		primOffset += meshlet.PrimCount;
+	}
+}
+
+void SortMeshlets(MeshData& mesh)
+{
+	if (mesh.CullingData.size() < mesh.Meshlets.size()) return;
+
+	SortMeshlets(mesh.Meshlets.data(), mesh.CullingData.data(), static_cast<uint32_t>(mesh.Meshlets.size()),
+		mesh.MeshletSubsets.data(), static_cast<uint32_t>(mesh.MeshletSubsets.size()),
+		mesh.UniqueVertexIndices.data(), mesh.UniqueVertexIndices.size(), mesh.IndexSize,
+		mesh.PrimitiveIndices.data(), mesh.PrimitiveIndices.size());
+}
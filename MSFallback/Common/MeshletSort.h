@@ -0,0 +1,20 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+// 30-bit Morton code of a position normalized to [0, 1]^3
+uint32_t MortonCode(DirectX::FXMVECTOR unitPos);
+
+// Reorders the meshlets of each subset, together with their cull data, along a Morton curve
+// of the bounding-sphere centers, so that neighboring meshlets in an AS batch tend to be
+// culled together. The unique vertex and primitive indices are then repacked in the new
+// meshlet order, unless meshlets share index ranges and the repacked data would not fit.
+void SortMeshlets(Meshlet* pMeshlets, CullData* pCullData, uint32_t meshletCount,
+	const Subset* pSubsets, uint32_t subsetCount, uint8_t* pUniqueVertexIndices,
+	size_t uniqueVertexIndexBytes, uint32_t indexSize, PackedTriangle* pPrimitiveIndices,
+	size_t primitiveCount);
+void SortMeshlets(MeshData& mesh);
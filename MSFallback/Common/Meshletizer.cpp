@@ -0,0 +1,313 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Meshletizer.h"
+#include "CullDataGenerator.h"
+#include "MeshletSort.h"
+#include "ParallelFor.h"
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	void StoreIndices(vector<uint8_t>& dst, const vector<uint32_t>& src, uint32_t indexSize)
+	{
+		dst.resize((src.size() * indexSize + 3) & ~static_cast<size_t>(3)); // Raw buffers are addressed in 4-byte units
+		if (indexSize == 4) memcpy(dst.data(), src.data(), sizeof(uint32_t) * src.size());
+		else
+		{
+			const auto pDst = reinterpret_cast<uint16_t*>(dst.data());
+			for (size_t i = 0; i < src.size(); ++i) pDst[i] = static_cast<uint16_t>(src[i]);
+		}
+	}
+}
+
+Meshletizer::Meshletizer(uint32_t maxVerts, uint32_t maxPrims, uint32_t numThreads) :
+	m_maxVerts(maxVerts),
+	m_maxPrims(maxPrims),
+	m_numThreads(numThreads)
+{
+}
+
+Meshletizer::~Meshletizer()
+{
+}
+
+bool Meshletizer::Build(MeshData& mesh, const void* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+	const uint32_t* pIndices, uint32_t indexCount, const Subset* pSubsets, uint32_t subsetCount) const
+{
+	// PackedTriangle holds 10-bit local indices.
+	if (m_maxVerts < 3 || m_maxVerts > 1024 || m_maxPrims == 0) return false;
+	if (!pVertices || !pIndices || indexCount % 3) return false;
+
+	const auto posOffset = mesh.AttributeOffsets[Attribute::Position];
+	if (posOffset == UINT32_MAX || posOffset + sizeof(XMFLOAT3) > vertexStride) return false;
+
+	for (auto i = 0u; i < indexCount; ++i) if (pIndices[i] >= vertexCount) return false;
+
+	const Subset wholeList = { 0, indexCount };
+	if (subsetCount == 0)
+	{
+		pSubsets = &wholeList;
+		subsetCount = 1;
+	}
+
+	const auto pBytes = static_cast<const uint8_t*>(pVertices);
+	const auto loadPosition = [pBytes, vertexStride, posOffset](uint32_t i)
+	{
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pBytes[static_cast<size_t>(vertexStride) * i + posOffset]));
+	};
+
+	vector<Meshlet> meshlets;
+	vector<uint32_t> uniqueVertexIndices;
+	vector<PackedTriangle> primitiveIndices;
+	vector<uint32_t> triangles;
+
+	mesh.IndexSubsets.resize(subsetCount);
+	mesh.MeshletSubsets.resize(subsetCount);
+
+	for (auto s = 0u; s < subsetCount; ++s)
+	{
+		const auto& subset = pSubsets[s];
+		if (subset.Offset % 3 || subset.Count % 3) return false;
+		if (static_cast<uint64_t>(subset.Offset) + subset.Count > indexCount) return false;
+
+		const auto pSubsetIndices = &pIndices[subset.Offset];
+		const auto triCount = subset.Count / 3;
+
+		mesh.IndexSubsets[s] = { static_cast<uint32_t>(triangles.size() * 3), subset.Count };
+		mesh.MeshletSubsets[s] = { static_cast<uint32_t>(meshlets.size()), 0 };
+		if (triCount == 0) continue;
+
+		// Sort the triangles along a Morton curve of their centroids in the subset bounds.
+		const auto loadCentroid = [&](uint32_t t)
+		{
+			const auto pTri = &pSubsetIndices[3 * t];
+
+			return (loadPosition(pTri[0]) + loadPosition(pTri[1]) + loadPosition(pTri[2])) / 3.0f;
+		};
+
+		auto vMin = XMVectorReplicate(FLT_MAX);
+		auto vMax = XMVectorReplicate(-FLT_MAX);
+		for (auto t = 0u; t < triCount; ++t)
+		{
+			const auto centroid = loadCentroid(t);
+			vMin = XMVectorMin(vMin, centroid);
+			vMax = XMVectorMax(vMax, centroid);
+		}
+
+		const auto extent = XMVectorMax(vMax - vMin, XMVectorReplicate(FLT_MIN));
+		vector<uint64_t> keys(triCount);
+		ParallelFor(triCount, 4096, [&](uint32_t begin, uint32_t end)
+		{
+			for (auto t = begin; t < end; ++t)
+				keys[t] = (static_cast<uint64_t>(MortonCode((loadCentroid(t) - vMin) / extent)) << 32) | t;
+		}, m_numThreads);
+		sort(keys.begin(), keys.end());
+
+		vector<uint32_t> order(triCount);
+		for (auto p = 0u; p < triCount; ++p) order[p] = static_cast<uint32_t>(keys[p]);
+		keys = vector<uint64_t>();
+
+		// Vertex-to-triangle adjacency in CSR form, holding the positions along the curve
+		vector<uint32_t> adjOffsets(static_cast<size_t>(vertexCount) + 1);
+		for (auto i = 0u; i < subset.Count; ++i) ++adjOffsets[pSubsetIndices[i] + 1];
+		for (auto v = 0u; v < vertexCount; ++v) adjOffsets[v + 1] += adjOffsets[v];
+
+		vector<uint32_t> adjTris(subset.Count);
+		{
+			vector<uint32_t> cursors(adjOffsets.cbegin(), adjOffsets.cend() - 1);
+			for (auto p = 0u; p < triCount; ++p)
+				for (uint8_t k = 0; k < 3; ++k)
+					adjTris[cursors[pSubsetIndices[3 * order[p] + k]]++] = p;
+		}
+
+		// Meshletize fixed-size chunks of the curve in parallel.
+		const auto chunkCount = (triCount + ChunkSize - 1) / ChunkSize;
+		vector<Chunk> chunks(chunkCount);
+		ParallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (auto c = begin; c < end; ++c)
+				buildChunk(chunks[c], pSubsetIndices, order.data(), ChunkSize * c,
+					(min)(ChunkSize * (c + 1), triCount), adjOffsets.data(), adjTris.data());
+		}, m_numThreads);
+
+		// Stitch the chunks together.
+		for (auto& chunk : chunks)
+		{
+			const auto vertOffset = static_cast<uint32_t>(uniqueVertexIndices.size());
+			const auto primOffset = static_cast<uint32_t>(primitiveIndices.size());
+			for (auto& meshlet : chunk.Meshlets)
+			{
+				meshlet.VertOffset += vertOffset;
+				meshlet.PrimOffset += primOffset;
+			}
+
+			meshlets.insert(meshlets.end(), chunk.Meshlets.cbegin(), chunk.Meshlets.cend());
+			uniqueVertexIndices.insert(uniqueVertexIndices.end(), chunk.UniqueVertexIndices.cbegin(), chunk.UniqueVertexIndices.cend());
+			primitiveIndices.insert(primitiveIndices.end(), chunk.PrimitiveIndices.cbegin(), chunk.PrimitiveIndices.cend());
+			for (const auto& t : chunk.Triangles) triangles.emplace_back(subset.Offset / 3 + t);
+		}
+
+		mesh.MeshletSubsets[s].Count = static_cast<uint32_t>(meshlets.size()) - mesh.MeshletSubsets[s].Offset;
+	}
+
+	// Reorder the vertices by first use, so that each meshlet fetches a mostly contiguous range.
+	vector<uint32_t> remap(vertexCount, UINT32_MAX);
+	auto newVertexCount = 0u;
+	for (auto& v : uniqueVertexIndices)
+	{
+		if (remap[v] == UINT32_MAX) remap[v] = newVertexCount++;
+		v = remap[v];
+	}
+
+	mesh.VertexStride = vertexStride;
+	mesh.VertexCount = newVertexCount;
+	mesh.Vertices.resize(static_cast<size_t>(vertexStride) * newVertexCount);
+	for (auto v = 0u; v < vertexCount; ++v)
+		if (remap[v] != UINT32_MAX)
+			memcpy(&mesh.Vertices[static_cast<size_t>(vertexStride) * remap[v]], &pBytes[static_cast<size_t>(vertexStride) * v], vertexStride);
+
+	// Emit the index buffer in meshlet order.
+	vector<uint32_t> indices(triangles.size() * 3);
+	for (size_t i = 0; i < triangles.size(); ++i)
+		for (uint8_t k = 0; k < 3; ++k)
+			indices[3 * i + k] = remap[pIndices[3 * triangles[i] + k]];
+
+	mesh.IndexSize = newVertexCount > 0xffff ? 4 : 2;
+	mesh.IndexCount = static_cast<uint32_t>(indices.size());
+	StoreIndices(mesh.Indices, indices, mesh.IndexSize);
+	mesh.Indices.resize(static_cast<size_t>(mesh.IndexSize) * mesh.IndexCount);
+	StoreIndices(mesh.UniqueVertexIndices, uniqueVertexIndices, mesh.IndexSize);
+
+	mesh.Meshlets = move(meshlets);
+	mesh.PrimitiveIndices = move(primitiveIndices);
+
+	mesh.CullingData.resize(mesh.Meshlets.size());
+	if (!mesh.Meshlets.empty())
+		CullDataGenerator(m_numThreads).Generate(mesh.CullingData.data(), mesh.Meshlets.data(),
+			static_cast<uint32_t>(mesh.Meshlets.size()), uniqueVertexIndices.data(), mesh.PrimitiveIndices.data(),
+			&mesh.Vertices[posOffset], vertexStride);
+
+	return true;
+}
+
+void Meshletizer::buildChunk(Chunk& chunk, const uint32_t* pIndices, const uint32_t* pOrder, uint32_t begin,
+	uint32_t end, const uint32_t* pAdjOffsets, const uint32_t* pAdjTris) const
+{
+	static const uint32_t EMPTY = UINT32_MAX;
+
+	// Small open-addressing table from global to meshlet-local vertex indices
+	auto tableBits = 1u;
+	while ((1u << tableBits) < 2 * m_maxVerts) ++tableBits;
+	const auto tableMask = (1u << tableBits) - 1;
+	vector<uint32_t> tableKeys(tableMask + 1);
+	vector<uint16_t> tableValues(tableMask + 1);
+
+	const auto findVertex = [&](uint32_t v)
+	{
+		for (auto slot = (v * 2654435761u) >> (32 - tableBits); tableKeys[slot] != EMPTY; slot = (slot + 1) & tableMask)
+			if (tableKeys[slot] == v) return static_cast<uint32_t>(tableValues[slot]);
+
+		return EMPTY;
+	};
+
+	const auto insertVertex = [&](uint32_t v, uint32_t localIndex)
+	{
+		auto slot = (v * 2654435761u) >> (32 - tableBits);
+		while (tableKeys[slot] != EMPTY) slot = (slot + 1) & tableMask;
+		tableKeys[slot] = v;
+		tableValues[slot] = static_cast<uint16_t>(localIndex);
+	};
+
+	vector<uint8_t> emitted(end - begin);
+	vector<uint32_t> candidates;
+	Meshlet meshlet = {};
+
+	const auto countNewVerts = [&](uint32_t p)
+	{
+		const auto pTri = &pIndices[3 * pOrder[p]];
+		auto count = 0u;
+		for (uint8_t k = 0; k < 3; ++k) count += findVertex(pTri[k]) == EMPTY ? 1 : 0;
+
+		return count;
+	};
+
+	const auto addTriangle = [&](uint32_t p)
+	{
+		emitted[p - begin] = 1;
+
+		const auto t = pOrder[p];
+		uint32_t localIndices[3];
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			const auto v = pIndices[3 * t + k];
+			auto localIndex = findVertex(v);
+			if (localIndex == EMPTY)
+			{
+				localIndex = meshlet.VertCount++;
+				insertVertex(v, localIndex);
+				chunk.UniqueVertexIndices.emplace_back(v);
+
+				// Queue the remaining triangles around the new vertex as growth candidates.
+				for (auto a = pAdjOffsets[v]; a < pAdjOffsets[v + 1]; ++a)
+				{
+					const auto q = pAdjTris[a];
+					if (q >= begin && q < end && !emitted[q - begin]) candidates.emplace_back(q);
+				}
+			}
+			localIndices[k] = localIndex;
+		}
+
+		PackedTriangle prim;
+		prim.i0 = localIndices[0];
+		prim.i1 = localIndices[1];
+		prim.i2 = localIndices[2];
+		chunk.PrimitiveIndices.emplace_back(prim);
+		chunk.Triangles.emplace_back(t);
+		++meshlet.PrimCount;
+	};
+
+	for (auto cursor = begin; ; ++cursor)
+	{
+		while (cursor < end && emitted[cursor - begin]) ++cursor;
+		if (cursor >= end) break;
+
+		// Start a new meshlet from the first remaining triangle along the curve.
+		meshlet = { 0, static_cast<uint32_t>(chunk.UniqueVertexIndices.size()), 0, static_cast<uint32_t>(chunk.PrimitiveIndices.size()) };
+		fill(tableKeys.begin(), tableKeys.end(), EMPTY);
+		candidates.clear();
+		addTriangle(cursor);
+
+		while (meshlet.PrimCount < m_maxPrims)
+		{
+			// Grow with the adjacent triangle that adds the fewest vertices, the earliest along the curve on ties.
+			auto best = EMPTY, bestNewVerts = 4u;
+			for (size_t i = 0; i < candidates.size();)
+			{
+				const auto p = candidates[i];
+				if (emitted[p - begin])
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				const auto newVerts = countNewVerts(p);
+				if (newVerts < bestNewVerts || (newVerts == bestNewVerts && p < best))
+				{
+					best = p;
+					bestNewVerts = newVerts;
+				}
+				++i;
+			}
+
+			if (best == EMPTY || meshlet.VertCount + bestNewVerts > m_maxVerts) break;
+			addTriangle(best);
+		}
+
+		chunk.Meshlets.emplace_back(meshlet);
+	}
+}
@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+// Converts indexed triangle lists into the meshlet layout consumed by Model and the
+// meshlet shaders. Triangles are sorted along a Morton curve and split into fixed-size
+// chunks that are meshletized in parallel, so the output does not depend on the thread count.
+class Meshletizer
+{
+public:
+	Meshletizer(uint32_t maxVerts, uint32_t maxPrims, uint32_t numThreads = 0);
+	virtual ~Meshletizer();
+
+	// Builds meshlets for each index subset (or the whole list if there are no subsets).
+	// The caller fills mesh.AttributeOffsets beforehand; positions are read as float3
+	// at the Attribute::Position offset. Vertices are reordered by first use in the
+	// meshlets and unreferenced vertices are dropped.
+	bool Build(MeshData& mesh, const void* pVertices, uint32_t vertexStride, uint32_t vertexCount,
+		const uint32_t* pIndices, uint32_t indexCount, const Subset* pSubsets = nullptr,
+		uint32_t subsetCount = 0) const;
+
+	static const uint32_t ChunkSize = 16384; // Triangles per independently meshletized chunk
+
+protected:
+	struct Chunk
+	{
+		std::vector<Meshlet>		Meshlets;
+		std::vector<uint32_t>		UniqueVertexIndices;	// Global vertex indices
+		std::vector<PackedTriangle>	PrimitiveIndices;
+		std::vector<uint32_t>		Triangles;				// Source triangles in meshlet order
+	};
+
+	void buildChunk(Chunk& chunk, const uint32_t* pIndices, const uint32_t* pOrder, uint32_t begin,
+		uint32_t end, const uint32_t* pAdjOffsets, const uint32_t* pAdjTris) const;
+
+	uint32_t m_maxVerts;
+	uint32_t m_maxPrims;
+	uint32_t m_numThreads;
+};
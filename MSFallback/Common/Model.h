@@ -13,6 +13,9 @@
 #include "Span.h"
 
 #include <DirectXCollision.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 struct Attribute
 {
@@ -30,6 +33,39 @@ struct Attribute
     uint32_t Offset;
 };
 
+// Structured description of why a model file was rejected by the loader.
+struct ModelError
+{
+    enum ECode : uint32_t
+    {
+        None,
+        FileOpen,           // The file could not be opened or read.
+        Truncated,          // The file is smaller than its header and metadata claim.
+        Prolog,             // Not an 'MSHL' file.
+        Version,            // Version mismatch between export and import serialization code.
+        SizeMismatch,       // Header counts do not add up to the file size.
+        BufferViewRange,    // A buffer view exceeds the binary blob.
+        AccessorBufferView, // An accessor references a non-existent buffer view.
+        AccessorRange,      // An accessor exceeds its buffer view.
+        MeshAccessor,       // A mesh references a non-existent accessor.
+        Alignment,          // Typed or vertex data is not 4-byte aligned, or index data not aligned to the index size.
+        IndexFormat,        // Index size is neither 2 nor 4 bytes.
+        VertexLayout,       // Missing position attribute, or vertex streams inconsistent in stride, size or layout.
+        SubsetRange,        // A subset exceeds the meshlet or index range.
+        MeshletRange,       // A meshlet exceeds the unique vertex or primitive index range.
+        VertexIndexRange,   // A unique vertex index exceeds the vertex count.
+        PrimitiveRange,     // A primitive index exceeds the vertex count of its meshlet.
+        IndexRange,         // An index of the index buffer exceeds the vertex count.
+        CullDataCount,      // Fewer cull data entries than meshlets.
+        LodBoundsCount,     // LOD bounds do not match the meshlet subsets one to one.
+        Count
+    };
+
+    ECode    Code;
+    uint32_t Mesh;      // Offending mesh, or -1 for file-level errors
+    uint32_t Element;   // Offending buffer view, accessor, subset, meshlet or index, or -1
+};
+
 struct Subset
 {
     uint32_t Offset;
@@ -43,6 +79,21 @@ struct MeshInfo
 
     uint32_t LastMeshletVertCount;
     uint32_t LastMeshletPrimCount;
+
+    DirectX::XMFLOAT4 BoundingSphere;   // xyz = center, w = radius, of the whole mesh
+
+    DirectX::XMFLOAT3 PositionBias;     // Dequantized position = bias + unorm16 * scale
+    uint32_t VertexFormat;              // VERTEX_FORMAT_*
+    DirectX::XMFLOAT3 PositionScale;
+    uint32_t VertexStride;
+
+    uint32_t PrimitiveIndexBits;        // 6, 8 or 10 bits per local index
+    uint32_t PrimitiveStride;           // Bits per triangle in the packed stream
+
+    uint32_t VertexOffset;              // Byte offsets of the mesh in the geometry pool
+    uint32_t UniqueVertexIndexOffset;
+    uint32_t PrimitiveOffset;
+    uint32_t MeshletOffset;             // First meshlet and cull data of the mesh in the pool
 };
 
 struct Meshlet
@@ -67,14 +118,23 @@ struct CullData
     float             ApexOffset;     // apex = center - axis * offset
 };
 
-struct Mesh
+// Error bounds of a meshlet subset that is one LOD level of a region of the mesh. All levels of a
+// region share its bounding sphere, so that exactly one of them projects an error within any
+// pixel threshold with its parent (the next coarser level) above it.
+struct LodBounds
 {
-    D3D12_INPUT_ELEMENT_DESC   LayoutElems[Attribute::Count];
-    D3D12_INPUT_LAYOUT_DESC    LayoutDesc;
+    DirectX::XMFLOAT4 BoundingSphere; // xyz = center, w = radius, of the region
+    float             Error;          // Object-space error of the level; 0 at the finest level
+    float             ParentError;    // Error of the next coarser level; FLT_MAX at the coarsest
+};
 
+struct Mesh
+{
     std::vector<Span<uint8_t>> Vertices;
     std::vector<uint32_t>      VertexStrides;
     uint32_t                   VertexCount;
+    uint32_t                   AttributeStreams[Attribute::Count]; // Index into Vertices, or -1 if absent
+    uint32_t                   AttributeOffsets[Attribute::Count]; // Byte offset within a vertex of the stream
     DirectX::BoundingSphere    BoundingSphere;
 
     Span<Subset>               IndexSubsets;
@@ -87,18 +147,7 @@ struct Mesh
     Span<uint8_t>              UniqueVertexIndices;
     Span<PackedTriangle>       PrimitiveIndices;
     Span<CullData>             CullingData;
-
-    // D3D resource references
-    std::vector<D3D12_VERTEX_BUFFER_VIEW>  VBViews;
-    D3D12_INDEX_BUFFER_VIEW                IBView;
-
-    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> VertexResources;
-    Microsoft::WRL::ComPtr<ID3D12Resource>              IndexResource;
-    Microsoft::WRL::ComPtr<ID3D12Resource>              MeshletResource;
-    Microsoft::WRL::ComPtr<ID3D12Resource>              UniqueVertexIndexResource;
-    Microsoft::WRL::ComPtr<ID3D12Resource>              PrimitiveIndexResource;
-    Microsoft::WRL::ComPtr<ID3D12Resource>              CullDataResource;
-    Microsoft::WRL::ComPtr<ID3D12Resource>              MeshInfoResource;
+    Span<LodBounds>            SubsetLods;  // Per meshlet subset, or empty without cluster LODs
 
     // Calculates the number of instances of the last meshlet which can be packed into a single threadgroup.
     uint32_t GetLastMeshletPackCount(uint32_t subsetIndex, uint32_t maxGroupVerts, uint32_t maxGroupPrims) 
@@ -109,7 +158,7 @@ struct Mesh
         auto& subset = MeshletSubsets[subsetIndex];
         auto& meshlet = Meshlets[subset.Offset + subset.Count - 1];
 
-        return min(maxGroupVerts / meshlet.VertCount, maxGroupPrims / meshlet.PrimCount);
+        return (std::min)(maxGroupVerts / meshlet.VertCount, maxGroupPrims / meshlet.PrimCount);
     }
 
     void GetPrimitive(uint32_t index, uint32_t& i0, uint32_t& i1, uint32_t& i2) const
@@ -134,24 +183,56 @@ struct Mesh
     }
 };
 
+// CPU-side mesh with owned storage, as produced by offline tools and serialized by Model::SaveToFile.
+struct MeshData
+{
+    std::vector<uint8_t>        Vertices;                           // Interleaved, VertexStride bytes per vertex
+    uint32_t                    VertexStride;
+    uint32_t                    VertexCount;
+    uint32_t                    AttributeOffsets[Attribute::Count]; // Byte offset within a vertex, or -1 if absent
+
+    std::vector<Subset>         IndexSubsets;
+    std::vector<uint8_t>        Indices;
+    uint32_t                    IndexSize;
+    uint32_t                    IndexCount;
+
+    std::vector<Subset>         MeshletSubsets;
+    std::vector<Meshlet>        Meshlets;
+    std::vector<uint8_t>        UniqueVertexIndices;                // IndexSize bytes per index, padded to 4 bytes
+    std::vector<PackedTriangle> PrimitiveIndices;
+    std::vector<CullData>       CullingData;
+    std::vector<LodBounds>      SubsetLods;                         // Per meshlet subset, or empty without cluster LODs
+};
+
+// Loads and saves the binary model files. Parsing and serialization (ModelFile.cpp) need no
+// graphics API or file system, so that they also build for tools and fuzzing off Windows.
+// Failures are described by GetLoadError().
 class Model
 {
 public:
-    HRESULT LoadFromFile(const wchar_t* filename);
-    HRESULT UploadGpuResources(ID3D12Device* device, ID3D12CommandQueue* cmdQueue, ID3D12CommandAllocator* cmdAlloc, ID3D12GraphicsCommandList* cmdList);
+    bool LoadFromFile(const wchar_t* filename);
+    bool LoadFromMemory(const void* data, size_t size);
+    static bool SaveToFile(const wchar_t* filename, const MeshData* meshes, uint32_t meshCount);
+    static void SaveToMemory(std::vector<uint8_t>& buffer, const MeshData* meshes, uint32_t meshCount);
+    static std::wstring GetLodFileName(const wchar_t* filename, uint32_t lod);
 
     uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_meshes.size()); }
     const Mesh& GetMesh(uint32_t i) const { return m_meshes[i]; }
 
     const DirectX::BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+    const ModelError& GetLoadError() const { return m_error; }
 
     // Iterator interface
     auto begin() { return m_meshes.begin(); }
     auto end() { return m_meshes.end(); }
 
 private:
+    bool Parse();
+    bool Fail(ModelError::ECode code, uint32_t mesh = -1, uint32_t element = -1);
+
     std::vector<Mesh>                      m_meshes;
     DirectX::BoundingSphere                m_boundingSphere;
+    ModelError                             m_error;
 
     std::vector<uint8_t>                   m_buffer;
 };
@@ -0,0 +1,594 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#include "ModelFormat.h"
+
+#include <cstddef>
+#include <cstring>
+
+using namespace DirectX;
+using namespace ModelFormat;
+
+namespace
+{
+    // Returns the index of the first element for which isInvalid holds, or count if there is none.
+    // The first loop has no early-out so that it can be vectorized; the scalar search only runs on failure.
+    template <typename T, typename Pred>
+    uint32_t FindFirstInvalid(const T* elements, uint32_t count, Pred isInvalid)
+    {
+        bool anyInvalid = false;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            anyInvalid |= isInvalid(elements[i]);
+        }
+
+        if (anyInvalid)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (isInvalid(elements[i])) return i;
+            }
+        }
+
+        return count;
+    }
+}
+
+bool Model::LoadFromMemory(const void* data, size_t size)
+{
+    const auto bytes = static_cast<const uint8_t*>(data);
+    m_buffer.assign(bytes, bytes + size);
+
+    return Parse();
+}
+
+bool Model::Parse()
+{
+    m_meshes.clear();
+    m_error = { ModelError::None, uint32_t(-1), uint32_t(-1) };
+
+    const uint64_t fileSize = m_buffer.size();
+    if (fileSize < sizeof(FileHeader))
+    {
+        return Fail(ModelError::Truncated);
+    }
+
+    FileHeader header;
+    std::memcpy(&header, m_buffer.data(), sizeof(header));
+
+    if (header.Prolog != c_prolog)
+    {
+        return Fail(ModelError::Prolog); // Incorrect file format.
+    }
+
+    if (header.Version > CURRENT_FILE_VERSION)
+    {
+        return Fail(ModelError::Version); // Version mismatch between export and import serialization code.
+    }
+
+    // Mesh headers of older versions lack the trailing fields.
+    const uint32_t meshHeaderSize = header.Version >= FILE_VERSION_LOD_BOUNDS ? sizeof(MeshHeader) : offsetof(MeshHeader, LodBounds);
+
+    // Check that the metadata and the binary blob exactly fill the file before touching either.
+    const uint64_t metadataSize = uint64_t(header.MeshCount) * meshHeaderSize +
+        uint64_t(header.AccessorCount) * sizeof(Accessor) + uint64_t(header.BufferViewCount) * sizeof(BufferView);
+    const uint64_t expectedSize = sizeof(FileHeader) + metadataSize + header.BufferSize;
+
+    if (fileSize < expectedSize)
+    {
+        return Fail(ModelError::Truncated);
+    }
+
+    if (fileSize > expectedSize)
+    {
+        return Fail(ModelError::SizeMismatch); // There's a problem if we didn't completely consume the file contents.
+    }
+
+    // All metadata records are made of 32-bit fields, so they can be viewed in place, except for the
+    // mesh headers, which are widened to the current version with absent fields marked -1.
+    std::vector<MeshHeader> meshes(header.MeshCount);
+    for (uint32_t i = 0; i < header.MeshCount; ++i)
+    {
+        meshes[i].LodBounds = uint32_t(-1);
+        std::memcpy(&meshes[i], m_buffer.data() + sizeof(FileHeader) + size_t(meshHeaderSize) * i, meshHeaderSize);
+    }
+
+    const auto accessors   = reinterpret_cast<const Accessor*>(m_buffer.data() + sizeof(FileHeader) + size_t(meshHeaderSize) * header.MeshCount);
+    const auto bufferViews = reinterpret_cast<const BufferView*>(accessors + header.AccessorCount);
+    const auto blob        = m_buffer.data() + sizeof(FileHeader) + metadataSize;
+
+    // Validate every buffer view, accessor and mesh reference once, up front.
+    const uint64_t bufferSize = header.BufferSize;
+    uint32_t invalid = FindFirstInvalid(bufferViews, header.BufferViewCount,
+        [bufferSize](const BufferView& v) { return uint64_t(v.Offset) + v.Size > bufferSize; });
+    if (invalid < header.BufferViewCount)
+    {
+        return Fail(ModelError::BufferViewRange, -1, invalid);
+    }
+
+    const uint32_t bufferViewCount = header.BufferViewCount;
+    invalid = FindFirstInvalid(accessors, header.AccessorCount,
+        [bufferViewCount](const Accessor& a) { return a.BufferView >= bufferViewCount; });
+    if (invalid < header.AccessorCount)
+    {
+        return Fail(ModelError::AccessorBufferView, -1, invalid);
+    }
+
+    // The last element of an accessor starts at Offset + (Count - 1) * Stride and spans Size bytes.
+    invalid = FindFirstInvalid(accessors, header.AccessorCount, [bufferViews](const Accessor& a)
+    {
+        return (a.Count > 0) & (uint64_t(a.Offset) + uint64_t(a.Count - 1) * a.Stride + a.Size > bufferViews[a.BufferView].Size);
+    });
+    if (invalid < header.AccessorCount)
+    {
+        return Fail(ModelError::AccessorRange, -1, invalid);
+    }
+
+    for (uint32_t i = 0; i < header.MeshCount; ++i)
+    {
+        // Mesh headers are plain arrays of accessor indices; absent vertex attributes and LOD bounds are marked -1.
+        const auto refs = reinterpret_cast<const uint32_t*>(&meshes[i]);
+        const uint32_t firstAttribute = offsetof(MeshHeader, Attributes) / sizeof(uint32_t);
+        const uint32_t lodBounds = offsetof(MeshHeader, LodBounds) / sizeof(uint32_t);
+
+        for (uint32_t j = 0; j < sizeof(MeshHeader) / sizeof(uint32_t); ++j)
+        {
+            const bool isOptional = (j >= firstAttribute && j < firstAttribute + Attribute::Count) || j == lodBounds;
+            if (refs[j] >= header.AccessorCount && !(isOptional && refs[j] == uint32_t(-1)))
+            {
+                return Fail(ModelError::MeshAccessor, i, j);
+            }
+        }
+    }
+
+    // Populate mesh data from binary data and metadata.
+    m_meshes.resize(header.MeshCount);
+    for (uint32_t i = 0; i < header.MeshCount; ++i)
+    {
+        auto& meshView = meshes[i];
+        auto& mesh = m_meshes[i];
+
+        // Typed views must fit their element count and be aligned for in-place access.
+        {
+            struct TypedRef
+            {
+                uint32_t Accessor;
+                uint32_t ElementSize;
+            };
+
+            const TypedRef typedRefs[] =
+            {
+                { meshView.IndexSubsets,     sizeof(Subset) },
+                { meshView.Meshlets,         sizeof(Meshlet) },
+                { meshView.MeshletSubsets,   sizeof(Subset) },
+                { meshView.PrimitiveIndices, sizeof(PackedTriangle) },
+                { meshView.CullData,         sizeof(CullData) },
+                { meshView.LodBounds,        sizeof(LodBounds) },
+            };
+
+            for (const auto& ref : typedRefs)
+            {
+                if (ref.Accessor == uint32_t(-1))
+                {
+                    continue;
+                }
+
+                const Accessor& accessor = accessors[ref.Accessor];
+                const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+                if (bufferView.Offset % 4 != 0)
+                {
+                    return Fail(ModelError::Alignment, i, ref.Accessor);
+                }
+
+                if (uint64_t(accessor.Count) * ref.ElementSize > bufferView.Size)
+                {
+                    return Fail(ModelError::AccessorRange, i, ref.Accessor);
+                }
+            }
+        }
+
+        // Index data
+        {
+            const Accessor& accessor = accessors[meshView.Indices];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            if (accessor.Size != 2 && accessor.Size != 4)
+            {
+                return Fail(ModelError::IndexFormat, i, meshView.Indices);
+            }
+
+            if (bufferView.Offset % accessor.Size != 0)
+            {
+                return Fail(ModelError::Alignment, i, meshView.Indices);
+            }
+
+            if (uint64_t(accessor.Count) * accessor.Size > bufferView.Size)
+            {
+                return Fail(ModelError::AccessorRange, i, meshView.Indices);
+            }
+
+            mesh.IndexSize = accessor.Size;
+            mesh.IndexCount = accessor.Count;
+
+            mesh.Indices = MakeSpan(blob + bufferView.Offset, bufferView.Size);
+        }
+
+        // Index Subset data
+        {
+            const Accessor& accessor = accessors[meshView.IndexSubsets];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            mesh.IndexSubsets = MakeSpan(reinterpret_cast<Subset*>(blob + bufferView.Offset), accessor.Count);
+        }
+
+        // Vertex data & layout metadata
+        if (meshView.Attributes[Attribute::Position] == uint32_t(-1))
+        {
+            return Fail(ModelError::VertexLayout, i);
+        }
+
+        // Determine the number of unique Buffer Views associated with the vertex attributes & copy vertex buffers.
+        std::vector<uint32_t> vbMap;
+
+        for (uint32_t j = 0; j < Attribute::Count; ++j)
+        {
+            if (meshView.Attributes[j] == -1)
+                continue;
+
+            const Accessor& accessor = accessors[meshView.Attributes[j]];
+            if (accessor.Stride == 0)
+            {
+                return Fail(ModelError::VertexLayout, i, meshView.Attributes[j]);
+            }
+            
+            auto it = std::find(vbMap.begin(), vbMap.end(), accessor.BufferView);
+            if (it != vbMap.end())
+            {
+                // Already added; attributes of a stream must agree on its stride.
+                if (accessor.Stride != mesh.VertexStrides[std::distance(vbMap.begin(), it)])
+                {
+                    return Fail(ModelError::VertexLayout, i, meshView.Attributes[j]);
+                }
+
+                continue;
+            }
+
+            // New buffer view encountered; add to list and copy vertex data
+            vbMap.push_back(accessor.BufferView);
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            if ((bufferView.Offset % 4 != 0) | (accessor.Stride % 4 != 0))
+            {
+                return Fail(ModelError::Alignment, i, meshView.Attributes[j]);
+            }
+
+            Span<uint8_t> verts = MakeSpan(blob + bufferView.Offset, bufferView.Size);
+
+            mesh.VertexStrides.push_back(accessor.Stride);
+            mesh.Vertices.push_back(verts);
+
+            // The position stream comes first and sets the vertex count; every other stream must hold as many vertices.
+            const uint32_t vertexCount = static_cast<uint32_t>(verts.size()) / accessor.Stride;
+            if (vbMap.size() == 1)
+            {
+                mesh.VertexCount = vertexCount;
+            }
+            else if (vertexCount < mesh.VertexCount)
+            {
+                return Fail(ModelError::VertexLayout, i, meshView.Attributes[j]);
+            }
+        }
+
+        // Populate the vertex buffer metadata from accessors.
+        std::vector<uint32_t> vbOffsets(vbMap.size());
+
+        for (uint32_t j = 0; j < Attribute::Count; ++j)
+        {
+            mesh.AttributeStreams[j] = uint32_t(-1);
+            mesh.AttributeOffsets[j] = uint32_t(-1);
+
+            if (meshView.Attributes[j] == -1)
+                continue;
+
+            const Accessor& accessor = accessors[meshView.Attributes[j]];
+
+            // Determine which vertex buffer index holds this attribute's data
+            auto it = std::find(vbMap.begin(), vbMap.end(), accessor.BufferView);
+            const auto inputSlot = static_cast<uint32_t>(std::distance(vbMap.begin(), it));
+
+            // Elements are appended in attribute order within their vertex buffer.
+            mesh.AttributeStreams[j] = inputSlot;
+            mesh.AttributeOffsets[j] = vbOffsets[inputSlot];
+            vbOffsets[inputSlot] += c_sizeMap[j];
+
+            if (vbOffsets[inputSlot] > mesh.VertexStrides[inputSlot])
+            {
+                return Fail(ModelError::VertexLayout, i, meshView.Attributes[j]);
+            }
+        }
+
+        // Meshlet data
+        {
+            const Accessor& accessor = accessors[meshView.Meshlets];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            mesh.Meshlets = MakeSpan(reinterpret_cast<Meshlet*>(blob + bufferView.Offset), accessor.Count);
+        }
+
+        // Meshlet Subset data
+        {
+            const Accessor& accessor = accessors[meshView.MeshletSubsets];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            mesh.MeshletSubsets = MakeSpan(reinterpret_cast<Subset*>(blob + bufferView.Offset), accessor.Count);
+        }
+
+        // Unique Vertex Index data
+        {
+            const Accessor& accessor = accessors[meshView.UniqueVertexIndices];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            if (bufferView.Offset % mesh.IndexSize != 0)
+            {
+                return Fail(ModelError::Alignment, i, meshView.UniqueVertexIndices);
+            }
+
+            mesh.UniqueVertexIndices = MakeSpan(blob + bufferView.Offset, bufferView.Size);
+        }
+
+        // Primitive Index data
+        {
+            const Accessor& accessor = accessors[meshView.PrimitiveIndices];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            mesh.PrimitiveIndices = MakeSpan(reinterpret_cast<PackedTriangle*>(blob + bufferView.Offset), accessor.Count);
+        }
+
+        // Cull data
+        {
+            const Accessor& accessor = accessors[meshView.CullData];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            mesh.CullingData = MakeSpan(reinterpret_cast<CullData*>(blob + bufferView.Offset), accessor.Count);
+        }
+
+        // LOD bounds of the meshlet subsets
+        if (meshView.LodBounds != uint32_t(-1))
+        {
+            const Accessor& accessor = accessors[meshView.LodBounds];
+            const BufferView& bufferView = bufferViews[accessor.BufferView];
+
+            if (accessor.Count != mesh.MeshletSubsets.size())
+            {
+                return Fail(ModelError::LodBoundsCount, i, meshView.LodBounds);
+            }
+
+            mesh.SubsetLods = MakeSpan(reinterpret_cast<LodBounds*>(blob + bufferView.Offset), accessor.Count);
+        }
+
+        // Cross-check the meshlet ranges against the data they index into.
+        const auto meshletCount = static_cast<uint32_t>(mesh.Meshlets.size());
+        const auto indexCount = mesh.IndexCount;
+        const auto uniqueIndexCount = static_cast<uint32_t>(mesh.UniqueVertexIndices.size() / mesh.IndexSize);
+        const auto primitiveCount = static_cast<uint32_t>(mesh.PrimitiveIndices.size());
+
+        if (meshletCount == 0)
+        {
+            return Fail(ModelError::MeshletRange, i);
+        }
+
+        if (mesh.CullingData.size() < meshletCount)
+        {
+            return Fail(ModelError::CullDataCount, i, meshView.CullData);
+        }
+
+        invalid = FindFirstInvalid(mesh.IndexSubsets.data(), static_cast<uint32_t>(mesh.IndexSubsets.size()),
+            [indexCount](const Subset& s) { return uint64_t(s.Offset) + s.Count > indexCount; });
+        if (invalid < mesh.IndexSubsets.size())
+        {
+            return Fail(ModelError::SubsetRange, i, invalid);
+        }
+
+        invalid = FindFirstInvalid(mesh.MeshletSubsets.data(), static_cast<uint32_t>(mesh.MeshletSubsets.size()),
+            [meshletCount](const Subset& s) { return (s.Count == 0) | (uint64_t(s.Offset) + s.Count > meshletCount); });
+        if (invalid < mesh.MeshletSubsets.size())
+        {
+            return Fail(ModelError::SubsetRange, i, invalid);
+        }
+
+        invalid = FindFirstInvalid(mesh.Meshlets.data(), meshletCount, [uniqueIndexCount, primitiveCount](const Meshlet& m)
+        {
+            return (m.VertCount == 0) | (m.PrimCount == 0) |
+                (uint64_t(m.VertOffset) + m.VertCount > uniqueIndexCount) |
+                (uint64_t(m.PrimOffset) + m.PrimCount > primitiveCount);
+        });
+        if (invalid < meshletCount)
+        {
+            return Fail(ModelError::MeshletRange, i, invalid);
+        }
+
+        const auto vertexCount = mesh.VertexCount;
+        invalid = mesh.IndexSize == 4 ?
+            FindFirstInvalid(reinterpret_cast<const uint32_t*>(mesh.UniqueVertexIndices.data()), uniqueIndexCount,
+                [vertexCount](uint32_t v) { return v >= vertexCount; }) :
+            FindFirstInvalid(reinterpret_cast<const uint16_t*>(mesh.UniqueVertexIndices.data()), uniqueIndexCount,
+                [vertexCount](uint16_t v) { return v >= vertexCount; });
+        if (invalid < uniqueIndexCount)
+        {
+            return Fail(ModelError::VertexIndexRange, i, invalid);
+        }
+
+        invalid = mesh.IndexSize == 4 ?
+            FindFirstInvalid(reinterpret_cast<const uint32_t*>(mesh.Indices.data()), indexCount,
+                [vertexCount](uint32_t v) { return v >= vertexCount; }) :
+            FindFirstInvalid(reinterpret_cast<const uint16_t*>(mesh.Indices.data()), indexCount,
+                [vertexCount](uint16_t v) { return v >= vertexCount; });
+        if (invalid < indexCount)
+        {
+            return Fail(ModelError::IndexRange, i, invalid);
+        }
+
+        // The local indices of each primitive address the unique vertices of its meshlet only.
+        for (uint32_t j = 0; j < meshletCount; ++j)
+        {
+            const Meshlet& m = mesh.Meshlets[j];
+            const uint32_t vertCount = m.VertCount;
+            invalid = FindFirstInvalid(mesh.PrimitiveIndices.data() + m.PrimOffset, m.PrimCount, [vertCount](const PackedTriangle& t)
+            {
+                return (t.i0 >= vertCount) | (t.i1 >= vertCount) | (t.i2 >= vertCount);
+            });
+            if (invalid < m.PrimCount)
+            {
+                return Fail(ModelError::PrimitiveRange, i, m.PrimOffset + invalid);
+            }
+        }
+    }
+
+    // Build bounding spheres for each mesh
+    for (uint32_t i = 0; i < static_cast<uint32_t>(m_meshes.size()); ++i)
+    {
+        auto& m = m_meshes[i];
+
+        // Find the vertex buffer of the position attribute and its byte offset within a vertex
+        const uint32_t vbIndexPos = m.AttributeStreams[Attribute::Position];
+        const uint32_t positionOffset = m.AttributeOffsets[Attribute::Position];
+
+        XMFLOAT3* v0 = reinterpret_cast<XMFLOAT3*>(m.Vertices[vbIndexPos].data() + positionOffset);
+        uint32_t stride = m.VertexStrides[vbIndexPos];
+
+        BoundingSphere::CreateFromPoints(m.BoundingSphere, m.VertexCount, v0, stride);
+
+        if (i == 0)
+        {
+            m_boundingSphere = m.BoundingSphere;
+        }
+        else
+        {
+            BoundingSphere::CreateMerged(m_boundingSphere, m_boundingSphere, m.BoundingSphere);
+        }
+    }
+
+    return true;
+}
+
+void Model::SaveToMemory(std::vector<uint8_t>& file, const MeshData* meshes, uint32_t meshCount)
+{
+    std::vector<MeshHeader> meshHeaders(meshCount);
+    std::vector<Accessor> accessors;
+    std::vector<BufferView> bufferViews;
+    std::vector<uint8_t> buffer;
+    bool hasLodBounds = false;
+
+    // Appends the data to the binary blob as a new 4-byte aligned buffer view.
+    const auto addBufferView = [&](const void* data, size_t size)
+    {
+        const auto offset = static_cast<uint32_t>(buffer.size());
+        const auto bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+        buffer.resize(DivRoundUp(buffer.size(), 4) * 4);
+        bufferViews.push_back({ offset, static_cast<uint32_t>(size) });
+
+        return static_cast<uint32_t>(bufferViews.size() - 1);
+    };
+
+    const auto addAccessor = [&](uint32_t bufferView, uint32_t offset, uint32_t size, uint32_t stride, uint32_t count)
+    {
+        accessors.push_back({ bufferView, offset, size, stride, count });
+
+        return static_cast<uint32_t>(accessors.size() - 1);
+    };
+
+    for (uint32_t i = 0; i < meshCount; ++i)
+    {
+        const auto& mesh = meshes[i];
+        auto& meshHeader = meshHeaders[i];
+
+        // Index data
+        uint32_t view = addBufferView(mesh.Indices.data(), mesh.Indices.size());
+        meshHeader.Indices = addAccessor(view, 0, mesh.IndexSize, mesh.IndexSize, mesh.IndexCount);
+
+        view = addBufferView(mesh.IndexSubsets.data(), mesh.IndexSubsets.size() * sizeof(Subset));
+        meshHeader.IndexSubsets = addAccessor(view, 0, sizeof(Subset), sizeof(Subset), static_cast<uint32_t>(mesh.IndexSubsets.size()));
+
+        // Vertex data; all attributes share one interleaved buffer view
+        view = addBufferView(mesh.Vertices.data(), size_t(mesh.VertexStride) * mesh.VertexCount);
+        for (uint32_t j = 0; j < Attribute::Count; ++j)
+        {
+            meshHeader.Attributes[j] = mesh.AttributeOffsets[j] == uint32_t(-1) ? uint32_t(-1) :
+                addAccessor(view, mesh.AttributeOffsets[j], c_sizeMap[j], mesh.VertexStride, mesh.VertexCount);
+        }
+
+        // Meshlet data
+        view = addBufferView(mesh.Meshlets.data(), mesh.Meshlets.size() * sizeof(Meshlet));
+        meshHeader.Meshlets = addAccessor(view, 0, sizeof(Meshlet), sizeof(Meshlet), static_cast<uint32_t>(mesh.Meshlets.size()));
+
+        view = addBufferView(mesh.MeshletSubsets.data(), mesh.MeshletSubsets.size() * sizeof(Subset));
+        meshHeader.MeshletSubsets = addAccessor(view, 0, sizeof(Subset), sizeof(Subset), static_cast<uint32_t>(mesh.MeshletSubsets.size()));
+
+        view = addBufferView(mesh.UniqueVertexIndices.data(), mesh.UniqueVertexIndices.size());
+        meshHeader.UniqueVertexIndices = addAccessor(view, 0, mesh.IndexSize, mesh.IndexSize,
+            static_cast<uint32_t>(mesh.UniqueVertexIndices.size() / mesh.IndexSize));
+
+        view = addBufferView(mesh.PrimitiveIndices.data(), mesh.PrimitiveIndices.size() * sizeof(PackedTriangle));
+        meshHeader.PrimitiveIndices = addAccessor(view, 0, sizeof(PackedTriangle), sizeof(PackedTriangle),
+            static_cast<uint32_t>(mesh.PrimitiveIndices.size()));
+
+        view = addBufferView(mesh.CullingData.data(), mesh.CullingData.size() * sizeof(CullData));
+        meshHeader.CullData = addAccessor(view, 0, sizeof(CullData), sizeof(CullData), static_cast<uint32_t>(mesh.CullingData.size()));
+
+        meshHeader.LodBounds = uint32_t(-1);
+        if (!mesh.SubsetLods.empty())
+        {
+            view = addBufferView(mesh.SubsetLods.data(), mesh.SubsetLods.size() * sizeof(LodBounds));
+            meshHeader.LodBounds = addAccessor(view, 0, sizeof(LodBounds), sizeof(LodBounds), static_cast<uint32_t>(mesh.SubsetLods.size()));
+            hasLodBounds = true;
+        }
+    }
+
+    // Files without LOD bounds keep the initial layout, so older readers can still load them.
+    const uint32_t meshHeaderSize = hasLodBounds ? sizeof(MeshHeader) : offsetof(MeshHeader, LodBounds);
+
+    FileHeader header = {};
+    header.Prolog          = c_prolog;
+    header.Version         = hasLodBounds ? CURRENT_FILE_VERSION : FILE_VERSION_INITIAL;
+    header.MeshCount       = meshCount;
+    header.AccessorCount   = static_cast<uint32_t>(accessors.size());
+    header.BufferViewCount = static_cast<uint32_t>(bufferViews.size());
+    header.BufferSize      = static_cast<uint32_t>(buffer.size());
+
+    // Lay out the records in file order.
+    const auto append = [&file](const void* data, size_t size)
+    {
+        const auto bytes = static_cast<const uint8_t*>(data);
+        file.insert(file.end(), bytes, bytes + size);
+    };
+
+    file.clear();
+    file.reserve(sizeof(header) + size_t(meshHeaderSize) * meshCount + accessors.size() * sizeof(Accessor) +
+        bufferViews.size() * sizeof(BufferView) + buffer.size());
+
+    append(&header, sizeof(header));
+    for (const auto& meshHeader : meshHeaders)
+    {
+        append(&meshHeader, meshHeaderSize);
+    }
+    append(accessors.data(), accessors.size() * sizeof(accessors[0]));
+    append(bufferViews.data(), bufferViews.size() * sizeof(bufferViews[0]));
+    append(buffer.data(), buffer.size());
+}
+
+bool Model::Fail(ModelError::ECode code, uint32_t mesh, uint32_t element)
+{
+    m_meshes.clear();
+    m_error = { code, mesh, element };
+
+    return false;
+}
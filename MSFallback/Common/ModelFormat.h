@@ -0,0 +1,81 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+
+#include "Model.h"
+
+// Records of the binary model file, shared by the parser and the writer.
+namespace ModelFormat
+{
+    const uint32_t c_sizeMap[] =
+    {
+        12, // Position
+        12, // Normal
+        8,  // TexCoord
+        12, // Tangent
+        12, // Bitangent
+    };
+
+    const uint32_t c_prolog = 'MSHL';
+
+    enum FileVersion
+    {
+        FILE_VERSION_INITIAL = 0,
+        FILE_VERSION_LOD_BOUNDS = 1, // Mesh headers end with the LodBounds accessor
+        CURRENT_FILE_VERSION = FILE_VERSION_LOD_BOUNDS
+    };
+
+    struct FileHeader
+    {
+        uint32_t Prolog;
+        uint32_t Version;
+
+        uint32_t MeshCount;
+        uint32_t AccessorCount;
+        uint32_t BufferViewCount;
+        uint32_t BufferSize;
+    };
+
+    struct MeshHeader
+    {
+        uint32_t Indices;
+        uint32_t IndexSubsets;
+        uint32_t Attributes[Attribute::Count];
+
+        uint32_t Meshlets;
+        uint32_t MeshletSubsets;
+        uint32_t UniqueVertexIndices;
+        uint32_t PrimitiveIndices;
+        uint32_t CullData;
+        uint32_t LodBounds; // -1 if the mesh has no cluster LODs
+    };
+
+    struct BufferView
+    {
+        uint32_t Offset;
+        uint32_t Size;
+    };
+
+    struct Accessor
+    {
+        uint32_t BufferView;
+        uint32_t Offset;
+        uint32_t Size;
+        uint32_t Stride;
+        uint32_t Count;
+    };
+
+    template <typename T, typename U>
+    constexpr T DivRoundUp(T num, U denom)
+    {
+        return (num + denom - 1) / denom;
+    }
+}
@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Runs func(begin, end) over [0, count) in chunks of grainSize elements.
+// Idle workers grab the next unprocessed chunk, so uneven chunks balance out;
+// results stay deterministic as long as func writes to disjoint outputs per element.
+template<typename Func>
+void ParallelFor(uint32_t count, uint32_t grainSize, const Func& func, uint32_t numThreads = 0)
+{
+	if (count == 0) return;
+
+	grainSize = (std::max)(grainSize, 1u);
+	const auto numChunks = (count + grainSize - 1) / grainSize;
+
+	numThreads = numThreads ? numThreads : (std::max)(std::thread::hardware_concurrency(), 1u);
+	numThreads = (std::min)(numThreads, numChunks);
+
+	std::atomic<uint32_t> nextChunk(0);
+	const auto worker = [&]()
+	{
+		for (auto i = nextChunk++; i < numChunks; i = nextChunk++)
+		{
+			const auto begin = grainSize * i;
+			func(begin, (std::min)(begin + grainSize, count));
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for (auto i = 1u; i < numThreads; ++i) threads.emplace_back(worker);
+	worker();
+
+	for (auto& thread : threads) thread.join();
+}
@@ -0,0 +1,67 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PrimitivePacker.h"
+
+using namespace std;
+
+uint32_t GetPrimitiveIndexBits(const PackedTriangle* pPrimitiveIndices, size_t primitiveCount)
+{
+	uint32_t maxIndex = 0;
+	for (size_t i = 0; i < primitiveCount; ++i)
+	{
+		const auto& prim = pPrimitiveIndices[i];
+		maxIndex = (max)({ maxIndex, static_cast<uint32_t>(prim.i0), static_cast<uint32_t>(prim.i1), static_cast<uint32_t>(prim.i2) });
+	}
+
+	return maxIndex < (1u << 6) ? 6 : (maxIndex < (1u << 8) ? 8 : 10);
+}
+
+uint32_t GetPrimitiveStride(uint32_t indexBits)
+{
+	return indexBits < 10 ? 3 * indexBits : 32;
+}
+
+size_t GetPackedPrimitiveSize(size_t primitiveCount, uint32_t indexBits)
+{
+	const uint64_t stride = GetPrimitiveStride(indexBits);
+
+	return sizeof(uint32_t) * static_cast<size_t>((stride * primitiveCount + 31) / 32 + 1);
+}
+
+void PackPrimitives(vector<uint8_t>& packed, const PackedTriangle* pPrimitiveIndices,
+	size_t primitiveCount, uint32_t indexBits)
+{
+	const uint64_t stride = GetPrimitiveStride(indexBits);
+	vector<uint32_t> words(GetPackedPrimitiveSize(primitiveCount, indexBits) / sizeof(uint32_t));
+
+	for (size_t i = 0; i < primitiveCount; ++i)
+	{
+		const auto& prim = pPrimitiveIndices[i];
+		const auto triangle = static_cast<uint64_t>(prim.i0) | (static_cast<uint64_t>(prim.i1) << indexBits) |
+			(static_cast<uint64_t>(prim.i2) << (2 * indexBits));
+		const auto bitOffset = stride * i;
+		const auto word = static_cast<size_t>(bitOffset / 32);
+		const auto bits = triangle << (bitOffset % 32);
+		words[word] |= static_cast<uint32_t>(bits);
+		words[word + 1] |= static_cast<uint32_t>(bits >> 32);
+	}
+
+	packed.resize(sizeof(uint32_t) * words.size());
+	memcpy(packed.data(), words.data(), packed.size());
+}
+
+void UnpackPrimitive(uint32_t indices[3], const uint8_t* pPacked, size_t primitiveIndex, uint32_t indexBits)
+{
+	const auto bitOffset = static_cast<uint64_t>(GetPrimitiveStride(indexBits)) * primitiveIndex;
+	uint32_t words[2];
+	memcpy(words, &pPacked[sizeof(uint32_t) * static_cast<size_t>(bitOffset / 32)], sizeof(words));
+
+	const auto shift = static_cast<uint32_t>(bitOffset % 32);
+	const auto triangle = shift ? (words[0] >> shift) | (words[1] << (32 - shift)) : words[0];
+	const auto mask = (1u << indexBits) - 1;
+	indices[0] = triangle & mask;
+	indices[1] = (triangle >> indexBits) & mask;
+	indices[2] = (triangle >> (2 * indexBits)) & mask;
+}
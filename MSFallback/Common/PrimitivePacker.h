@@ -0,0 +1,27 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+// Repacks the 10-bit PackedTriangle primitives of a mesh into a bit stream for GetPrimitive()
+// in MSMeshlet.hlsl. Each triangle takes 3 local indices of 6, 8 or 10 bits: 18 or 24 bits
+// packed back to back, or a full word for 10 bits, which keeps the PackedTriangle layout.
+// The stream is padded by a word so that the shader can always load 2 words per triangle.
+
+// The fewest bits per local index that hold every index of the primitives
+uint32_t GetPrimitiveIndexBits(const PackedTriangle* pPrimitiveIndices, size_t primitiveCount);
+
+// Distance between triangles in the packed stream, in bits
+uint32_t GetPrimitiveStride(uint32_t indexBits);
+
+// Size of the packed stream in bytes, including the padding word
+size_t GetPackedPrimitiveSize(size_t primitiveCount, uint32_t indexBits);
+
+void PackPrimitives(std::vector<uint8_t>& packed, const PackedTriangle* pPrimitiveIndices,
+	size_t primitiveCount, uint32_t indexBits);
+
+// Decodes a triangle the same way as the shader does.
+void UnpackPrimitive(uint32_t indices[3], const uint8_t* pPacked, size_t primitiveIndex, uint32_t indexBits);
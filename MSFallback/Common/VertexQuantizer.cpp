@@ -0,0 +1,167 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "VertexQuantizer.h"
+#include "ParallelFor.h"
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	float SignNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// Maps a unit vector onto the [-1, 1] square of the octahedral projection.
+	XMFLOAT2 OctEncode(const XMFLOAT3& n)
+	{
+		const auto l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+		if (l1 <= 0.0f) return XMFLOAT2(0.0f, 0.0f);
+
+		XMFLOAT2 oct(n.x / l1, n.y / l1);
+		if (n.z < 0.0f)
+		{
+			const auto x = oct.x;
+			oct.x = (1.0f - fabsf(oct.y)) * SignNotZero(x);
+			oct.y = (1.0f - fabsf(x)) * SignNotZero(oct.y);
+		}
+
+		return oct;
+	}
+
+	XMVECTOR OctDecode(float x, float y)
+	{
+		const auto z = 1.0f - fabsf(x) - fabsf(y);
+		if (z < 0.0f)
+		{
+			const auto t = x;
+			x = (1.0f - fabsf(y)) * SignNotZero(t);
+			y = (1.0f - fabsf(t)) * SignNotZero(y);
+		}
+
+		return XMVector3Normalize(XMVectorSet(x, y, z, 0.0f));
+	}
+
+	float UnormToSnorm(uint32_t q, float maxValue)
+	{
+		return q / maxValue * 2.0f - 1.0f;
+	}
+
+	// Picks the code among the 4 neighbors of the encoded point whose decoded normal is closest.
+	void QuantizeNormal(uint32_t& x, uint32_t& y, const XMFLOAT3& n, float maxValue)
+	{
+		const auto oct = OctEncode(n);
+		const auto fx = (oct.x * 0.5f + 0.5f) * maxValue;
+		const auto fy = (oct.y * 0.5f + 0.5f) * maxValue;
+		const auto x0 = static_cast<uint32_t>(fx);
+		const auto y0 = static_cast<uint32_t>(fy);
+		const auto maxCode = static_cast<uint32_t>(maxValue);
+
+		const auto vN = XMVector3Normalize(XMLoadFloat3(&n));
+		auto bestDot = -FLT_MAX;
+		x = x0;
+		y = y0;
+		for (auto i = 0u; i < 4; ++i)
+		{
+			const auto cx = (min)(x0 + (i & 1), maxCode);
+			const auto cy = (min)(y0 + (i >> 1), maxCode);
+			const auto d = XMVectorGetX(XMVector3Dot(vN, OctDecode(UnormToSnorm(cx, maxValue), UnormToSnorm(cy, maxValue))));
+			if (d > bestDot)
+			{
+				bestDot = d;
+				x = cx;
+				y = cy;
+			}
+		}
+	}
+}
+
+VertexQuantizer::VertexQuantizer(uint32_t numThreads) :
+	m_numThreads(numThreads)
+{
+}
+
+VertexQuantizer::~VertexQuantizer()
+{
+}
+
+bool VertexQuantizer::Quantize(vector<uint8_t>& quantized, XMFLOAT3& positionBias, XMFLOAT3& positionScale,
+	const uint8_t* pVertices, uint32_t vertexStride, uint32_t vertexCount, uint32_t positionOffset,
+	uint32_t normalOffset, uint8_t normalBits) const
+{
+	if (normalBits != 8 && normalBits != 16) return false;
+	if (positionOffset + sizeof(XMFLOAT3) > vertexStride || normalOffset + sizeof(XMFLOAT3) > vertexStride) return false;
+
+	// Bounds of the positions
+	auto vMin = XMVectorReplicate(FLT_MAX);
+	auto vMax = XMVectorReplicate(-FLT_MAX);
+	for (auto i = 0u; i < vertexCount; ++i)
+	{
+		const auto p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pVertices[static_cast<size_t>(vertexStride) * i + positionOffset]));
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+	if (vertexCount == 0) vMin = vMax = g_XMZero;
+
+	const auto extent = vMax - vMin;
+	const auto vScale = extent / 65535.0f;
+	const auto vInvScale = XMVectorSelect(XMVectorReciprocal(vScale), g_XMZero, XMVectorEqual(extent, g_XMZero));
+	XMStoreFloat3(&positionBias, vMin);
+	XMStoreFloat3(&positionScale, vScale);
+
+	const auto stride = GetStride(normalBits);
+	quantized.resize(static_cast<size_t>(stride) * vertexCount);
+
+	const auto maxNormal = static_cast<float>((1u << normalBits) - 1);
+	ParallelFor(vertexCount, 4096, [&](uint32_t begin, uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pVertex = &pVertices[static_cast<size_t>(vertexStride) * i];
+			const auto p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pVertex[positionOffset]));
+			const auto q = XMVectorClamp(XMVectorRound((p - vMin) * vInvScale), g_XMZero, XMVectorReplicate(65535.0f));
+			XMUINT3 qPos;
+			XMStoreUInt3(&qPos, XMConvertVectorFloatToUInt(q, 0));
+
+			XMFLOAT3 n;
+			memcpy(&n, &pVertex[normalOffset], sizeof(XMFLOAT3));
+			uint32_t octX, octY;
+			QuantizeNormal(octX, octY, n, maxNormal);
+
+			const auto pDst = reinterpret_cast<uint32_t*>(&quantized[static_cast<size_t>(stride) * i]);
+			pDst[0] = qPos.x | (qPos.y << 16);
+			if (normalBits == 8) pDst[1] = qPos.z | (octX << 16) | (octY << 24);
+			else
+			{
+				pDst[1] = qPos.z;
+				pDst[2] = octX | (octY << 16);
+			}
+		}
+	}, m_numThreads);
+
+	return true;
+}
+
+void VertexQuantizer::Dequantize(XMFLOAT3& position, XMFLOAT3& normal, const uint8_t* pVertex,
+	const XMFLOAT3& positionBias, const XMFLOAT3& positionScale, uint8_t normalBits)
+{
+	uint32_t words[3] = {};
+	memcpy(words, pVertex, GetStride(normalBits));
+
+	const auto q = XMVectorSet(static_cast<float>(words[0] & 0xffff),
+		static_cast<float>(words[0] >> 16), static_cast<float>(words[1] & 0xffff), 0.0f);
+	XMStoreFloat3(&position, XMVectorMultiplyAdd(q, XMLoadFloat3(&positionScale), XMLoadFloat3(&positionBias)));
+
+	const auto maxNormal = static_cast<float>((1u << normalBits) - 1);
+	const auto octX = normalBits == 8 ? (words[1] >> 16) & 0xff : words[2] & 0xffff;
+	const auto octY = normalBits == 8 ? words[1] >> 24 : words[2] >> 16;
+	XMStoreFloat3(&normal, OctDecode(UnormToSnorm(octX, maxNormal), UnormToSnorm(octY, maxNormal)));
+}
+
+uint32_t VertexQuantizer::GetStride(uint8_t normalBits)
+{
+	return normalBits == 8 ? sizeof(uint32_t[2]) : sizeof(uint32_t[3]);
+}
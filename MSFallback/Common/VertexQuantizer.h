@@ -0,0 +1,31 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+// Compresses vertices for GetVertexAttributes() in MSMeshlet.hlsl. Positions become 16-bit
+// unorms within the bounds of the mesh (position = bias + unorm * scale), and normals are
+// octahedral unorms of 8 or 16 bits per component. A vertex with 8-bit normals takes 8 bytes
+// (xy, z | oct.x | oct.y), and one with 16-bit normals 12 bytes (xy, z, oct.xy).
+class VertexQuantizer
+{
+public:
+	VertexQuantizer(uint32_t numThreads = 0);
+	virtual ~VertexQuantizer();
+
+	bool Quantize(std::vector<uint8_t>& quantized, DirectX::XMFLOAT3& positionBias,
+		DirectX::XMFLOAT3& positionScale, const uint8_t* pVertices, uint32_t vertexStride,
+		uint32_t vertexCount, uint32_t positionOffset, uint32_t normalOffset, uint8_t normalBits) const;
+
+	// Decodes a quantized vertex the same way as the shader does.
+	static void Dequantize(DirectX::XMFLOAT3& position, DirectX::XMFLOAT3& normal, const uint8_t* pVertex,
+		const DirectX::XMFLOAT3& positionBias, const DirectX::XMFLOAT3& positionScale, uint8_t normalBits);
+
+	static uint32_t GetStride(uint8_t normalBits);
+
+protected:
+	uint32_t m_numThreads;
+};
@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ConstantAllocator.h"
+
+using namespace std;
+using namespace XUSG;
+
+ConstantAllocator::ConstantAllocator() :
+	m_pFrameData(nullptr),
+	m_frameOffset(0),
+	m_frameSize(0),
+	m_allocatedSize(0)
+{
+}
+
+ConstantAllocator::~ConstantAllocator()
+{
+}
+
+bool ConstantAllocator::Init(const Device* pDevice, size_t byteWidthPerFrame, uint8_t frameCount, const wchar_t* name)
+{
+	m_frameSize = XUSG_DIV_UP(byteWidthPerFrame, SlotAlignment) * SlotAlignment;
+
+	vector<size_t> offsets(frameCount);
+	for (uint8_t i = 0; i < frameCount; ++i) offsets[i] = m_frameSize * i;
+
+	m_buffer = ConstantBuffer::MakeUnique();
+	XUSG_N_RETURN(m_buffer->Create(pDevice, m_frameSize * frameCount, frameCount, offsets.data(),
+		MemoryType::UPLOAD, MemoryFlag::NONE, name), false);
+
+	return true;
+}
+
+void ConstantAllocator::Reset(uint8_t frameIndex)
+{
+	m_pFrameData = reinterpret_cast<uint8_t*>(m_buffer->Map(frameIndex));
+	m_frameOffset = m_buffer->GetCBVOffset(frameIndex);
+	m_allocatedSize = 0;
+}
+
+void* ConstantAllocator::Allocate(size_t byteSize, int& offset)
+{
+	byteSize = XUSG_DIV_UP(byteSize, SlotAlignment) * SlotAlignment;
+	if (m_allocatedSize + byteSize > m_frameSize) return nullptr;
+
+	const auto pData = &m_pFrameData[m_allocatedSize];
+	offset = static_cast<int>(m_frameOffset + m_allocatedSize);
+	m_allocatedSize += byteSize;
+
+	return pData;
+}
+
+const ConstantBuffer* ConstantAllocator::GetBuffer() const
+{
+	return m_buffer.get();
+}
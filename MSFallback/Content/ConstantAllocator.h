@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+
+// Per-frame linear allocator of constant-buffer slots in one persistently mapped upload
+// buffer, with a region per frame. Slots are bump-allocated from the region of the current
+// frame, and bound as root CBVs of the buffer at the returned offsets.
+class ConstantAllocator
+{
+public:
+	ConstantAllocator();
+	virtual ~ConstantAllocator();
+
+	bool Init(const XUSG::Device* pDevice, size_t byteWidthPerFrame, uint8_t frameCount, const wchar_t* name = nullptr);
+
+	// Restarts allocating from the region of the frame, which the GPU must be done with.
+	void Reset(uint8_t frameIndex);
+
+	// Returns the mapped memory of the slot, or nullptr if the frame region is full, and
+	// the root-CBV offset of the slot in offset.
+	void* Allocate(size_t byteSize, int& offset);
+
+	const XUSG::ConstantBuffer* GetBuffer() const;
+
+	static const uint32_t SlotAlignment = 256;
+
+protected:
+	XUSG::ConstantBuffer::uptr m_buffer;
+
+	uint8_t*	m_pFrameData;
+	size_t		m_frameOffset;
+	size_t		m_frameSize;
+	size_t		m_allocatedSize;
+};
@@ -0,0 +1,177 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "GeometryPool.h"
+
+using namespace std;
+using namespace XUSG;
+
+GeometryPool::GeometryPool() :
+	m_streamSizes()
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+}
+
+uint32_t GeometryPool::AddMesh(const MeshInfo& info, size_t vertexByteWidth, size_t uniqueVertexIndexByteWidth,
+	size_t primitiveByteWidth)
+{
+	MeshRegions regions;
+	regions.ByteWidths[VERTICES] = vertexByteWidth;
+	regions.ByteWidths[MESHLETS] = sizeof(Meshlet) * info.MeshletCount;
+	regions.ByteWidths[CULL_DATA] = sizeof(CullData) * info.MeshletCount;
+	regions.ByteWidths[MESHLET_LODS] = sizeof(LodBounds) * info.MeshletCount;
+	regions.ByteWidths[UNIQUE_VERTEX_INDICES] = uniqueVertexIndexByteWidth;
+	regions.ByteWidths[PRIMITIVES] = primitiveByteWidth;
+	for (uint8_t i = 0; i < STREAM_COUNT; ++i)
+		regions.Offsets[i] = reserve(static_cast<StreamID>(i), regions.ByteWidths[i]);
+
+	auto meshInfo = info;
+	meshInfo.VertexOffset = regions.Offsets[VERTICES];
+	meshInfo.UniqueVertexIndexOffset = regions.Offsets[UNIQUE_VERTEX_INDICES];
+	meshInfo.PrimitiveOffset = regions.Offsets[PRIMITIVES];
+
+	// The meshlets, their cull data and LOD bounds are all indexed by the first meshlet of the mesh.
+	meshInfo.MeshletOffset = regions.Offsets[MESHLETS] / sizeof(Meshlet);
+	assert(meshInfo.MeshletOffset == regions.Offsets[CULL_DATA] / sizeof(CullData));
+	assert(meshInfo.MeshletOffset == regions.Offsets[MESHLET_LODS] / sizeof(LodBounds));
+
+	m_meshInfos.emplace_back(meshInfo);
+	m_meshRegions.emplace_back(regions);
+
+	return static_cast<uint32_t>(m_meshInfos.size() - 1);
+}
+
+bool GeometryPool::Create(const Device* pDevice, DescriptorTableLib* pDescriptorTableLib)
+{
+	m_vertices = RawBuffer::MakeUnique();
+	XUSG_N_RETURN(m_vertices->Create(pDevice, m_streamSizes[VERTICES], ResourceFlag::NONE, MemoryType::DEFAULT,
+		1, nullptr, 1, nullptr, MemoryFlag::NONE, L"PooledVertices"), false);
+
+	m_uniqueVertexIndices = RawBuffer::MakeUnique();
+	XUSG_N_RETURN(m_uniqueVertexIndices->Create(pDevice, m_streamSizes[UNIQUE_VERTEX_INDICES], ResourceFlag::NONE,
+		MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"PooledUniqueVertexIndices"), false);
+
+	m_primitives = RawBuffer::MakeUnique();
+	XUSG_N_RETURN(m_primitives->Create(pDevice, m_streamSizes[PRIMITIVES], ResourceFlag::NONE, MemoryType::DEFAULT,
+		1, nullptr, 1, nullptr, MemoryFlag::NONE, L"PooledPrimitives"), false);
+
+	m_meshlets = StructuredBuffer::MakeUnique();
+	XUSG_N_RETURN(m_meshlets->Create(pDevice, m_streamSizes[MESHLETS] / sizeof(Meshlet), sizeof(Meshlet),
+		ResourceFlag::NONE, MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"PooledMeshlets"), false);
+
+	m_meshletCullData = StructuredBuffer::MakeUnique();
+	XUSG_N_RETURN(m_meshletCullData->Create(pDevice, m_streamSizes[CULL_DATA] / sizeof(CullData), sizeof(CullData),
+		ResourceFlag::NONE, MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"PooledMeshletCullData"), false);
+
+	m_meshletLods = StructuredBuffer::MakeUnique();
+	XUSG_N_RETURN(m_meshletLods->Create(pDevice, m_streamSizes[MESHLET_LODS] / sizeof(LodBounds), sizeof(LodBounds),
+		ResourceFlag::NONE, MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"PooledMeshletLods"), false);
+
+	m_meshInfoBuffer = StructuredBuffer::MakeUnique();
+	XUSG_N_RETURN(m_meshInfoBuffer->Create(pDevice, m_meshInfos.size(), sizeof(MeshInfo), ResourceFlag::NONE,
+		MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"MeshInfos"), false);
+
+	{
+		const Descriptor descriptors[] =
+		{
+			m_vertices->GetSRV(),
+			m_meshlets->GetSRV(),
+			m_uniqueVertexIndices->GetSRV(),
+			m_primitives->GetSRV()
+		};
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		XUSG_X_RETURN(m_srvTable, descriptorTable->GetCbvSrvUavTable(pDescriptorTableLib), false);
+	}
+
+	return true;
+}
+
+bool GeometryPool::UploadMesh(StagingRing* pStagingRing, uint32_t meshId, const MeshInfo& info,
+	const uint8_t* pVertices, const Meshlet* pMeshlets, const CullData* pCullData,
+	const LodBounds* pLodBounds, const uint8_t* pUniqueVertexIndices, const uint8_t* pPrimitives)
+{
+	auto& meshInfo = m_meshInfos[meshId];
+	assert(info.MeshletCount == meshInfo.MeshletCount);
+	const auto vertexOffset = meshInfo.VertexOffset;
+	const auto uniqueVertexIndexOffset = meshInfo.UniqueVertexIndexOffset;
+	const auto primitiveOffset = meshInfo.PrimitiveOffset;
+	const auto meshletOffset = meshInfo.MeshletOffset;
+	meshInfo = info;
+	meshInfo.VertexOffset = vertexOffset;
+	meshInfo.UniqueVertexIndexOffset = uniqueVertexIndexOffset;
+	meshInfo.PrimitiveOffset = primitiveOffset;
+	meshInfo.MeshletOffset = meshletOffset;
+
+	Resource* const pStreams[] =
+	{
+		m_vertices.get(),
+		m_meshlets.get(),
+		m_meshletCullData.get(),
+		m_meshletLods.get(),
+		m_uniqueVertexIndices.get(),
+		m_primitives.get()
+	};
+
+	const void* const pData[] =
+	{
+		pVertices,
+		pMeshlets,
+		pCullData,
+		pLodBounds,
+		pUniqueVertexIndices,
+		pPrimitives
+	};
+
+	const auto& regions = m_meshRegions[meshId];
+	for (uint8_t i = 0; i < STREAM_COUNT; ++i)
+		XUSG_N_RETURN(pStagingRing->Upload(pStreams[i], regions.Offsets[i], pData[i], regions.ByteWidths[i],
+			ResourceState::NON_PIXEL_SHADER_RESOURCE), false);
+
+	return pStagingRing->Upload(m_meshInfoBuffer.get(), sizeof(MeshInfo) * meshId, &meshInfo,
+		sizeof(MeshInfo), ResourceState::NON_PIXEL_SHADER_RESOURCE);
+}
+
+const DescriptorTable& GeometryPool::GetSrvTable() const
+{
+	return m_srvTable;
+}
+
+const StructuredBuffer* GeometryPool::GetMeshletCullData() const
+{
+	return m_meshletCullData.get();
+}
+
+const StructuredBuffer* GeometryPool::GetMeshletLods() const
+{
+	return m_meshletLods.get();
+}
+
+const StructuredBuffer* GeometryPool::GetMeshInfos() const
+{
+	return m_meshInfoBuffer.get();
+}
+
+const MeshInfo& GeometryPool::GetMeshInfo(uint32_t meshId) const
+{
+	return m_meshInfos[meshId];
+}
+
+uint32_t GeometryPool::GetMeshCount() const
+{
+	return static_cast<uint32_t>(m_meshInfos.size());
+}
+
+uint32_t GeometryPool::reserve(StreamID stream, size_t byteWidth)
+{
+	// Keep every region 4-byte aligned for the loads of ByteAddressBuffer.
+	auto& streamSize = m_streamSizes[stream];
+	const auto offset = XUSG_DIV_UP(streamSize, sizeof(uint32_t)) * sizeof(uint32_t);
+	streamSize = offset + byteWidth;
+
+	return static_cast<uint32_t>(offset);
+}
@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "StagingRing.h"
+#include "Model.h"
+
+// Geometry of all meshes suballocated from a few shared buffers: vertices, meshlets, unique
+// vertex indices, packed primitives, meshlet cull data and LOD bounds, plus a MeshInfo record per mesh with
+// its offsets into them. Shaders index the records by mesh ID, so that the whole pool is bound
+// once per frame instead of once per mesh. The pool is sized by reserving every mesh first, and
+// the geometry of each mesh is then streamed into the created buffers through the staging ring,
+// so that no CPU copy of the whole pool is needed.
+class GeometryPool
+{
+public:
+	GeometryPool();
+	virtual ~GeometryPool();
+
+	// Reserves the geometry of a mesh, and returns its mesh ID. The offsets of info are filled in
+	// by the pool. The cull data and the LOD bounds have one entry per meshlet.
+	uint32_t AddMesh(const MeshInfo& info, size_t vertexByteWidth, size_t uniqueVertexIndexByteWidth,
+		size_t primitiveByteWidth);
+
+	// Creates the pool buffers for all meshes reserved.
+	bool Create(const XUSG::Device* pDevice, XUSG::DescriptorTableLib* pDescriptorTableLib);
+
+	// Uploads the geometry of a reserved mesh through the staging ring, along with its final
+	// MeshInfo, which keeps the reserved offsets and sizes.
+	bool UploadMesh(StagingRing* pStagingRing, uint32_t meshId, const MeshInfo& info,
+		const uint8_t* pVertices, const Meshlet* pMeshlets, const CullData* pCullData,
+		const LodBounds* pLodBounds, const uint8_t* pUniqueVertexIndices, const uint8_t* pPrimitives);
+
+	// Vertices, meshlets, unique vertex indices and primitives, as t0-t3
+	const XUSG::DescriptorTable& GetSrvTable() const;
+	const XUSG::StructuredBuffer* GetMeshletCullData() const;
+	const XUSG::StructuredBuffer* GetMeshletLods() const;
+	const XUSG::StructuredBuffer* GetMeshInfos() const;
+	const MeshInfo& GetMeshInfo(uint32_t meshId) const;
+	uint32_t GetMeshCount() const;
+
+protected:
+	enum StreamID : uint8_t
+	{
+		VERTICES,
+		MESHLETS,
+		CULL_DATA,
+		MESHLET_LODS,
+		UNIQUE_VERTEX_INDICES,
+		PRIMITIVES,
+
+		STREAM_COUNT
+	};
+
+	// Regions of a mesh in the streams
+	struct MeshRegions
+	{
+		uint32_t Offsets[STREAM_COUNT];
+		size_t ByteWidths[STREAM_COUNT];
+	};
+
+	// Returns the offset of a new region of the stream.
+	uint32_t reserve(StreamID stream, size_t byteWidth);
+
+	std::vector<MeshInfo>		m_meshInfos;
+	std::vector<MeshRegions>	m_meshRegions;
+	size_t						m_streamSizes[STREAM_COUNT];
+
+	XUSG::DescriptorTable			m_srvTable;
+	XUSG::RawBuffer::uptr			m_vertices;
+	XUSG::StructuredBuffer::uptr	m_meshlets;
+	XUSG::RawBuffer::uptr			m_uniqueVertexIndices;
+	XUSG::RawBuffer::uptr			m_primitives;
+	XUSG::StructuredBuffer::uptr	m_meshletCullData;
+	XUSG::StructuredBuffer::uptr	m_meshletLods;
+	XUSG::StructuredBuffer::uptr	m_meshInfoBuffer;
+};
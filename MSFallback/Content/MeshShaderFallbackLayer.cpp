@@ -232,6 +232,11 @@ void MeshShaderFallbackLayer::EnableNativeMeshShader(bool enable)
 	m_useNative = enable && m_isMSSupported;
 }
 
+bool MeshShaderFallbackLayer::IsNativeMeshShaderEnabled() const
+{
+	return m_useNative;
+}
+
 void MeshShaderFallbackLayer::SetPipelineLayout(CommandList* pCommandList, const PipelineLayout& pipelineLayout)
 {
 	if (m_useNative) pCommandList->SetGraphicsPipelineLayout(pipelineLayout.m_native);
@@ -287,7 +292,7 @@ void MeshShaderFallbackLayer::Set32BitConstant(CommandList* pCommandList, uint32
 			auto& command = commands[indexPair.Cmd];
 
 			command.Index = indexPair.Prm;
-			if (command.Constants.size() <= destOffsetIn32BitValues) commands.resize(destOffsetIn32BitValues + 1);
+			if (command.Constants.size() <= destOffsetIn32BitValues) command.Constants.resize(destOffsetIn32BitValues + 1);
 			command.Constants[destOffsetIn32BitValues] = srcData;
 		}
 	}
@@ -307,8 +312,9 @@ void MeshShaderFallbackLayer::Set32BitConstants(CommandList* pCommandList, uint3
 			auto& command = commands[indexPair.Cmd];
 
 			command.Index = indexPair.Prm;
-			if (command.Constants.size() < num32BitValuesToSet) commands.resize(num32BitValuesToSet);
-			memcpy(command.Constants.data(), &reinterpret_cast<const uint32_t*>(pSrcData)[destOffsetIn32BitValues], sizeof(uint32_t) * num32BitValuesToSet);
+			const auto numConstants = destOffsetIn32BitValues + num32BitValuesToSet;
+			if (command.Constants.size() < numConstants) command.Constants.resize(numConstants);
+			memcpy(&command.Constants[destOffsetIn32BitValues], pSrcData, sizeof(uint32_t) * num32BitValuesToSet);
 		}
 	}
 }
@@ -81,6 +81,7 @@ public:
 		const wchar_t* name = nullptr);
 
 	void EnableNativeMeshShader(bool enable);
+	bool IsNativeMeshShaderEnabled() const;
 	void SetPipelineLayout(XUSG::CommandList* pCommandList, const PipelineLayout& pipelineLayout);
 	void SetPipelineState(XUSG::CommandList* pCommandList, const Pipeline& pipeline);
 	void SetDescriptorTable(XUSG::CommandList* pCommandList, uint32_t index, const XUSG::DescriptorTable& descriptorTable);
@@ -4,12 +4,33 @@
 
 #include "SharedConst.h"
 #include "Renderer.h"
+#include "PrimitivePacker.h"
+#include "VertexQuantizer.h"
 
 using namespace std;
 using namespace DirectX;
 using namespace XUSG;
 
-Renderer::Renderer()
+namespace
+{
+	// Sphere-frustum test with the same semantics as IsVisible() in ASMeshlet.hlsl.
+	bool IsSphereVisible(FXMVECTOR center, float radius, const XMVECTOR* pPlanes)
+	{
+		for (auto i = 0u; i < 6; ++i)
+			if (XMVectorGetX(XMPlaneDotCoord(pPlanes[i], center)) < -radius) return false;
+
+		return true;
+	}
+}
+
+Renderer::Renderer() :
+	m_cbGlobalsOffset(0),
+	m_instanceCount(0),
+	m_staleInstanceFrames(0),
+	m_maxBatchCount(0),
+	m_culledObjectCount(0),
+	m_culledMeshCount(0),
+	m_culledSubsetCount(0)
 {
 	m_shaderLib = ShaderLib::MakeUnique();
 }
@@ -19,7 +40,7 @@ Renderer::~Renderer()
 }
 
 bool Renderer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& descriptorTableLib,
-	uint32_t width, uint32_t height, Format rtFormat, vector<Resource::uptr>& uploaders, uint32_t objCount,
+	uint32_t width, uint32_t height, Format rtFormat, StagingRing* pStagingRing, uint32_t objCount,
 	const wstring* pFileNames, const ObjectDef* pObjDefs, bool isMSSupported)
 {
 	const auto pDevice = pCommandList->GetDevice();
@@ -37,44 +58,87 @@ bool Renderer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& d
 	m_sceneObjects.resize(objCount);
 	for (auto i = 0u; i < objCount; ++i)
 	{
-		Model model;
-		model.LoadFromFile(pFileNames[i].c_str());
-		const auto meshCount = model.GetMeshCount();
-
 		const auto& def = pObjDefs[i];
 		auto& obj = m_sceneObjects[i];
-		obj.Meshes.resize(meshCount);
+		obj.Flags = (def.Cull ? CULL_FLAG : 0) | (def.DrawMeshlets ? MESHLET_FLAG : 0);
+		obj.Lod = 0;
+
+		Model model;
+		XUSG_N_RETURN(model.LoadFromFile(pFileNames[i].c_str()), false);
+		obj.BoundingSphere = model.GetBoundingSphere();
+		obj.Lods.emplace_back();
+		XUSG_N_RETURN(createObjectMeshes(obj.Lods.back(), model, def.VertexFormat), false);
+
+		// Load the coarser LODs, if any, until the next one is missing
+		for (auto lod = 1u; lod < MaxLodCount; ++lod)
+		{
+			const auto fileName = Model::GetLodFileName(pFileNames[i].c_str(), lod);
+			if (!model.LoadFromFile(fileName.c_str()))
+			{
+				XUSG_N_RETURN(model.GetLoadError().Code == ModelError::FileOpen, false);
+				break;
+			}
+
+			obj.Lods.emplace_back();
+			XUSG_N_RETURN(createObjectMeshes(obj.Lods.back(), model, def.VertexFormat), false);
+		}
 
-		for (auto j = 0u; j < meshCount; ++j)
+		// Convert the transform definition to a transform per instance. The instances are
+		// one bounding-sphere diameter apart, on a square grid centered at the position.
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&def.Rotation)));
+		obj.FirstInstance = m_transforms.GetCount();
+		obj.InstanceCount = (max)(def.InstanceCount, 1u);
+		const auto gridSize = static_cast<uint32_t>(ceilf(sqrtf(static_cast<float>(obj.InstanceCount))));
+		const auto gridCenter = 0.5f * (gridSize - 1);
+		const auto spacing = 2.0f * obj.BoundingSphere.Radius * def.Scale;
+		for (auto j = 0u; j < obj.InstanceCount; ++j)
 		{
-			auto& mesh = obj.Meshes[j];
-			const auto& meshData = model.GetMesh(j);
-			mesh.Subsets.resize(meshData.MeshletSubsets.size());
-			memcpy(mesh.Subsets.data(), meshData.MeshletSubsets.data(), sizeof(Subset) * meshData.MeshletSubsets.size());
-			mesh.MeshletCount = static_cast<uint32_t>(meshData.Meshlets.size());
-			XUSG_N_RETURN(createMeshBuffers(pCommandList, mesh, meshData, uploaders), false);
+			const auto offset = XMVectorSet(j % gridSize - gridCenter, 0.0f, j / gridSize - gridCenter, 0.0f) * spacing;
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, XMLoadFloat3(&def.Position) + offset);
+			m_transforms.Add(position, rotation, def.Scale, obj.Flags);
 		}
 
-		// Convert the transform definition to a matrix
-		XMMATRIX world = XMMatrixAffineTransformation(
-			XMVectorReplicate(def.Scale),
-			g_XMZero,
-			XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&def.Rotation)),
-			XMLoadFloat3(&def.Position)
-		);
-		XMStoreFloat3x4(&obj.World, world);
-
-		obj.Instance = ConstantBuffer::MakeUnique();
-		XUSG_N_RETURN(obj.Instance->Create(pDevice, sizeof(Instance[FrameCount]), FrameCount,
-			nullptr, MemoryType::UPLOAD, MemoryFlag::NONE, L"CBInstance"), false);
+		updateBounds(obj);
+	}
+
+	// Create the shared pool buffers, now that all meshes are reserved, and stream the geometry
+	// into them. The models are loaded again, so that only one of them is in memory at a time.
+	XUSG_N_RETURN(m_geometryPool.Create(pDevice, m_descriptorTableLib.get()), false);
+	for (auto i = 0u; i < objCount; ++i)
+	{
+		auto& obj = m_sceneObjects[i];
+		for (auto lod = 0u; lod < obj.Lods.size(); ++lod)
+		{
+			const auto fileName = lod > 0 ? Model::GetLodFileName(pFileNames[i].c_str(), lod) : pFileNames[i];
+			Model model;
+			XUSG_N_RETURN(model.LoadFromFile(fileName.c_str()), false);
+			XUSG_N_RETURN(uploadObjectMeshes(obj.Lods[lod], model, pStagingRing), false);
+		}
+	}
+	pStagingRing->Flush(pCommandList);
+
+	// Create the instance buffer, with a copy of all instances per frame
+	{
+		m_instanceCount = m_transforms.GetCount();
+		m_instanceData.resize(m_instanceCount);
+		uintptr_t firstElements[FrameCount];
+		for (uint8_t i = 0; i < FrameCount; ++i) firstElements[i] = static_cast<uintptr_t>(m_instanceCount) * i;
+
+		m_instances = StructuredBuffer::MakeUnique();
+		XUSG_N_RETURN(m_instances->Create(pDevice, static_cast<size_t>(m_instanceCount) * FrameCount, sizeof(Instance),
+			ResourceFlag::NONE, MemoryType::UPLOAD, FrameCount, firstElements, 0, nullptr,
+			MemoryFlag::NONE, L"Instances"), false);
 	}
 
 	// Init mesh-shader fallback layer
 	{
 		auto maxMeshletCount = 0u;
 		for (auto& obj : m_sceneObjects)
-			for (auto& mesh : obj.Meshes)
-				maxMeshletCount = (max)(mesh.MeshletCount, maxMeshletCount);
+			for (auto& meshes : obj.Lods)
+				for (auto& mesh : meshes)
+					maxMeshletCount = (max)(mesh.MeshletCount, maxMeshletCount);
 
 		struct VertexOut
 		{
@@ -84,7 +148,9 @@ bool Renderer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& d
 			uint32_t MeshletIndex;
 		};
 
-		XUSG_N_RETURN(m_meshShaderFallbackLayer->Init(pDevice, m_descriptorTableLib.get(), maxMeshletCount,
+		// The batches of several instances are laid out back to back, so reserve whole batches.
+		m_maxBatchCount = XUSG_DIV_UP(maxMeshletCount, AS_GROUP_SIZE);
+		XUSG_N_RETURN(m_meshShaderFallbackLayer->Init(pDevice, m_descriptorTableLib.get(), AS_GROUP_SIZE * m_maxBatchCount,
 			MAX_VERTS, MAX_PRIMS, sizeof(VertexOut), AS_GROUP_SIZE), false);
 	}
 
@@ -95,17 +161,20 @@ bool Renderer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& d
 	// Create pipelines
 	XUSG_N_RETURN(createPipelineLayouts(pDevice, isMSSupported), false);
 	XUSG_N_RETURN(createPipelines(rtFormat, m_depth->GetFormat(), isMSSupported), false);
-	XUSG_N_RETURN(createDescriptorTables(), false);
 
-	m_cbGlobals = ConstantBuffer::MakeUnique();
-	XUSG_N_RETURN(m_cbGlobals->Create(pDevice, sizeof(Constants[FrameCount]), FrameCount,
-		nullptr, MemoryType::UPLOAD, MemoryFlag::NONE, L"CBGbolals"), false);
+	// Create the per-frame constants
+	XUSG_N_RETURN(m_constantAllocator.Init(pDevice, sizeof(Constants), FrameCount, L"FrameConstants"), false);
 
 	return true;
 }
 
-void Renderer::UpdateFrame(uint8_t frameIndex, CXMMATRIX view, const DirectX::XMMATRIX* pProj, const XMFLOAT3& eyePt)
+bool Renderer::UpdateFrame(uint8_t frameIndex, CXMMATRIX view, const DirectX::XMMATRIX* pProj, const XMFLOAT3& eyePt)
 {
+	XMVECTOR lodEyePt, cullPlanes[6];
+	float lodProjScale;
+
+	m_constantAllocator.Reset(frameIndex);
+
 	// Global constants
 	{
 		// Calculate the debug camera's properties to extract plane data.
@@ -129,9 +198,12 @@ void Renderer::UpdateFrame(uint8_t frameIndex, CXMMATRIX view, const DirectX::XM
 
 		const auto mainView = pProj ? view : cullView;
 		const auto& proj = pProj ? *pProj : cullProj;
+		lodEyePt = pProj ? XMLoadFloat3(&eyePt) : cullEyePt;
+		lodProjScale = XMVectorGetY(proj.r[1]);
 
 		// Set constant data to be read by the shaders.
-		const auto pCbData = reinterpret_cast<Constants*>(m_cbGlobals->Map(frameIndex));
+		const auto pCbData = reinterpret_cast<Constants*>(m_constantAllocator.Allocate(sizeof(Constants), m_cbGlobalsOffset));
+		if (!pCbData) return false;
 
 		pCbData->ViewPosition = eyePt;
 		pCbData->HighlightedIndex = -1;
@@ -142,39 +214,123 @@ void Renderer::UpdateFrame(uint8_t frameIndex, CXMMATRIX view, const DirectX::XM
 		XMStoreFloat4x4(&pCbData->ViewProj, XMMatrixTranspose(mainView * proj));
 		XMStoreFloat3(&pCbData->CullViewPosition, cullEyePt);
 
+		// Meshlet LODs are selected by their error in pixels, so that the triangle counts follow
+		// the resolution of the viewport.
+		XMStoreFloat3(&pCbData->LodViewPosition, lodEyePt);
+		pCbData->LodErrorThreshold = g_lodErrorThreshold;
+		pCbData->LodErrorScale = 0.5f * lodProjScale * m_viewport.y;
+
 		for (uint32_t i = 0; i < size(planes); ++i)
+		{
 			XMStoreFloat4(&pCbData->Planes[i], planes[i]);
+			cullPlanes[i] = planes[i];
+		}
 	}
 
-	// Per instance
-	for (auto& obj : m_sceneObjects)
+	// Per instance: only the moved instances are rebuilt, and the copy of each frame in the
+	// instance buffer is refreshed once after every change, in one contiguous write.
+	if (m_transforms.Update(m_instanceData.data()) > 0) m_staleInstanceFrames = FrameCount;
+	if (m_staleInstanceFrames > 0)
 	{
-		const auto world = XMLoadFloat3x4(&obj.World);
+		memcpy(m_instances->Map(frameIndex), m_instanceData.data(), sizeof(Instance) * m_instanceData.size());
+		--m_staleInstanceFrames;
+	}
 
-		XMVECTOR scale, rot, pos;
-		XMMatrixDecompose(&scale, &rot, &pos, world);
+	// Per object
+	m_culledObjectCount = 0;
+	m_culledMeshCount = 0;
+	m_culledSubsetCount = 0;
+	for (auto& obj : m_sceneObjects)
+	{
+		if (obj.BoundsDirty) updateBounds(obj);
+
+		// Select the LOD by the projected radius of the bounding sphere of the nearest possible
+		// instance. Each coarser LOD has about half the triangles, so it takes over once the
+		// projected area halves.
+		const auto& bounds = obj.WorldBoundingSphere;
+		const auto center = XMLoadFloat3(&bounds.Center);
+		const auto radius = obj.InstanceRadius;
+		const auto distance = (max)(XMVectorGetX(XMVector3Length(center - lodEyePt)) - bounds.Radius + radius, 0.0f);
+		const auto lodCount = static_cast<uint8_t>(obj.Lods.size());
+		obj.Lod = 0;
+		if (distance > radius && lodCount > 1)
+		{
+			const auto lod = 2.0f * log2f(g_lodScreenRadius * distance / (radius * lodProjScale));
+			obj.Lod = static_cast<uint8_t>((min)((max)(lod, 0.0f), static_cast<float>(lodCount - 1)));
+		}
 
-		const auto pCbData = reinterpret_cast<Instance*>(obj.Instance->Map(frameIndex));
-		XMStoreFloat4x4(&pCbData->World, XMMatrixTranspose(world));
-		XMStoreFloat3x4(&pCbData->WorldIT, XMMatrixTranspose(XMMatrixInverse(nullptr, world)));
-		pCbData->Scale = XMVectorGetX(scale);
-		pCbData->Flags = CULL_FLAG | MESHLET_FLAG;
+		// Cull the whole object, then each mesh of the selected LOD, and then each subset of the
+		// mesh, by the bounds of all their instances against the same frustum as the AS, so that
+		// invisible parts launch no AS groups at all. The AS then culls the instances one by one.
+		const auto& meshes = obj.Lods[obj.Lod];
+		obj.VisibleRanges.clear();
+		if (!(obj.Flags & CULL_FLAG))
+			for (const auto& mesh : meshes) obj.VisibleRanges.push_back({ &mesh, 0, mesh.MeshletCount });
+		else if (IsSphereVisible(center, bounds.Radius, cullPlanes))
+		{
+			for (const auto& mesh : meshes)
+			{
+				const auto& meshBounds = mesh.WorldBoundingSphere;
+				if (!IsSphereVisible(XMLoadFloat3(&meshBounds.Center), meshBounds.Radius, cullPlanes))
+				{
+					++m_culledMeshCount;
+					continue;
+				}
+
+				if (mesh.Subsets.size() <= 1)
+				{
+					obj.VisibleRanges.push_back({ &mesh, 0, mesh.MeshletCount });
+					continue;
+				}
+
+				// Visible subsets that are adjacent in the meshlet order share one dispatch.
+				auto isPrevVisible = false;
+				for (const auto& subset : mesh.Subsets)
+				{
+					const auto& subsetBounds = subset.WorldBoundingSphere;
+					if (IsSphereVisible(XMLoadFloat3(&subsetBounds.Center), subsetBounds.Radius, cullPlanes))
+					{
+						auto& ranges = obj.VisibleRanges;
+						if (isPrevVisible && ranges.back().Offset + ranges.back().Count == subset.Meshlets.Offset)
+							ranges.back().Count += subset.Meshlets.Count;
+						else ranges.push_back({ &mesh, subset.Meshlets.Offset, subset.Meshlets.Count });
+						isPrevVisible = true;
+					}
+					else
+					{
+						++m_culledSubsetCount;
+						isPrevVisible = false;
+					}
+				}
+			}
+		}
+		else
+		{
+			++m_culledObjectCount;
+			m_culledMeshCount += static_cast<uint32_t>(meshes.size());
+		}
 	}
+
+	return true;
 }
 
 void Renderer::Render(Ultimate::CommandList* pCommandList, uint8_t frameIndex,
-	const Descriptor& rtv, bool useMeshShader)
+	const Descriptor& rtv, bool useMeshShader, bool useDepthPrepass)
 {
 	// Set descriptor tables
 	m_meshShaderFallbackLayer->EnableNativeMeshShader(useMeshShader);
 	m_meshShaderFallbackLayer->SetPipelineLayout(pCommandList, m_pipelineLayout);
-	m_meshShaderFallbackLayer->SetRootConstantBufferView(pCommandList, CBV_GLOBALS, m_cbGlobals.get(), m_cbGlobals->GetCBVOffset(frameIndex));
+	m_meshShaderFallbackLayer->SetRootConstantBufferView(pCommandList, CBV_GLOBALS, m_constantAllocator.GetBuffer(), m_cbGlobalsOffset);
+	m_meshShaderFallbackLayer->SetRootShaderResourceView(pCommandList, SRV_INSTANCES, m_instances.get(),
+		static_cast<int>(sizeof(Instance) * m_instanceCount * frameIndex));
 
-	// Set pipeline state
-	m_meshShaderFallbackLayer->SetPipelineState(pCommandList, m_pipeline);
+	// The geometry of all meshes is bound once, and each dispatch only selects its mesh.
+	m_meshShaderFallbackLayer->SetRootShaderResourceView(pCommandList, SRV_MESH_INFOS, m_geometryPool.GetMeshInfos());
+	m_meshShaderFallbackLayer->SetDescriptorTable(pCommandList, SRV_INPUTS, m_geometryPool.GetSrvTable());
+	m_meshShaderFallbackLayer->SetRootShaderResourceView(pCommandList, SRV_CULL, m_geometryPool.GetMeshletCullData());
+	m_meshShaderFallbackLayer->SetRootShaderResourceView(pCommandList, SRV_LODS, m_geometryPool.GetMeshletLods());
 
 	// Clear depth
-	pCommandList->OMSetRenderTargets(1, &rtv, &m_depth->GetDSV());
 	pCommandList->ClearDepthStencilView(m_depth->GetDSV(), ClearFlag::DEPTH, 1.0f);
 
 	// Set viewport
@@ -183,102 +339,223 @@ void Renderer::Render(Ultimate::CommandList* pCommandList, uint8_t frameIndex,
 	pCommandList->RSSetViewports(1, &viewport);
 	pCommandList->RSSetScissorRects(1, &scissorRect);
 
-	// Record commands.
-	for (auto& obj : m_sceneObjects)
+	if (useDepthPrepass)
+	{
+		// Lay down the nearest depth without attributes or pixel shading, so that the color pass
+		// shades each pixel once. Both passes select the same meshlets and the same positions.
+		pCommandList->OMSetRenderTargets(0, nullptr, &m_depth->GetDSV());
+		drawMeshlets(pCommandList, m_depthPipeline);
+
+		pCommandList->OMSetRenderTargets(1, &rtv, &m_depth->GetDSV());
+		drawMeshlets(pCommandList, m_equalPipeline);
+	}
+	else
 	{
-		m_meshShaderFallbackLayer->SetRootConstantBufferView(pCommandList, CBV_INSTANCE, obj.Instance.get(), obj.Instance->GetCBVOffset(frameIndex));
+		pCommandList->OMSetRenderTargets(1, &rtv, &m_depth->GetDSV());
+		drawMeshlets(pCommandList, m_pipeline);
+	}
+}
+
+void Renderer::SetInstanceTransform(uint32_t objectIdx, uint32_t instanceIdx, const XMFLOAT3& position,
+	const XMFLOAT4& rotation, float scale)
+{
+	auto& obj = m_sceneObjects[objectIdx];
+	assert(instanceIdx < obj.InstanceCount);
+	m_transforms.Set(obj.FirstInstance + instanceIdx, position, rotation, scale);
+	obj.BoundsDirty = true;
+}
+
+uint32_t Renderer::GetCulledObjectCount() const
+{
+	return m_culledObjectCount;
+}
+
+uint32_t Renderer::GetCulledMeshCount() const
+{
+	return m_culledMeshCount;
+}
+
+uint32_t Renderer::GetCulledSubsetCount() const
+{
+	return m_culledSubsetCount;
+}
 
-		for (auto& mesh : obj.Meshes)
+bool Renderer::createObjectMeshes(vector<ObjectMesh>& meshes, const Model& model, uint8_t vertexFormat)
+{
+	const auto meshCount = model.GetMeshCount();
+	meshes.resize(meshCount);
+
+	for (auto i = 0u; i < meshCount; ++i)
+	{
+		auto& mesh = meshes[i];
+		const auto& meshData = model.GetMesh(i);
+		mesh.Subsets.resize(meshData.MeshletSubsets.size());
+		for (size_t j = 0; j < mesh.Subsets.size(); ++j)
 		{
-			m_meshShaderFallbackLayer->SetRootConstantBufferView(pCommandList, CBV_MESHINFO, mesh.MeshInfo.get());
-			m_meshShaderFallbackLayer->SetDescriptorTable(pCommandList, SRV_INPUTS, mesh.SrvTable);
-			m_meshShaderFallbackLayer->SetRootShaderResourceView(pCommandList, SRV_CULL, mesh.MeshletCullData.get());
-			m_meshShaderFallbackLayer->DispatchMesh(pCommandList, XUSG_DIV_UP(mesh.MeshletCount, AS_GROUP_SIZE), 1, 1);
+			// Bound each subset by the spheres of its meshlets.
+			auto& subset = mesh.Subsets[j];
+			subset.Meshlets = meshData.MeshletSubsets[j];
+			for (auto k = 0u; k < subset.Meshlets.Count; ++k)
+			{
+				const auto& sphere = meshData.CullingData[subset.Meshlets.Offset + k].BoundingSphere;
+				const BoundingSphere meshletSphere(XMFLOAT3(sphere.x, sphere.y, sphere.z), sphere.w);
+				if (k == 0) subset.BoundingSphere = meshletSphere;
+				else
+				{
+					const auto merged = subset.BoundingSphere;
+					BoundingSphere::CreateMerged(subset.BoundingSphere, merged, meshletSphere);
+				}
+			}
 		}
+
+		mesh.BoundingSphere = meshData.BoundingSphere;
+		mesh.MeshletCount = static_cast<uint32_t>(meshData.Meshlets.size());
+		mesh.MeshId = addMesh(meshData, vertexFormat);
 	}
+
+	return true;
 }
 
-bool Renderer::createMeshBuffers(CommandList* pCommandList, ObjectMesh& mesh,
-	const Mesh& meshData, vector<Resource::uptr>& uploaders)
+uint32_t Renderer::addMesh(const Mesh& meshData, uint8_t vertexFormat)
 {
-	const auto pDevice = pCommandList->GetDevice();
+	MeshInfo info = {};
+	info.IndexSize = meshData.IndexSize;
+	info.MeshletCount = static_cast<uint32_t>(meshData.Meshlets.size());
+	info.LastMeshletVertCount = meshData.Meshlets.back().VertCount;
+	info.LastMeshletPrimCount = meshData.Meshlets.back().PrimCount;
+	info.BoundingSphere = XMFLOAT4(meshData.BoundingSphere.Center.x, meshData.BoundingSphere.Center.y,
+		meshData.BoundingSphere.Center.z, meshData.BoundingSphere.Radius);
+	info.VertexFormat = vertexFormat;
+	info.PositionBias = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	info.PositionScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+
+	// The vertex stream of the positions is pooled. Quantizing the positions and normals needs
+	// the normals in the same stream; otherwise the float vertices are kept.
+	const auto stream = meshData.AttributeStreams[Attribute::Position];
+	const auto hasNormal = meshData.AttributeStreams[Attribute::Normal] == stream;
+	info.VertexStride = meshData.VertexStrides[stream];
+	if (vertexFormat != VERTEX_FORMAT_FLOAT && !hasNormal) info.VertexFormat = VERTEX_FORMAT_FLOAT;
+	else if (vertexFormat != VERTEX_FORMAT_FLOAT)
+		info.VertexStride = VertexQuantizer::GetStride(vertexFormat == VERTEX_FORMAT_Q16_OCT8 ? 8 : 16);
+
+	// Pack the primitives with the fewest bits per index that the meshlets of this mesh need.
+	info.PrimitiveIndexBits = GetPrimitiveIndexBits(meshData.PrimitiveIndices.data(), meshData.PrimitiveIndices.size());
+	info.PrimitiveStride = GetPrimitiveStride(info.PrimitiveIndexBits);
+
+	return m_geometryPool.AddMesh(info, static_cast<size_t>(info.VertexStride) * meshData.VertexCount,
+		meshData.UniqueVertexIndices.size(),
+		GetPackedPrimitiveSize(meshData.PrimitiveIndices.size(), info.PrimitiveIndexBits));
+}
+
+bool Renderer::uploadObjectMeshes(const vector<ObjectMesh>& meshes, const Model& model, StagingRing* pStagingRing)
+{
+	// The meshlets are already in Morton order, as MeshletBuilder sorts them when building the model.
+	for (auto i = 0u; i < model.GetMeshCount(); ++i)
+		XUSG_N_RETURN(uploadMesh(meshes[i], model.GetMesh(i), pStagingRing), false);
 
+	return true;
+}
+
+bool Renderer::uploadMesh(const ObjectMesh& mesh, const Mesh& meshData, StagingRing* pStagingRing)
+{
+	// Convert the data in the formats chosen when the mesh was reserved.
+	auto info = m_geometryPool.GetMeshInfo(mesh.MeshId);
+	const auto stream = meshData.AttributeStreams[Attribute::Position];
+	const uint8_t* pVertices = meshData.Vertices[stream].data();
+	vector<uint8_t> quantized;
+	if (info.VertexFormat != VERTEX_FORMAT_FLOAT)
 	{
-		auto& vertices = mesh.Vertices;
-		const auto stride = meshData.VertexStrides[0];
-		const auto numElements = static_cast<uint32_t>(meshData.Vertices[0].size()) / stride;
-		vertices = StructuredBuffer::MakeUnique();
-		XUSG_N_RETURN(vertices->Create(pDevice, numElements, stride, ResourceFlag::NONE, MemoryType::DEFAULT), false);
-		uploaders.emplace_back(Resource::MakeUnique());
-
-		XUSG_N_RETURN(vertices->Upload(pCommandList, uploaders.back().get(), meshData.Vertices[0].data(),
-			stride * numElements, 0, ResourceState::NON_PIXEL_SHADER_RESOURCE), false);
+		const uint8_t normalBits = info.VertexFormat == VERTEX_FORMAT_Q16_OCT8 ? 8 : 16;
+		const VertexQuantizer quantizer;
+		XUSG_N_RETURN(quantizer.Quantize(quantized, info.PositionBias, info.PositionScale, pVertices,
+			meshData.VertexStrides[stream], meshData.VertexCount, meshData.AttributeOffsets[Attribute::Position],
+			meshData.AttributeOffsets[Attribute::Normal], normalBits), false);
+		pVertices = quantized.data();
 	}
 
+	vector<uint8_t> packed;
+	PackPrimitives(packed, meshData.PrimitiveIndices.data(), meshData.PrimitiveIndices.size(), info.PrimitiveIndexBits);
+
+	assert(meshData.CullingData.size() == meshData.Meshlets.size());
+
+	// Give each meshlet the LOD bounds of its subset; meshes without cluster LODs have a single
+	// level, which is always selected.
+	const LodBounds singleLevel = { info.BoundingSphere, 0.0f, FLT_MAX };
+	vector<LodBounds> meshletLods(info.MeshletCount, singleLevel);
+	for (auto i = 0u; i < meshData.SubsetLods.size(); ++i)
 	{
-		auto& meshlets = mesh.Meshlets;
-		const uint32_t stride = sizeof(Meshlet);
-		const auto numElements = static_cast<uint32_t>(meshData.Meshlets.size());
-		meshlets = StructuredBuffer::MakeUnique();
-		XUSG_N_RETURN(meshlets->Create(pDevice, numElements, stride, ResourceFlag::NONE, MemoryType::DEFAULT), false);
-		uploaders.emplace_back(Resource::MakeUnique());
-
-		XUSG_N_RETURN(meshlets->Upload(pCommandList, uploaders.back().get(), meshData.Meshlets.data(),
-			stride * numElements, 0, ResourceState::NON_PIXEL_SHADER_RESOURCE), false);
+		const auto& subset = meshData.MeshletSubsets[i];
+		fill_n(&meshletLods[subset.Offset], subset.Count, meshData.SubsetLods[i]);
 	}
 
+	return m_geometryPool.UploadMesh(pStagingRing, mesh.MeshId, info, pVertices, meshData.Meshlets.data(),
+		meshData.CullingData.data(), meshletLods.data(), meshData.UniqueVertexIndices.data(), packed.data());
+}
+
+void Renderer::updateBounds(SceneObject& obj)
+{
+	vector<XMFLOAT3X4> worlds(obj.InstanceCount);
+	obj.InstanceRadius = 0.0f;
+	for (auto i = 0u; i < obj.InstanceCount; ++i)
 	{
-		auto& primitiveIndices = mesh.PrimitiveIndices;
-		const uint32_t stride = sizeof(PackedTriangle);
-		const auto numElements = static_cast<uint32_t>(meshData.PrimitiveIndices.size());
-		primitiveIndices = StructuredBuffer::MakeUnique();
-		XUSG_N_RETURN(primitiveIndices->Create(pDevice, numElements, stride, ResourceFlag::NONE, MemoryType::DEFAULT), false);
-		uploaders.emplace_back(Resource::MakeUnique());
-
-		XUSG_N_RETURN(primitiveIndices->Upload(pCommandList, uploaders.back().get(), meshData.PrimitiveIndices.data(),
-			stride * numElements, 0, ResourceState::NON_PIXEL_SHADER_RESOURCE), false);
+		XMStoreFloat3x4(&worlds[i], m_transforms.GetWorld(obj.FirstInstance + i));
+		obj.InstanceRadius = (max)(obj.BoundingSphere.Radius * m_transforms.GetScale(obj.FirstInstance + i), obj.InstanceRadius);
 	}
 
+	// Merge the bounding spheres of all instances, of the object and of each mesh.
+	const auto mergeInstances = [&worlds](BoundingSphere& bounds, const BoundingSphere& sphere)
 	{
-		auto& uniqueVertexIndices = mesh.UniqueVertexIndices;
-		uniqueVertexIndices = RawBuffer::MakeUnique();
-		const auto byteWidth = meshData.UniqueVertexIndices.size();
-		XUSG_N_RETURN(uniqueVertexIndices->Create(pDevice, byteWidth, ResourceFlag::NONE, MemoryType::DEFAULT), false);
-		uploaders.emplace_back(Resource::MakeUnique());
-
-		XUSG_N_RETURN(uniqueVertexIndices->Upload(pCommandList, uploaders.back().get(), meshData.UniqueVertexIndices.data(),
-			byteWidth, 0, ResourceState::NON_PIXEL_SHADER_RESOURCE), false);
-	}
+		sphere.Transform(bounds, XMLoadFloat3x4(&worlds[0]));
+		for (auto i = 1u; i < worlds.size(); ++i)
+		{
+			BoundingSphere instanceSphere;
+			sphere.Transform(instanceSphere, XMLoadFloat3x4(&worlds[i]));
 
+			const auto merged = bounds;
+			BoundingSphere::CreateMerged(bounds, merged, instanceSphere);
+		}
+	};
+
+	mergeInstances(obj.WorldBoundingSphere, obj.BoundingSphere);
+	for (auto& meshes : obj.Lods)
 	{
-		auto& meshletCullData = mesh.MeshletCullData;
-		const uint32_t stride = sizeof(CullData);
-		const auto numElements = static_cast<uint32_t>(meshData.CullingData.size());
-		meshletCullData = StructuredBuffer::MakeUnique();
-		XUSG_N_RETURN(meshletCullData->Create(pDevice, numElements, stride, ResourceFlag::NONE, MemoryType::DEFAULT), false);
-		uploaders.emplace_back(Resource::MakeUnique());
-
-		XUSG_N_RETURN(meshletCullData->Upload(pCommandList, uploaders.back().get(), meshData.CullingData.data(),
-			stride * numElements, 0, ResourceState::NON_PIXEL_SHADER_RESOURCE), false);
+		for (auto& mesh : meshes)
+		{
+			mergeInstances(mesh.WorldBoundingSphere, mesh.BoundingSphere);
+			for (auto& subset : mesh.Subsets)
+				mergeInstances(subset.WorldBoundingSphere, subset.BoundingSphere);
+		}
 	}
 
+	obj.BoundsDirty = false;
+}
+
+void Renderer::drawMeshlets(Ultimate::CommandList* pCommandList, const MeshShaderFallbackLayer::Pipeline& pipeline)
+{
+	// Set pipeline state
+	m_meshShaderFallbackLayer->SetPipelineState(pCommandList, pipeline);
+
+	// Record commands.
+	for (auto& obj : m_sceneObjects)
 	{
-		auto& meshInfo = mesh.MeshInfo;
-		meshInfo = ConstantBuffer::MakeUnique();
-		XUSG_N_RETURN(meshInfo->Create(pDevice, sizeof(MeshInfo), 1, nullptr,
-			MemoryType::DEFAULT, MemoryFlag::NONE, L"CBMeshInfo"), false);
-		uploaders.emplace_back(Resource::MakeUnique());
-
-		MeshInfo info = {};
-		info.IndexSize = meshData.IndexSize;
-		info.MeshletCount = static_cast<uint32_t>(meshData.Meshlets.size());
-		info.LastMeshletVertCount = meshData.Meshlets.back().VertCount;
-		info.LastMeshletPrimCount = meshData.Meshlets.back().PrimCount;
-
-		XUSG_N_RETURN(meshInfo->Upload(pCommandList, uploaders.back().get(), &info, sizeof(info)), false);
-	}
+		const auto instanceCount = obj.InstanceCount;
 
-	return true;
+		for (const auto& range : obj.VisibleRanges)
+		{
+			// One dispatch draws the meshlet range of all instances, unless they exceed the mesh-
+			// dispatch limits (65535 groups per dimension, 2^22 in total) or the fallback payloads.
+			const auto batchCount = XUSG_DIV_UP(range.Count, AS_GROUP_SIZE);
+			const auto maxInstanceCount = m_meshShaderFallbackLayer->IsNativeMeshShaderEnabled() ?
+				(min)((1u << 22) / batchCount, 65535u) : (max)(m_maxBatchCount / batchCount, 1u);
+			for (auto i = 0u; i < instanceCount; i += maxInstanceCount)
+			{
+				const uint32_t drawConstants[] = { range.pMesh->MeshId, obj.FirstInstance + i, range.Offset, range.Count };
+				m_meshShaderFallbackLayer->Set32BitConstants(pCommandList, CONST_DRAW,
+					static_cast<uint32_t>(size(drawConstants)), drawConstants);
+				m_meshShaderFallbackLayer->DispatchMesh(pCommandList, batchCount, (min)(instanceCount - i, maxInstanceCount), 1);
+			}
+		}
+	}
 }
 
 bool Renderer::createPipelineLayouts(const XUSG::Device* pDevice, bool isMSSupported)
@@ -287,11 +564,13 @@ bool Renderer::createPipelineLayouts(const XUSG::Device* pDevice, bool isMSSuppo
 	{
 		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
 		pipelineLayout->SetRootCBV(CBV_GLOBALS, 0);
-		pipelineLayout->SetRootCBV(CBV_MESHINFO, 1);
-		pipelineLayout->SetRootCBV(CBV_INSTANCE, 2);
+		pipelineLayout->SetConstants(CONST_DRAW, 4, 1);
+		pipelineLayout->SetRootSRV(SRV_INSTANCES, 5, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRootSRV(SRV_MESH_INFOS, 6, 0, DescriptorFlag::DATA_STATIC);
 		pipelineLayout->SetRange(SRV_INPUTS, DescriptorType::SRV, 4, 0, 0, DescriptorFlag::DATA_STATIC);
 		pipelineLayout->SetShaderStage(SRV_INPUTS, Shader::MS);
 		pipelineLayout->SetRootSRV(SRV_CULL, 4, 0, DescriptorFlag::DATA_STATIC, Shader::AS);
+		pipelineLayout->SetRootSRV(SRV_LODS, 7, 0, DescriptorFlag::DATA_STATIC, Shader::AS);
 		m_pipelineLayout = m_meshShaderFallbackLayer->GetPipelineLayout(pDevice, pipelineLayout.get(),
 			m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"MeshletLayout");
 
@@ -324,29 +603,32 @@ bool Renderer::createPipelines(Format rtFormat, Format dsFormat, bool isMSSuppor
 			state.get(), m_meshPipelineLib.get(), m_computePipelineLib.get(), m_graphicsPipelineLib.get(), L"MeshletPipe");
 
 		XUSG_N_RETURN(m_pipeline.IsValid(isMSSupported), false);
-	}
 
-	return true;
-}
+		// Same shading, but only where the depth prepass left the nearest surface
+		state->DSSetState(Graphics::DEPTH_READ_EQUAL, m_meshPipelineLib.get());
+		m_equalPipeline = m_meshShaderFallbackLayer->GetPipeline(m_pipelineLayout, m_shaderLib->GetShader(Shader::Stage::CS, CS_MESHLET_AS),
+			m_shaderLib->GetShader(Shader::Stage::CS, CS_MESHLET_MS), m_shaderLib->GetShader(Shader::Stage::VS, VS_MESHLET),
+			state.get(), m_meshPipelineLib.get(), m_computePipelineLib.get(), m_graphicsPipelineLib.get(), L"MeshletEqualPipe");
 
-bool Renderer::createDescriptorTables()
-{
-	// Meshlet SRVs
-	for (auto& obj : m_sceneObjects)
+		XUSG_N_RETURN(m_equalPipeline.IsValid(isMSSupported), false);
+	}
+
+	// Depth-prepass pipeline: the MS outputs, and the fallback payloads carry, positions only.
 	{
-		for (auto& mesh : obj.Meshes)
-		{
-			const Descriptor descriptors[] =
-			{
-				mesh.Vertices->GetSRV(),
-				mesh.Meshlets->GetSRV(),
-				mesh.UniqueVertexIndices->GetSRV(),
-				mesh.PrimitiveIndices->GetSRV()
-			};
-			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
-			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
-			XUSG_X_RETURN(mesh.SrvTable, descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
-		}
+		XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::MS, MS_MESHLET_DEPTH, L"MSMeshletDepth.cso"), false);
+		XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_MESHLET_MS_DEPTH, L"CSMeshletMSDepth.cso"), false);
+		XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::VS, VS_MESHLET_DEPTH, L"VSMeshletDepth.cso"), false);
+
+		const auto state = Ultimate::State::MakeUnique();
+		state->SetShader(Shader::Stage::AS, m_shaderLib->GetShader(Shader::Stage::AS, AS_MESHLET));
+		state->SetShader(Shader::Stage::MS, m_shaderLib->GetShader(Shader::Stage::MS, MS_MESHLET_DEPTH));
+		state->OMSetNumRenderTargets(0);
+		state->OMSetDSVFormat(dsFormat);
+		m_depthPipeline = m_meshShaderFallbackLayer->GetPipeline(m_pipelineLayout, m_shaderLib->GetShader(Shader::Stage::CS, CS_MESHLET_AS),
+			m_shaderLib->GetShader(Shader::Stage::CS, CS_MESHLET_MS_DEPTH), m_shaderLib->GetShader(Shader::Stage::VS, VS_MESHLET_DEPTH),
+			state.get(), m_meshPipelineLib.get(), m_computePipelineLib.get(), m_graphicsPipelineLib.get(), L"MeshletDepthPipe");
+
+		XUSG_N_RETURN(m_depthPipeline.IsValid(isMSSupported), false);
 	}
 
 	return true;
@@ -5,7 +5,10 @@
 #pragma once
 
 #include "MeshShaderFallbackLayer.h"
+#include "ConstantAllocator.h"
+#include "GeometryPool.h"
 #include "Model.h"
+#include "InstanceTransforms.h"
 
 class Renderer
 {
@@ -18,41 +21,60 @@ public:
 
 		bool     Cull;
 		bool     DrawMeshlets;
+
+		uint8_t  VertexFormat; // VERTEX_FORMAT_*
+
+		uint32_t InstanceCount; // Copies on a square grid in the XZ plane around Position
 	};
 
 	Renderer();
 	virtual ~Renderer();
 
 	bool Init(XUSG::CommandList* pCommandList, const XUSG::DescriptorTableLib::sptr& descriptorTableLib,
-		uint32_t width, uint32_t height, XUSG::Format rtFormat, std::vector<XUSG::Resource::uptr>& uploaders,
-		uint32_t objCount, const std::wstring* pFileNames, const ObjectDef* pObjDefs, bool isMSSupported);
+		uint32_t width, uint32_t height, XUSG::Format rtFormat, StagingRing* pStagingRing, uint32_t objCount, const std::wstring* pFileNames, const ObjectDef* pObjDefs, bool isMSSupported);
 
-	void UpdateFrame(uint8_t frameIndex, DirectX::CXMMATRIX view,
+	bool UpdateFrame(uint8_t frameIndex, DirectX::CXMMATRIX view,
 		const DirectX::XMMATRIX* pProj, const DirectX::XMFLOAT3& eyePt);
+	// With the depth prepass, the meshlets are first drawn to depth only with positions alone,
+	// and then shaded once per pixel by an EQUAL depth test.
 	void Render(XUSG::Ultimate::CommandList* pCommandList, uint8_t frameIndex,
-		const XUSG::Descriptor& rtv, bool useMeshShader = true);
+		const XUSG::Descriptor& rtv, bool useMeshShader = true, bool useDepthPrepass = false);
+
+	// Moves an instance; only moved instances are recomputed in the next UpdateFrame().
+	void SetInstanceTransform(uint32_t objectIdx, uint32_t instanceIdx, const DirectX::XMFLOAT3& position,
+		const DirectX::XMFLOAT4& rotation, float scale);
+
+	// Statistics of the CPU frustum culling in the last UpdateFrame()
+	uint32_t GetCulledObjectCount() const;
+	uint32_t GetCulledMeshCount() const;
+	uint32_t GetCulledSubsetCount() const;
 
 	static const uint8_t FrameCount = 3;
+	static const uint8_t MaxLodCount = 8;
 
 protected:
 	enum PipelineLayoutSlot : uint8_t
 	{
 		CBV_GLOBALS,
-		CBV_MESHINFO,
-		CBV_INSTANCE,
+		CONST_DRAW,
+		SRV_INSTANCES,
+		SRV_MESH_INFOS,
 		SRV_INPUTS,
-		SRV_CULL
+		SRV_CULL,
+		SRV_LODS
 	};
 
 	enum ComputeShaderID : uint8_t
 	{
 		CS_MESHLET_AS,
-		CS_MESHLET_MS
+		CS_MESHLET_MS,
+		CS_MESHLET_MS_DEPTH
 	};
 
 	enum VertexShaderID : uint8_t
 	{
-		VS_MESHLET
+		VS_MESHLET,
+		VS_MESHLET_DEPTH
 	};
 
 	enum AmplificationShaderID : uint8_t
@@ -62,7 +84,8 @@ protected:
 
 	enum MeshShaderID : uint8_t
 	{
-		MS_MESHLET
+		MS_MESHLET,
+		MS_MESHLET_DEPTH
 	};
 
 	enum PixelShaderID : uint8_t
@@ -70,37 +93,66 @@ protected:
 		PS_MESHLET
 	};
 
+	struct MeshSubset
+	{
+		Subset Meshlets;
+		DirectX::BoundingSphere BoundingSphere; // Merged from the spheres of its meshlets
+		DirectX::BoundingSphere WorldBoundingSphere; // Encloses the subset of all instances
+	};
+
 	struct ObjectMesh
 	{
-		XUSG::DescriptorTable SrvTable;
-		XUSG::StructuredBuffer::uptr Vertices;
-		XUSG::StructuredBuffer::uptr Meshlets;
-		XUSG::StructuredBuffer::uptr PrimitiveIndices;
-		XUSG::StructuredBuffer::uptr MeshletCullData;
-		XUSG::RawBuffer::uptr UniqueVertexIndices;
-		XUSG::ConstantBuffer::uptr MeshInfo;
-		std::vector<Subset> Subsets;
+		uint32_t MeshId; // Index of the geometry and MeshInfo in the geometry pool
+		std::vector<MeshSubset> Subsets;
+		DirectX::BoundingSphere BoundingSphere;
+		DirectX::BoundingSphere WorldBoundingSphere; // Encloses the mesh of all instances
 		uint32_t MeshletCount;
 	};
 
+	// Contiguous meshlets of a mesh, made of one or more adjacent visible subsets
+	struct MeshletRange
+	{
+		const ObjectMesh* pMesh;
+		uint32_t Offset;
+		uint32_t Count;
+	};
+
 	struct SceneObject
 	{
-		std::vector<ObjectMesh> Meshes;
-		XUSG::ConstantBuffer::uptr Instance;
-		DirectX::XMFLOAT3X4 World;
+		std::vector<std::vector<ObjectMesh>> Lods; // Meshes of each LOD, finest first
+		DirectX::BoundingSphere BoundingSphere;
+		DirectX::BoundingSphere WorldBoundingSphere; // Encloses all instances
+		std::vector<MeshletRange> VisibleRanges; // Meshlets of the current LOD inside the frustum
+		uint32_t FirstInstance; // Index into the transforms and the instance buffer
+		uint32_t InstanceCount;
+		uint32_t Flags;
+		float InstanceRadius;   // Largest world radius of a single instance
+		bool BoundsDirty;
+		uint8_t Lod;
 	};
 
-	bool createMeshBuffers(XUSG::CommandList* pCommandList, ObjectMesh& mesh,
-		const Mesh& meshData, std::vector<XUSG::Resource::uptr>& uploaders);
+	bool createObjectMeshes(std::vector<ObjectMesh>& meshes, const Model& model, uint8_t vertexFormat);
+	uint32_t addMesh(const Mesh& meshData, uint8_t vertexFormat);
+	bool uploadObjectMeshes(const std::vector<ObjectMesh>& meshes, const Model& model, StagingRing* pStagingRing);
+	bool uploadMesh(const ObjectMesh& mesh, const Mesh& meshData, StagingRing* pStagingRing);
 	bool createPipelineLayouts(const XUSG::Device* pDevice, bool isMSSupported);
 	bool createPipelines(XUSG::Format rtFormat, XUSG::Format dsFormat, bool isMSSupported);
-	bool createDescriptorTables();
+
+	void updateBounds(SceneObject& obj);
+	void drawMeshlets(XUSG::Ultimate::CommandList* pCommandList, const MeshShaderFallbackLayer::Pipeline& pipeline);
 
 	std::vector<SceneObject>	m_sceneObjects;
+	GeometryPool				m_geometryPool;
+	InstanceTransforms			m_transforms;
+	std::vector<Instance>		m_instanceData;	// CPU copy of the instance buffer
+	XUSG::StructuredBuffer::uptr m_instances;	// A copy of all instances per frame
+	uint32_t					m_instanceCount;
+	uint8_t						m_staleInstanceFrames; // Frame copies still to be refreshed
 
 	XUSG::DepthStencil::uptr	m_depth;
 
-	XUSG::ConstantBuffer::uptr	m_cbGlobals;
+	ConstantAllocator			m_constantAllocator;
+	int							m_cbGlobalsOffset;
 
 	XUSG::ShaderLib::uptr				m_shaderLib;
 	XUSG::Graphics::PipelineLib::uptr	m_graphicsPipelineLib;
@@ -112,6 +164,13 @@ protected:
 	std::unique_ptr<MeshShaderFallbackLayer> m_meshShaderFallbackLayer;
 	MeshShaderFallbackLayer::PipelineLayout m_pipelineLayout;
 	MeshShaderFallbackLayer::Pipeline m_pipeline;
+	MeshShaderFallbackLayer::Pipeline m_depthPipeline;	// Positions only, for the depth prepass
+	MeshShaderFallbackLayer::Pipeline m_equalPipeline;	// Shades after the depth prepass
 
 	DirectX::XMFLOAT2 m_viewport;
+
+	uint32_t m_maxBatchCount; // AS batches that fit in the payloads of the fallback layer
+	uint32_t m_culledObjectCount;
+	uint32_t m_culledMeshCount;
+	uint32_t m_culledSubsetCount;
 };
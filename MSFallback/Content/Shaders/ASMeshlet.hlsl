@@ -13,10 +13,21 @@
 // The groupshared payload data to export to dispatched mesh shader threadgroups
 groupshared Payload s_Payload;
 
-bool IsVisible(CullData c, float4x4 world, float scale, float3 viewPos)
+// Culls an instance by the bounding sphere of the whole mesh.
+bool IsInstanceVisible(Instance instance)
 {
-	if ((Instance.Flags & CULL_FLAG) == 0) return true;
+	const float4 boundingSphere = MeshInfos[MeshId].BoundingSphere;
+	const float4 center = mul(float4(boundingSphere.xyz, 1.0), instance.World);
+	const float radius = boundingSphere.w * instance.Scale;
+
+	for (uint i = 0; i < 6; ++i)
+		if (dot(center, Constants.Planes[i]) < -radius) return false;
 
+	return true;
+}
+
+bool IsVisible(CullData c, float4x4 world, float scale, float3 viewPos)
+{
 	// Do a cull test of the bounding sphere against the view frustum planes.
 	const float4 center = mul(float4(c.BoundingSphere.xyz, 1.0), world);
 	const float radius = c.BoundingSphere.w * scale;
@@ -45,23 +56,50 @@ bool IsVisible(CullData c, float4x4 world, float scale, float3 viewPos)
 	return true;
 }
 
+// Selects the meshlet if its LOD level projects an error within the pixel threshold from the nearest
+// point of the region bounds, and its parent level does not. All levels of a region share the bounds,
+// so exactly one of them is selected per instance.
+bool IsLodSelected(LodBounds lod, float4x4 world, float scale)
+{
+	const float3 center = mul(float4(lod.BoundingSphere.xyz, 1.0), world).xyz;
+	const float distance = max(length(center - Constants.LodViewPosition) - lod.BoundingSphere.w * scale, 0.0);
+	const float threshold = Constants.LodErrorThreshold * distance;
+	const float errorScale = Constants.LodErrorScale * scale;
+
+	return lod.Error * errorScale <= threshold && lod.ParentError * errorScale > threshold;
+}
+
+// Groups are dispatched as (meshlet batch, instance), one row of batches per instance, over
+// the meshlet range of the dispatch.
 [NumThreads(AS_GROUP_SIZE, 1, 1)]
-void main(uint gtid : SV_GroupThreadID, uint dtid : SV_DispatchThreadID, uint gid : SV_GroupID)
+void main(uint gtid : SV_GroupThreadID, uint dtid : SV_DispatchThreadID, uint2 gid : SV_GroupID)
 {
+	const MeshInfo meshInfo = MeshInfos[MeshId];
+	const uint instanceIdx = FirstInstance + gid.y;
+	const Instance instance = Instances[instanceIdx];
+	const uint meshletIdx = FirstMeshlet + dtid;
 	bool visible = false;
 
-	// Check bounds of meshlet cull data resource
-	if (dtid < MeshInfo.MeshletCount)
-		// Do visibility testing for this thread
-		visible = IsVisible(MeshletCullData[dtid], Instance.World, Instance.Scale, Constants.CullViewPosition);
+	// Check bounds of the meshlet range of the dispatch
+	if (dtid < NumMeshlets)
+	{
+		// Keep the meshlets of the LOD level selected for the instance, then cull the whole
+		// instance first, and then do visibility testing for this thread
+		const uint meshletOffset = meshInfo.MeshletOffset + meshletIdx;
+		visible = IsLodSelected(MeshletLods[meshletOffset], instance.World, instance.Scale);
+		if (visible && (instance.Flags & CULL_FLAG))
+			visible = IsInstanceVisible(instance) && IsVisible(MeshletCullData[meshletOffset], instance.World, instance.Scale, Constants.CullViewPosition);
+	}
 
 	// Compact visible meshlets into the export payload array
 	if (visible)
 	{
 		const uint index = WavePrefixCountBits(visible);
-		s_Payload.MeshletIndices[index] = dtid;
+		s_Payload.MeshletIndices[index] = meshletIdx;
 	}
 
+	s_Payload.InstanceIndex = instanceIdx;
+
 	// Dispatch the required number of MS threadgroups to render the visible meshlets
 	const uint visibleCount = WaveActiveCountBits(visible);
 	DispatchMesh(visibleCount, 1, 1, s_Payload);
@@ -6,24 +6,27 @@
 
 RWStructuredBuffer<uint> DispatchMeshArgs : FALLBACK_LAYER_PAYLOAD_REG(u0);
 
+// The batches of all instances in the dispatch are laid out flat, instance by instance.
 #define DispatchMesh(x, y, z, payload) \
 { \
 	const uint stride = sizeof(DispatchArgs) / sizeof(uint); \
-	const uint base = stride * gid; \
+	const uint batchIdx = (NumMeshlets + AS_GROUP_SIZE - 1) / AS_GROUP_SIZE * gid.y + gid.x; \
+	const uint base = stride * batchIdx; \
 	if (gtid == 0) \
 	{ \
 		const uint indexCount = 3 * MAX_PRIMS * AS_GROUP_SIZE; \
-		DispatchMeshArgs[base] = gid; \
+		DispatchMeshArgs[base] = batchIdx; \
 		DispatchMeshArgs[base + 1] = indexCount; \
 		DispatchMeshArgs[base + 2] = 1; \
-		DispatchMeshArgs[base + 3] = indexCount * gid; \
-		DispatchMeshArgs[base + 6] = gid; \
+		DispatchMeshArgs[base + 3] = indexCount * batchIdx; \
+		DispatchMeshArgs[base + 6] = batchIdx; \
 		DispatchMeshArgs[base + 7] = x; \
 		DispatchMeshArgs[base + 8] = y; \
 		DispatchMeshArgs[base + 9] = z; \
+		DispatchMeshArgs[base + AS_GROUP_SIZE + 10] = payload.InstanceIndex; \
 	} \
 	if (gtid < visibleCount) \
-		DispatchMeshArgs[base + gtid + 10] = s_Payload.MeshletIndices[gtid]; \
+		DispatchMeshArgs[base + gtid + 10] = payload.MeshletIndices[gtid]; \
 }
 
 #include "ASMeshlet.hlsl"
@@ -19,6 +19,7 @@ StructuredBuffer<uint> DispatchMeshArgs : FALLBACK_LAYER_PAYLOAD_REG(t0);
 }
 
 #define GET_MESHLET_IDX(i) DispatchMeshArgs[sizeof(DispatchArgs) / sizeof(uint) * BatchIdx + i]
+#define GET_INSTANCE_IDX() GET_MESHLET_IDX(AS_GROUP_SIZE) // InstanceIndex follows MeshletIndices
 #define VERT_IDX(i) (vid = i)
 #define PRIM_IDX(i) (pid = i)
 #define indices uint pid, out
@@ -39,7 +40,7 @@ RWBuffer<uint> IndexPayloads : FALLBACK_LAYER_PAYLOAD_REG(u1);
 [numthreads(MS_GROUP_SIZE, 1, 1)]
 void main(uint dtid : SV_DispatchThreadID, uint gtid : SV_GroupThreadID, uint gid : SV_GroupID)
 {
-	VertexOut verts[MAX_VERTS];
+	MSVertexOut verts[MAX_VERTS];
 	uint3 tris[MAX_PRIMS];
 	Payload payload = (Payload)0;
 	MeshOutCounts moc = (MeshOutCounts)0;
@@ -58,5 +59,10 @@ void main(uint dtid : SV_DispatchThreadID, uint gtid : SV_GroupThreadID, uint gi
 			IndexPayloads[baseAddr + i] = pid < moc.PrimCount ? baseIdx + tris[pid][i] : 0xffff;
 	}
 
+#ifdef DEPTH_ONLY
+	// Only the positions of the payload are written, for VSMeshletDepth to read.
+	if (vid < moc.VertCount) VertexPayloads[MAX_VERTS * meshletIdx + vid].PositionHS = verts[vid].PositionHS;
+#else
 	if (vid < moc.VertCount) VertexPayloads[MAX_VERTS * meshletIdx + vid] = verts[vid];
+#endif
 }
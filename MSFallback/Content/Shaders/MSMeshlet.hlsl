@@ -18,10 +18,22 @@
 #define GET_MESHLET_IDX(i) payload.MeshletIndices[i]
 #endif
 
-// Packs/unpacks a 10-bit index triangle primitive into/from a uint.
-uint3 UnpackPrimitive(uint primitive)
+#ifndef GET_INSTANCE_IDX
+#define GET_INSTANCE_IDX() payload.InstanceIndex
+#endif
+
+#ifdef DEPTH_ONLY
+#define MSVertexOut DepthVertexOut
+#else
+#define MSVertexOut VertexOut
+#endif
+
+// Unpacks a triangle primitive of 6, 8 or 10-bit indices from a uint.
+uint3 UnpackPrimitive(uint primitive, uint indexBits)
 {
-	return uint3(primitive & 0x3FF, (primitive >> 10) & 0x3FF, (primitive >> 20) & 0x3FF);
+	const uint mask = (1u << indexBits) - 1;
+
+	return uint3(primitive & mask, (primitive >> indexBits) & mask, (primitive >> (2 * indexBits)) & mask);
 }
 
 //--------------------------------
@@ -29,17 +41,18 @@ uint3 UnpackPrimitive(uint primitive)
 
 uint GetVertexIndex(Meshlet m, uint localIndex)
 {
+	const MeshInfo meshInfo = MeshInfos[MeshId];
 	localIndex = m.VertOffset + localIndex;
 
-	if (MeshInfo.IndexSize == 4)
+	if (meshInfo.IndexSize == 4)
 	{
-		return UniqueVertexIndices.Load(localIndex * 4);
+		return UniqueVertexIndices.Load(meshInfo.UniqueVertexIndexOffset + localIndex * 4);
 	}
 	else // Global vertex index width is 16-bit
 	{
 		// Byte address must be 4-byte aligned.
 		const uint wordOffset = (localIndex & 0x1);
-		const uint byteOffset = (localIndex / 2) * 4;
+		const uint byteOffset = meshInfo.UniqueVertexIndexOffset + (localIndex / 2) * 4;
 
 		// Grab the pair of 16-bit indices, shift & mask off proper 16-bits.
 		const uint indexPair = UniqueVertexIndices.Load(byteOffset);
@@ -49,22 +62,67 @@ uint GetVertexIndex(Meshlet m, uint localIndex)
 	}
 }
 
+Vertex GetVertex(uint vertexIndex)
+{
+	const MeshInfo meshInfo = MeshInfos[MeshId];
+	const uint address = meshInfo.VertexOffset + vertexIndex * meshInfo.VertexStride;
+
+	Vertex v;
+	if (meshInfo.VertexFormat == VERTEX_FORMAT_FLOAT)
+	{
+		v.Position = asfloat(Vertices.Load3(address));
+		v.Normal = asfloat(Vertices.Load3(address + 12));
+	}
+	else
+	{
+		uint3 data;
+		float2 oct;
+		if (meshInfo.VertexFormat == VERTEX_FORMAT_Q16_OCT8)
+		{
+			data.xy = Vertices.Load2(address);
+			oct = float2((data.y >> 16) & 0xff, data.y >> 24) / 255.0;
+		}
+		else
+		{
+			data = Vertices.Load3(address);
+			oct = float2(data.z & 0xffff, data.z >> 16) / 65535.0;
+		}
+
+		const float3 position = float3(data.x & 0xffff, data.x >> 16, data.y & 0xffff);
+		v.Position = meshInfo.PositionBias + position * meshInfo.PositionScale;
+		v.Normal = OctDecode(oct * 2.0 - 1.0);
+	}
+
+	return v;
+}
+
 uint3 GetPrimitive(Meshlet m, uint index)
 {
-	return UnpackPrimitive(PrimitiveIndices[m.PrimOffset + index]);
+	// Triangles are packed back to back, so one may straddle 2 words.
+	const MeshInfo meshInfo = MeshInfos[MeshId];
+	const uint bitOffset = (m.PrimOffset + index) * meshInfo.PrimitiveStride;
+	const uint2 words = PrimitiveIndices.Load2(meshInfo.PrimitiveOffset + ((bitOffset >> 5) << 2));
+	const uint shift = bitOffset & 31;
+	const uint primitive = shift ? (words.x >> shift) | (words.y << (32 - shift)) : words.x;
+
+	return UnpackPrimitive(primitive, meshInfo.PrimitiveIndexBits);
 }
 
-VertexOut GetVertexAttributes(uint meshletIndex, uint vertexIndex)
+MSVertexOut GetVertexAttributes(uint meshletIndex, uint vertexIndex, Instance instance)
 {
-	Vertex v = Vertices[vertexIndex];
+	Vertex v = GetVertex(vertexIndex);
 
-	const float4 positionWS = mul(float4(v.Position, 1.0), Instance.World);
+	// The positions must be bit-identical to those of the depth prepass for its EQUAL test.
+	precise const float4 positionWS = mul(float4(v.Position, 1.0), instance.World);
+	precise const float4 positionHS = mul(positionWS, Constants.ViewProj);
 
-	VertexOut vout;
+	MSVertexOut vout;
+	vout.PositionHS = positionHS;
+#ifndef DEPTH_ONLY
 	vout.PositionVS = mul(positionWS, Constants.View);
-	vout.PositionHS = mul(positionWS, Constants.ViewProj);
-	vout.Normal = mul(v.Normal, (float3x3)Instance.WorldIT);
+	vout.Normal = mul(v.Normal, (float3x3)instance.WorldIT);
 	vout.MeshletIndex = meshletIndex;
+#endif
 
 	return vout;
 }
@@ -76,7 +134,7 @@ void main(
 	uint gtid : SV_GroupThreadID,
 	uint gid : SV_GroupID,
 	in payload Payload payload,
-	out vertices VertexOut verts[MAX_VERTS],
+	out vertices MSVertexOut verts[MAX_VERTS],
 	out indices uint3 tris[MAX_PRIMS]
 )
 {
@@ -84,10 +142,11 @@ void main(
 	const uint meshletIndex = GET_MESHLET_IDX(gid);
 
 	// Catch any out-of-range indices (in case too many MS threadgroups were dispatched from AS)
-	if (meshletIndex >= MeshInfo.MeshletCount) return;
+	const MeshInfo meshInfo = MeshInfos[MeshId];
+	if (meshletIndex >= meshInfo.MeshletCount) return;
 
 	// Load the meshlet
-	Meshlet m = Meshlets[meshletIndex];
+	Meshlet m = Meshlets[meshInfo.MeshletOffset + meshletIndex];
 
 	// Our vertex and primitive counts come directly from the meshlet
 	SetMeshOutputCounts(m.VertCount, m.PrimCount);
@@ -98,7 +157,7 @@ void main(
 	if (gtid < m.VertCount)
 	{
 		const uint vertexIndex = GetVertexIndex(m, gtid);
-		verts[VERT_IDX(gtid)] = GetVertexAttributes(meshletIndex, vertexIndex);
+		verts[VERT_IDX(gtid)] = GetVertexAttributes(meshletIndex, vertexIndex, Instances[GET_INSTANCE_IDX()]);
 	}
 
 	if (gtid < m.PrimCount) tris[PRIM_IDX(gtid)] = GetPrimitive(m, gtid);
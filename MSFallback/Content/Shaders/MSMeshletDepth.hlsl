@@ -0,0 +1,7 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Position-only variant of MSMeshlet for the depth prepass
+#define DEPTH_ONLY
+#include "MSMeshlet.hlsl"
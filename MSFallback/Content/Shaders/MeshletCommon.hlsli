@@ -19,19 +19,34 @@ struct VertexOut
 	uint   MeshletIndex : COLOR;
 };
 
+// Output of the depth prepass, which needs no attributes
+struct DepthVertexOut
+{
+	float4 PositionHS   : SV_Position;
+};
+
 struct Payload
 {
 	uint MeshletIndices[AS_GROUP_SIZE];
+	uint InstanceIndex;
 };
 
 ConstantBuffer<Constants>	Constants;
-ConstantBuffer<MeshInfo>	MeshInfo;
-ConstantBuffer<Instance>	Instance;
-StructuredBuffer<Vertex>	Vertices;
+cbuffer PerDraw
+{
+	uint MeshId;			// Index of the MeshInfo of the dispatch in MeshInfos
+	uint FirstInstance;		// Instances of the dispatch start here
+	uint FirstMeshlet;		// Meshlet range of the dispatch, of visible subsets of the mesh
+	uint NumMeshlets;
+};
+ByteAddressBuffer			Vertices;
 StructuredBuffer<Meshlet>	Meshlets;
 ByteAddressBuffer			UniqueVertexIndices;
-StructuredBuffer<uint>		PrimitiveIndices;
+ByteAddressBuffer			PrimitiveIndices;
 StructuredBuffer<CullData>	MeshletCullData : register (t4);
+StructuredBuffer<Instance>	Instances : register (t5); // All instances of the frame
+StructuredBuffer<MeshInfo>	MeshInfos : register (t6); // Offsets of each mesh in the geometry pool
+StructuredBuffer<LodBounds>	MeshletLods : register (t7); // LOD bounds of the subset of each meshlet
 
 // Rotates a vector, v0, about an axis by some angle
 float3 RotateVector(float3 v0, float3 axis, float angle)
@@ -40,3 +55,12 @@ float3 RotateVector(float3 v0, float3 axis, float angle)
 
 	return cs * v0 + sin(angle) * cross(axis, v0) + (1.0 - cs) * dot(axis, v0) * axis;
 }
+
+// Decodes an octahedral normal from the [-1, 1] square
+float3 OctDecode(float2 oct)
+{
+	float3 n = float3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+	if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * ((n.xy >= 0.0) * 2.0 - 1.0);
+
+	return normalize(n);
+}
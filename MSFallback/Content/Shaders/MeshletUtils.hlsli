@@ -16,6 +16,21 @@ struct MeshInfo
 
     uint LastMeshletVertCount;
     uint LastMeshletPrimCount;
+
+    float4 BoundingSphere;
+
+    float3 PositionBias;
+    uint VertexFormat;
+    float3 PositionScale;
+    uint VertexStride;
+
+    uint PrimitiveIndexBits;
+    uint PrimitiveStride;
+
+    uint VertexOffset;
+    uint UniqueVertexIndexOffset;
+    uint PrimitiveOffset;
+    uint MeshletOffset;
 };
 
 struct Meshlet
@@ -33,6 +48,13 @@ struct CullData
     float  ApexOffset;
 };
 
+struct LodBounds
+{
+    float4 BoundingSphere;
+    float  Error;
+    float  ParentError;
+};
+
 bool IsConeDegenerate(CullData c)
 {
     return (c.NormalCone >> 24) == 0xff;
@@ -19,7 +19,15 @@ cbuffer PerDispatch : FALLBACK_LAYER_PAYLOAD_REG(b0)
 
 StructuredBuffer<VertexOut> VertexPayloads : FALLBACK_LAYER_PAYLOAD_REG(t0);
 
+#ifdef DEPTH_ONLY
+// Reads only the positions of the payload, which are all that the depth-only CSMeshletMS writes.
+float4 main(uint vid : SV_VertexID) : SV_POSITION
+{
+	return VertexPayloads[BATCH_VERTEX_SIZE * BatchIdx + vid].PositionHS;
+}
+#else
 VertexOut main(uint vid : SV_VertexID)
 {
 	return VertexPayloads[BATCH_VERTEX_SIZE * BatchIdx + vid];
 }
+#endif
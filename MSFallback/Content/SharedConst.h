@@ -9,6 +9,8 @@
 
 static const float g_zNear = 1.0f;
 static const float g_zFar = 300.0f;
+static const float g_lodScreenRadius = 0.5f; // Projected radius (1 = half the viewport height) below which coarser LODs are drawn
+static const float g_lodErrorThreshold = 1.0f; // Projected error in pixels below which coarser meshlet LODs are drawn
 
 #define REG_SPACE(s) space##s
 #define FALLBACK_LAYER_PAYLOAD_SPACE 214743648
@@ -18,6 +20,12 @@ static const float g_zFar = 300.0f;
 #define MAX_PRIMS 126
 #define MAX_VERTS 64
 
+// Vertex storage: float3 position and normal, or a 16-bit unorm position within the mesh bounds
+// with an octahedral normal of 2x8 or 2x16 bits
+#define VERTEX_FORMAT_FLOAT 0
+#define VERTEX_FORMAT_Q16_OCT8 1
+#define VERTEX_FORMAT_Q16_OCT16 2
+
 //*********************************************************
 //
 // Copyright (c) Microsoft. All rights reserved.
@@ -45,9 +53,7 @@ using float2 = DirectX::XMFLOAT2;
 using uint = uint32_t;
 #endif
 
-#ifdef __cplusplus
-_declspec(align(256u))
-#endif
+// Element of the instance buffer; not 256-byte aligned, since it is a structured-buffer element
 struct Instance
 {
 	float4x4 World;
@@ -71,6 +77,10 @@ struct Constants
 	float3      CullViewPosition;
 	uint        SelectedIndex;
 
+	float3      LodViewPosition;
+	float       LodErrorThreshold; // Pixels
+
+	float       LodErrorScale;     // Pixels per unit of error at unit distance
 	uint        DrawMeshlets;
 };
 
@@ -93,6 +103,7 @@ struct DispatchArgs
 		uint y;
 		uint z;
 		uint MeshletIndices[AS_GROUP_SIZE];
+		uint InstanceIndex;
 	} ASDispatchArgs;
 };
 
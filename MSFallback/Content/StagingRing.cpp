@@ -0,0 +1,234 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "StagingRing.h"
+
+using namespace std;
+using namespace XUSG;
+
+StagingRing::StagingRing() :
+	m_pDevice(nullptr),
+	m_pCommandQueue(nullptr),
+	m_fenceValue(0),
+	m_fenceEvent(nullptr),
+	m_pageSize(DefaultPageSize),
+	m_pageCount(0),
+	m_maxPageCount(DefaultMaxPageCount),
+	m_isFlushed(false)
+{
+}
+
+StagingRing::~StagingRing()
+{
+	if (m_fenceEvent) CloseHandle(m_fenceEvent);
+}
+
+bool StagingRing::Init(const Device* pDevice, CommandQueue* pCommandQueue, size_t pageSize, uint32_t maxPageCount)
+{
+	m_pDevice = pDevice;
+	m_pCommandQueue = pCommandQueue;
+	m_pageSize = XUSG_DIV_UP(pageSize, Alignment) * Alignment;
+	m_maxPageCount = (max)(maxPageCount, 1u);
+
+	m_fence = Fence::MakeUnique();
+	XUSG_N_RETURN(m_fence->Create(pDevice, m_fenceValue, FenceFlag::NONE, L"StagingFence"), false);
+
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	XUSG_N_RETURN(m_fenceEvent, false);
+
+	// The command list of the ring's own flushes is created closed, and reset when needed.
+	m_commandAllocator = CommandAllocator::MakeUnique();
+	XUSG_N_RETURN(m_commandAllocator->Create(pDevice, CommandListType::DIRECT, L"StagingCommandAllocator"), false);
+
+	m_commandList = CommandList::MakeUnique();
+	XUSG_N_RETURN(m_commandList->Create(pDevice, 0, CommandListType::DIRECT,
+		m_commandAllocator.get(), nullptr, L"StagingCommandList"), false);
+	XUSG_N_RETURN(m_commandList->Close(), false);
+
+	return true;
+}
+
+void* StagingRing::Allocate(size_t byteSize, Allocation& allocation)
+{
+	const auto alignedSize = XUSG_DIV_UP(byteSize, Alignment) * Alignment;
+	if (m_pendingPages.empty() || m_pendingPages.back().UsedSize + alignedSize > m_pendingPages.back().Size)
+		if (!newPage(alignedSize)) return nullptr;
+
+	auto& page = m_pendingPages.back();
+	allocation.pResource = page.Buffer.get();
+	allocation.Offset = page.UsedSize;
+	allocation.Size = byteSize;
+	page.UsedSize += alignedSize;
+
+	return &page.pData[allocation.Offset];
+}
+
+void StagingRing::Copy(Resource* pDst, size_t dstOffset, const Allocation& src, ResourceState dstState)
+{
+	// Extend the last copy if this one continues it in both buffers.
+	if (!m_copies.empty())
+	{
+		auto& last = m_copies.back();
+		if (last.pDst == pDst && last.Src.pResource == src.pResource && last.DstState == dstState &&
+			last.DstOffset + last.Src.Size == dstOffset && last.Src.Offset + last.Src.Size == src.Offset)
+		{
+			last.Src.Size += src.Size;
+
+			return;
+		}
+	}
+
+	m_copies.push_back({ pDst, dstOffset, src, dstState });
+}
+
+bool StagingRing::Upload(Resource* pDst, size_t dstOffset, const void* pData, size_t byteSize, ResourceState dstState)
+{
+	// Fill the rest of the current page first, so that data of any size streams through
+	// whole pages instead of getting an oversized page.
+	const auto pBytes = static_cast<const uint8_t*>(pData);
+	for (size_t offset = 0; offset < byteSize;)
+	{
+		const auto freeSize = m_pendingPages.empty() ? 0 : m_pendingPages.back().Size - m_pendingPages.back().UsedSize;
+		const auto size = (min)(byteSize - offset, freeSize > 0 ? freeSize : m_pageSize);
+
+		Allocation allocation;
+		const auto pStaging = Allocate(size, allocation);
+		if (!pStaging) return false;
+
+		memcpy(pStaging, &pBytes[offset], size);
+		Copy(pDst, dstOffset + offset, allocation, dstState);
+		offset += size;
+	}
+
+	return true;
+}
+
+void StagingRing::Flush(CommandList* pCommandList)
+{
+	if (m_copies.empty()) return;
+
+	// Each destination is transitioned once before and once after all copies.
+	vector<Resource*> dsts;
+	vector<ResourceState> dstStates;
+	for (const auto& copy : m_copies)
+	{
+		const auto it = find(dsts.cbegin(), dsts.cend(), copy.pDst);
+		if (it == dsts.cend())
+		{
+			dsts.emplace_back(copy.pDst);
+			dstStates.emplace_back(copy.DstState);
+		}
+		else dstStates[it - dsts.cbegin()] = copy.DstState;
+	}
+
+	vector<ResourceBarrier> barriers(dsts.size());
+	auto numBarriers = 0u;
+	for (const auto pDst : dsts) numBarriers = pDst->SetBarrier(barriers.data(), ResourceState::COPY_DEST, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers.data());
+
+	for (const auto& copy : m_copies)
+		pCommandList->CopyBufferRegion(copy.pDst, copy.DstOffset, copy.Src.pResource, copy.Src.Offset, copy.Src.Size);
+
+	numBarriers = 0;
+	for (size_t i = 0; i < dsts.size(); ++i) numBarriers = dsts[i]->SetBarrier(barriers.data(), dstStates[i], numBarriers);
+	pCommandList->Barrier(numBarriers, barriers.data());
+
+	m_copies.clear();
+	m_isFlushed = true;
+}
+
+bool StagingRing::Submit(CommandQueue* pCommandQueue)
+{
+	assert(m_copies.empty());
+	XUSG_N_RETURN(pCommandQueue->Signal(m_fence.get(), ++m_fenceValue), false);
+
+	for (auto& page : m_pendingPages)
+	{
+		page.FenceValue = m_fenceValue;
+		m_retiredPages.emplace_back(move(page));
+	}
+	m_pendingPages.clear();
+	m_isFlushed = false;
+
+	return true;
+}
+
+void StagingRing::Recycle(uint32_t maxFreePages)
+{
+	// Pages retire in fence order.
+	const auto completedValue = m_fence->GetCompletedValue();
+	auto n = 0u;
+	for (; n < m_retiredPages.size() && m_retiredPages[n].FenceValue <= completedValue; ++n)
+	{
+		auto& page = m_retiredPages[n];
+		page.UsedSize = 0;
+
+		// Oversized pages are only kept for the data they were made for.
+		if (page.Size == m_pageSize && m_freePages.size() < maxFreePages) m_freePages.emplace_back(move(page));
+		else --m_pageCount;
+	}
+	m_retiredPages.erase(m_retiredPages.begin(), m_retiredPages.begin() + n);
+
+	while (m_freePages.size() > maxFreePages)
+	{
+		m_freePages.pop_back();
+		--m_pageCount;
+	}
+}
+
+uint32_t StagingRing::GetPageCount() const
+{
+	return m_pageCount;
+}
+
+bool StagingRing::newPage(size_t byteSize)
+{
+	// Wait for pages to free up rather than exceed the page budget, unless the GPU cannot get
+	// to them before the caller submits its command list.
+	if (m_freePages.empty() && m_pageCount >= m_maxPageCount && !m_isFlushed)
+	{
+		Recycle(m_maxPageCount);
+		if (m_freePages.empty()) XUSG_N_RETURN(drain(), false);
+	}
+
+	if (byteSize <= m_pageSize && !m_freePages.empty())
+	{
+		m_pendingPages.emplace_back(move(m_freePages.back()));
+		m_freePages.pop_back();
+
+		return true;
+	}
+
+	Page page;
+	page.Size = (max)(byteSize, m_pageSize);
+	page.UsedSize = 0;
+	page.FenceValue = 0;
+	page.Buffer = Buffer::MakeUnique();
+	XUSG_N_RETURN(page.Buffer->Create(m_pDevice, page.Size, ResourceFlag::NONE, MemoryType::UPLOAD,
+		1, nullptr, 0, nullptr, MemoryFlag::NONE, (L"StagingPage" + to_wstring(m_pageCount)).c_str()), false);
+	page.pData = static_cast<uint8_t*>(page.Buffer->Map());
+	XUSG_N_RETURN(page.pData, false);
+
+	m_pendingPages.emplace_back(move(page));
+	++m_pageCount;
+
+	return true;
+}
+
+bool StagingRing::drain()
+{
+	// Copy from all pending pages on the ring's own command list, and wait for the GPU.
+	XUSG_N_RETURN(m_commandAllocator->Reset(), false);
+	XUSG_N_RETURN(m_commandList->Reset(m_commandAllocator.get(), nullptr), false);
+	Flush(m_commandList.get());
+	XUSG_N_RETURN(m_commandList->Close(), false);
+	m_pCommandQueue->ExecuteCommandList(m_commandList.get());
+	XUSG_N_RETURN(Submit(m_pCommandQueue), false);
+
+	XUSG_N_RETURN(m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent), false);
+	WaitForSingleObject(m_fenceEvent, INFINITE);
+	Recycle(m_maxPageCount);
+
+	return true;
+}
@@ -0,0 +1,100 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+
+// Staging memory for buffer uploads, packed into large persistently mapped upload pages that
+// are reused. Copies are queued as the data is staged, and recorded in one batch by Flush(),
+// with a single barrier batch on either side. Pages are recycled once the fence signaled by
+// Submit() shows that the GPU has finished copying from them. Once maxPageCount pages exist
+// and none is free, the ring records the queued copies on a command list of its own, submits
+// them and waits for the GPU, so that large loads stream through a bounded set of pages.
+class StagingRing
+{
+public:
+	struct Allocation
+	{
+		const XUSG::Resource* pResource;
+		size_t Offset;
+		size_t Size;
+	};
+
+	StagingRing();
+	virtual ~StagingRing();
+
+	bool Init(const XUSG::Device* pDevice, XUSG::CommandQueue* pCommandQueue,
+		size_t pageSize = DefaultPageSize, uint32_t maxPageCount = DefaultMaxPageCount);
+
+	// Returns the mapped staging memory for byteSize bytes, or nullptr if a new page fails.
+	// Data larger than a page gets a page of its own. The allocation must be queued by Copy()
+	// before the next one, which may have to flush the queued copies to free a page.
+	void* Allocate(size_t byteSize, Allocation& allocation);
+
+	// Queues a copy of staged data to a buffer, which ends up in dstState after the copy.
+	void Copy(XUSG::Resource* pDst, size_t dstOffset, const Allocation& src, XUSG::ResourceState dstState);
+
+	// Stages the data and queues its copy, split at page boundaries.
+	bool Upload(XUSG::Resource* pDst, size_t dstOffset, const void* pData, size_t byteSize,
+		XUSG::ResourceState dstState);
+
+	// Records all queued copies, merging the ones that continue the previous copy. Until the
+	// command list is submitted, the ring cannot flush by itself and grows beyond maxPageCount.
+	void Flush(XUSG::CommandList* pCommandList);
+
+	// Signals the fence after the flushed command lists on the queue; the pages they copy
+	// from are then in flight until it completes.
+	bool Submit(XUSG::CommandQueue* pCommandQueue);
+
+	// Returns the pages that the GPU has finished with to the free list, and releases those
+	// beyond maxFreePages.
+	void Recycle(uint32_t maxFreePages = 1);
+
+	uint32_t GetPageCount() const;
+
+	static const size_t DefaultPageSize = 16 << 20;
+	static const uint32_t DefaultMaxPageCount = 4;
+	static const size_t Alignment = 16;
+
+protected:
+	struct Page
+	{
+		XUSG::Buffer::uptr Buffer;
+		uint8_t* pData;
+		size_t Size;
+		size_t UsedSize;
+		uint64_t FenceValue;
+	};
+
+	struct CopyCommand
+	{
+		XUSG::Resource* pDst;
+		size_t DstOffset;
+		Allocation Src;
+		XUSG::ResourceState DstState;
+	};
+
+	bool newPage(size_t byteSize);
+	bool drain();
+
+	const XUSG::Device* m_pDevice;
+	XUSG::CommandQueue* m_pCommandQueue;
+	XUSG::CommandAllocator::uptr m_commandAllocator;
+	XUSG::CommandList::uptr m_commandList;
+	XUSG::Fence::uptr m_fence;
+	uint64_t m_fenceValue;
+	HANDLE m_fenceEvent;
+
+	std::vector<Page> m_freePages;
+	std::vector<Page> m_pendingPages;	// Staged into since the last Submit(), the last one is current
+	std::vector<Page> m_retiredPages;	// In flight until their fence values complete
+
+	std::vector<CopyCommand> m_copies;
+
+	size_t m_pageSize;
+	uint32_t m_pageCount;
+	uint32_t m_maxPageCount;
+	bool m_isFlushed;	// Copies are recorded in a command list that is not submitted yet
+};
@@ -26,12 +26,13 @@ MSFallback::MSFallback(uint32_t width, uint32_t height, std::wstring name) :
 	m_deviceType(DEVICE_DISCRETE),
 	m_isMSSupported(false),
 	m_useMeshShader(false),
+	m_useDepthPrepass(false),
 	m_useDebugCamera(false),
 	m_showFPS(true),
 	m_pausing(false),
 	m_tracking(false),
 	m_modelFilenames{ L"Assets/Dragon_LOD0.bin" },
-	m_objDefs{ { {}, {}, 0.2f, true, true } }, // View Model
+	m_objDefs{ { {}, {}, 0.2f, true, true, VERTEX_FORMAT_Q16_OCT16, 1 } }, // View Model
 	m_screenShot(0)
 {
 #if defined (_DEBUG)
@@ -174,18 +175,21 @@ void MSFallback::LoadAssets()
 	m_renderer = make_unique<Renderer>();
 	if (!m_renderer) ThrowIfFailed(E_FAIL);
 
-	vector<Resource::uptr> uploaders(0);
-	
+	m_stagingRing = make_unique<StagingRing>();
+	if (!m_stagingRing) ThrowIfFailed(E_FAIL);
+	XUSG_N_RETURN(m_stagingRing->Init(m_device.get(), m_commandQueue.get()), ThrowIfFailed(E_FAIL));
+
 	/// <Hard Code>
 	/// Resolve pso mismatch by using'D24_UNORM_S8_UINT'
 	/// </Hard Code>
 	if (!m_renderer->Init(pCommandList, m_descriptorTableLib, m_width, m_height,
-		m_renderTargets[0]->GetFormat(), uploaders, static_cast<uint32_t>(size(m_objDefs)),
+		m_renderTargets[0]->GetFormat(), m_stagingRing.get(), static_cast<uint32_t>(size(m_objDefs)),
 		m_modelFilenames, m_objDefs, m_isMSSupported)) ThrowIfFailed(E_FAIL);
 
 	// Close the command list and execute it to begin the initial GPU setup.
 	XUSG_N_RETURN(pCommandList->Close(), ThrowIfFailed(E_FAIL));
 	m_commandQueue->ExecuteCommandList(pCommandList);
+	XUSG_N_RETURN(m_stagingRing->Submit(m_commandQueue.get()), ThrowIfFailed(E_FAIL));
 
 	// Create synchronization objects and wait until assets have been uploaded to the GPU.
 	{
@@ -205,6 +209,9 @@ void MSFallback::LoadAssets()
 		WaitForGpu();
 	}
 
+	// The staging pages of the assets are free now; keep one for later uploads.
+	m_stagingRing->Recycle();
+
 	// Projection
 	const auto aspectRatio = m_width / static_cast<float>(m_height);
 	const auto proj = XMMatrixPerspectiveFovRH(g_fovAngleY, aspectRatio, g_zNear, g_zFar);
@@ -234,7 +241,7 @@ void MSFallback::OnUpdate()
 	//const auto eyePt = XMLoadFloat3(&m_eyePt);
 	const auto view = XMLoadFloat4x4(&m_view);
 	const auto proj = XMLoadFloat4x4(&m_proj);
-	m_renderer->UpdateFrame(m_frameIndex, view, m_useDebugCamera ? nullptr : &proj, m_eyePt);
+	XUSG_N_RETURN(m_renderer->UpdateFrame(m_frameIndex, view, m_useDebugCamera ? nullptr : &proj, m_eyePt), ThrowIfFailed(E_FAIL));
 }
 
 // Render the scene.
@@ -281,6 +288,9 @@ void MSFallback::OnKeyUp(uint8_t key)
 	case 'C':
 		m_useDebugCamera = !m_useDebugCamera;
 		break;
+	case 'Z':
+		m_useDepthPrepass = !m_useDepthPrepass;
+		break;
 	}
 }
 
@@ -385,6 +395,24 @@ void MSFallback::ParseCommandLineArgs(wchar_t* argv[], int argc)
 			if (hasNextArgValue(i)) i += swscanf_s(argv[i + 1], L"%f", &m_objDefs[0].Position.z);
 			if (hasNextArgValue(i)) i += swscanf_s(argv[i + 1], L"%f", &m_objDefs[0].Scale);
 		}
+		else if (isArgMatched(i, L"vertexformat"))
+		{
+			uint32_t vertexFormat;
+			if (hasNextArgValue(i) && swscanf_s(argv[i + 1], L"%u", &vertexFormat) == 1 && vertexFormat <= VERTEX_FORMAT_Q16_OCT16)
+			{
+				m_objDefs[0].VertexFormat = static_cast<uint8_t>(vertexFormat);
+				++i;
+			}
+		}
+		else if (isArgMatched(i, L"instances"))
+		{
+			uint32_t instanceCount;
+			if (hasNextArgValue(i) && swscanf_s(argv[i + 1], L"%u", &instanceCount) == 1 && instanceCount > 0)
+			{
+				m_objDefs[0].InstanceCount = instanceCount;
+				++i;
+			}
+		}
 	}
 }
 
@@ -418,7 +446,7 @@ void MSFallback::PopulateCommandList()
 	pCommandList->ClearRenderTargetView(pRenderTarget->GetRTV(), clearColor);
 
 	// Rendering
-	m_renderer->Render(pCommandList, m_frameIndex, pRenderTarget->GetRTV(), m_useMeshShader);
+	m_renderer->Render(pCommandList, m_frameIndex, pRenderTarget->GetRTV(), m_useMeshShader, m_useDepthPrepass);
 
 	// Indicate that the back buffer will now be used to present.
 	numBarriers = pRenderTarget->SetBarrier(&barrier, ResourceState::PRESENT);
@@ -526,7 +554,11 @@ double MSFallback::CalculateFrameStats(float* pTimeStep)
 		if (m_showFPS) windowText << setprecision(2) << fixed << fps;
 		else windowText << L"[F1]";
 		windowText << L"    [P] " << (m_useMeshShader ? "Mesh-shader pipeline" : "Fallback pipelines");
+		windowText << L"    [Z] " << (m_useDepthPrepass ? "Depth prepass" : "Single pass");
 		windowText << L"    [C] " << (m_useDebugCamera ? "Culling camera" : "Third-person camera");
+		windowText << L"    Culled objects: " << m_renderer->GetCulledObjectCount();
+		windowText << L" (meshes: " << m_renderer->GetCulledMeshCount();
+		windowText << L", subsets: " << m_renderer->GetCulledSubsetCount() << L")";
 		windowText << L"    [F11] screen shot";
 
 		SetCustomWindowText(windowText.str().c_str());
@@ -71,6 +71,7 @@ private:
 
 	// App resources.
 	std::unique_ptr<Renderer> m_renderer;
+	std::unique_ptr<StagingRing> m_stagingRing;
 	DirectX::XMFLOAT4X4	m_proj;
 	DirectX::XMFLOAT4X4	m_view;
 	DirectX::XMFLOAT3	m_focusPt;
@@ -86,6 +87,7 @@ private:
 	DeviceType	m_deviceType;
 	StepTimer	m_timer;
 	bool		m_useMeshShader;
+	bool		m_useDepthPrepass;
 	bool		m_useDebugCamera;
 	bool		m_showFPS;
 	bool		m_pausing;
@@ -4,10 +4,295 @@
 
 #include "XUSGObjLoader.h"
 
+#include <numeric>
+#include <thread>
+
 using namespace std;
+using namespace DirectX;
 using namespace XUSG;
 
-ObjLoader::ObjLoader()
+namespace
+{
+	const size_t MinChunkBytes = 1 << 20;	// Smaller file chunks are not worth a thread
+	const uint32_t MinRangeSize = 1 << 16;	// Nor are smaller element ranges
+
+	// Runs func(i) for each i in [0, count) on its own thread.
+	template<typename Func>
+	void ForEachOnThread(uint32_t count, const Func& func)
+	{
+		vector<thread> threads;
+		threads.reserve(count);
+		for (auto i = 1u; i < count; ++i) threads.emplace_back(func, i);
+		if (count > 0) func(0);
+
+		for (auto& thread : threads) thread.join();
+	}
+
+	// Splits [0, count) into contiguous ranges on up to numThreads threads and runs func(range, begin, end).
+	template<typename Func>
+	void ForEachRange(uint32_t count, uint32_t numThreads, const Func& func)
+	{
+		const auto numRanges = (min)(numThreads, (count + MinRangeSize - 1) / MinRangeSize);
+		ForEachOnThread(numRanges, [&](uint32_t i)
+		{
+			const auto begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / numRanges);
+			const auto end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / numRanges);
+			func(i, begin, end);
+		});
+	}
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	bool IsDigit(char c)
+	{
+		return static_cast<uint8_t>(c - '0') < 10;
+	}
+
+	const char* SkipSpaces(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && IsSpace(*p)) ++p;
+
+		return p;
+	}
+
+	const char* SkipLine(const char* p, const char* pEnd)
+	{
+		p = static_cast<const char*>(memchr(p, '\n', pEnd - p));
+
+		return p ? p + 1 : pEnd;
+	}
+
+	bool ParseInt(const char*& p, const char* pEnd, int64_t& value)
+	{
+		auto negative = false;
+		if (p < pEnd && (*p == '-' || *p == '+')) negative = *p++ == '-';
+		if (p >= pEnd || !IsDigit(*p)) return false;
+
+		// Saturate at 18 digits, far past any index or exponent, so that long runs cannot overflow.
+		const int64_t maxValue = 999999999999999999;
+		int64_t v = 0;
+		for (; p < pEnd && IsDigit(*p); ++p) v = v < maxValue / 10 ? v * 10 + (*p - '0') : maxValue;
+		value = negative ? -v : v;
+
+		return true;
+	}
+
+	float ParseFloat(const char*& p, const char* pEnd)
+	{
+		static const double powers[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		p = SkipSpaces(p, pEnd);
+		auto negative = false;
+		if (p < pEnd && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+		// Up to 19 significant digits fit in the mantissa; the rest only scale the exponent.
+		uint64_t mantissa = 0;
+		auto digits = 0;
+		auto exponent = 0;
+		for (; p < pEnd && IsDigit(*p); ++p)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa ? 1 : 0;
+			}
+			else ++exponent;
+		}
+
+		if (p < pEnd && *p == '.')
+		{
+			for (++p; p < pEnd && IsDigit(*p); ++p)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += mantissa ? 1 : 0;
+					--exponent;
+				}
+			}
+		}
+
+		if (p < pEnd && (*p == 'e' || *p == 'E'))
+		{
+			int64_t e;
+			++p;
+			if (ParseInt(p, pEnd, e)) exponent += static_cast<int>((min)((max)(e, static_cast<int64_t>(-400)), static_cast<int64_t>(400)));
+		}
+
+		auto value = static_cast<double>(mantissa);
+		if (exponent < 0) value = exponent >= -22 ? value / powers[-exponent] : value * pow(10.0, exponent);
+		else if (exponent > 0) value = exponent <= 22 ? value * powers[exponent] : value * pow(10.0, exponent);
+
+		return static_cast<float>(negative ? -value : value);
+	}
+
+	// Header of the binary cache, followed by the vertices in the layout of the loader and then
+	// the indices. Its size keeps the vertices 16-byte aligned in the mapping.
+	struct CacheHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t SourceHash;
+		uint64_t SourceSize;
+		uint32_t Options;
+		uint32_t Attributes;	// Bit 0: normal, bit 1: texcoord
+		uint32_t Stride;
+		uint32_t NumVertices;
+		uint32_t NumIndices;
+		float Min[3];
+		float Max[3];
+		uint32_t Reserved[3];
+	};
+	static_assert(sizeof(CacheHeader) % 16 == 0, "The cached vertices must stay 16-byte aligned.");
+
+	const uint32_t CacheMagic = 0x4a424f58; // "XOBJ"
+	const uint32_t CacheVersion = 3;
+
+	const uint32_t AttributeSizes[] = { sizeof(ObjLoader::float3), sizeof(ObjLoader::float3), sizeof(float[2]) };
+	const size_t StreamAlignment = 16;
+
+	// 64-bit hash of the file content, word by word
+	uint64_t HashContent(const char* pData, size_t size)
+	{
+		const auto prime = 0x100000001b3ull;
+		auto h = 0xcbf29ce484222325ull ^ size;
+
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+		{
+			uint64_t w;
+			memcpy(&w, &pData[i], sizeof(uint64_t));
+			h = (h ^ w) * prime;
+			h ^= h >> 29;
+		}
+		for (; i < size; ++i) h = (h ^ static_cast<uint8_t>(pData[i])) * prime;
+
+		return h;
+	}
+
+	uint32_t HashVertex(uint32_t v, uint32_t t, uint32_t n)
+	{
+		auto h = v * 0x9e3779b1u ^ t * 0x85ebca77u ^ n * 0xc2b2ae3du;
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+
+		return h;
+	}
+
+	enum class Keyword : uint8_t
+	{
+		NONE,
+		V,
+		VT,
+		VN,
+		F
+	};
+
+	// Identifies the keyword at the beginning of a line and skips it with the following space.
+	Keyword ParseKeyword(const char*& p, const char* pEnd)
+	{
+		p = SkipSpaces(p, pEnd);
+		if (pEnd - p > 1 && p[0] == 'v')
+		{
+			if (IsSpace(p[1]))
+			{
+				p += 2;
+				return Keyword::V;
+			}
+
+			if (pEnd - p > 2 && IsSpace(p[2]) && (p[1] == 't' || p[1] == 'n'))
+			{
+				p += 3;
+				return p[-2] == 't' ? Keyword::VT : Keyword::VN;
+			}
+		}
+		else if (pEnd - p > 1 && p[0] == 'f' && IsSpace(p[1]))
+		{
+			p += 2;
+			return Keyword::F;
+		}
+
+		return Keyword::NONE;
+	}
+
+	XMVECTOR FaceNormal(const ObjLoader::float3* pPositions, const uint32_t* pTri)
+	{
+		const auto v0 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pPositions[pTri[0]]));
+		const auto v1 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pPositions[pTri[1]]));
+		const auto v2 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pPositions[pTri[2]]));
+
+		return XMVector3Normalize(XMVector3Cross(v1 - v0, v2 - v1));
+	}
+
+	// Converts a 1-based or relative OBJ index to a 0-based one; 0 is invalid.
+	uint32_t ResolveIndex(int64_t i, size_t count, bool& isRelative)
+	{
+		isRelative = i < 0;
+
+		return static_cast<uint32_t>(i > 0 ? i - 1 : (i < 0 ? static_cast<int64_t>(count) + i : UINT32_MAX));
+	}
+}
+
+// Read-only memory mapping of a whole file
+class ObjLoader::MappedFile
+{
+public:
+	MappedFile() : m_hFile(INVALID_HANDLE_VALUE), m_hMapping(nullptr), m_pData(nullptr), m_size(0) {}
+	~MappedFile()
+	{
+		if (m_pData) UnmapViewOfFile(m_pData);
+		if (m_hMapping) CloseHandle(m_hMapping);
+		if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+	}
+
+	bool Open(const char* pszFilename)
+	{
+		m_hFile = CreateFileA(pszFilename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_hFile == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart <= 0) return false;
+		m_size = static_cast<size_t>(size.QuadPart);
+
+		m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_hMapping) return false;
+
+		m_pData = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+
+		return m_pData != nullptr;
+	}
+
+	const char* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	HANDLE		m_hFile;
+	HANDLE		m_hMapping;
+	const char*	m_pData;
+	size_t		m_size;
+};
+
+ObjLoader::ObjLoader(VertexLayout layout) :
+	m_pCachedVertices(nullptr),
+	m_pCachedIndices(nullptr),
+	m_cachedVertexDataSize(0),
+	m_numCachedIndices(0),
+	m_layout(layout),
+	m_numVertices(0),
+	m_stride(0),
+	m_attributeOffsets(),
+	m_streamOffsets(),
+	m_aabb(),
+	m_numThreads(1)
 {
 }
 
@@ -15,38 +300,131 @@ ObjLoader::~ObjLoader()
 {
 }
 
-bool ObjLoader::Import(const char* pszFilename, bool needNorm, bool needAABB, bool forDX, bool swapYZ)
+bool ObjLoader::Import(const char* pszFilename, bool needNorm, bool needAABB,
+	bool forDX, bool swapYZ, uint32_t numThreads, const char* pszCacheFilename)
 {
-	FILE* pFile;
-	fopen_s(&pFile, pszFilename, "r");
+	releaseGeometry();
 
-	if (!pFile) return false;
+	MappedFile file;
+	if (!file.Open(pszFilename)) return false;
 
-	m_stride = sizeof(float3);
-	m_stride += needNorm ? sizeof(float3) : 0;
+	// Reuse the cached geometry if it was processed from the same content with the same options.
+	const auto options = (needNorm ? 1u : 0u) | (forDX ? 2u : 0u) | (swapYZ ? 4u : 0u) |
+		(m_layout == VertexLayout::SEPARATE ? 8u : 0u);
+	const auto hash = pszCacheFilename ? HashContent(file.GetData(), file.GetSize()) : 0;
+	if (pszCacheFilename && loadCache(pszCacheFilename, hash, file.GetSize(), options)) return true;
+
+	// Parse the OBJ file in a single pass, split into a chunk per thread if it is large enough.
+	const auto size = file.GetSize();
+	m_numThreads = numThreads ? numThreads : (max)(thread::hardware_concurrency(), 1u);
+	const auto numChunks = static_cast<uint32_t>((min)(static_cast<size_t>(m_numThreads), size / MinChunkBytes));
 
-	// Import the OBJ file.
-	uint32_t numTexc, numNorm;
-	importGeometryFirstPass(pFile, numTexc, numNorm);
-	rewind(pFile);
-	importGeometrySecondPass(pFile, numTexc, numNorm, forDX, swapYZ);
-	fclose(pFile);
+	Chunk chunk;
+	if (numChunks > 1) parseChunks(chunk, file.GetData(), size, numChunks);
+	else parseChunk(chunk, file.GetData(), file.GetData() + size);
+	loadGeometry(chunk, needNorm, forDX, swapYZ);
 
 	// Perform post import tasks.
-	if (needNorm && !numNorm) recomputeNormals();
-	if (needAABB) computeAABB();
+	if ((needAABB || pszCacheFilename) && !m_vertices.empty()) computeAABB();
+
+	// Failing to write the cache only costs the next import its speedup.
+	if (m_layout == VertexLayout::SEPARATE) separateStreams();
+	if (pszCacheFilename) saveCache(pszCacheFilename, hash, file.GetSize(), options);
 
 	return true;
 }
 
+bool ObjLoader::ImportStreamed(const char* pszFilename, uint32_t blockTriCount,
+	const BlockCallback& callback, bool needNorm, bool forDX, bool swapYZ)
+{
+	releaseGeometry();
+
+	MappedFile file;
+	if (blockTriCount == 0 || !file.Open(pszFilename)) return false;
+
+	const auto pData = file.GetData();
+	const auto pEnd = pData + file.GetSize();
+	const auto maxIndices = static_cast<size_t>(blockTriCount) * 3;
+
+	// Only the attributes stay resident, since faces may refer to any preceding ones.
+	Chunk chunk;
+	parseChunk(chunk, pData, pEnd, false);
+	convertAttributes(chunk, forDX, swapYZ);
+
+	const auto genNorm = needNorm && chunk.Normals.empty();
+	setVertexFormat(needNorm || !chunk.Normals.empty(), !chunk.Texcoords.empty());
+
+	// Parses the next block of faces with the triangles rewound as in Import().
+	const auto flip = (forDX && !swapYZ) || (!forDX && swapYZ);
+	const auto nextBlock = [&](const char* p, size_t counts[3])
+	{
+		chunk.VIndices.clear();
+		chunk.TIndices.clear();
+		chunk.NIndices.clear();
+		chunk.RelVIndices.clear();
+		chunk.RelTIndices.clear();
+		chunk.RelNIndices.clear();
+
+		p = parseFaces(chunk, p, pEnd, counts, maxIndices);
+		compactTriangles(chunk);
+		if (flip)
+		{
+			for (size_t i = 0; i < chunk.VIndices.size(); i += 3)
+			{
+				swap(chunk.VIndices[i], chunk.VIndices[i + 2]);
+				if (!chunk.TIndices.empty()) swap(chunk.TIndices[i], chunk.TIndices[i + 2]);
+				if (!chunk.NIndices.empty()) swap(chunk.NIndices[i], chunk.NIndices[i + 2]);
+			}
+		}
+
+		return p;
+	};
+
+	// Sum the face normals per position in an extra pass over the faces if they are generated.
+	if (genNorm)
+	{
+		vector<float3> normals(chunk.Positions.size(), float3(0.0f, 0.0f, 0.0f));
+		size_t counts[3] = {};
+		for (auto p = pData; p < pEnd;)
+		{
+			p = nextBlock(p, counts);
+			for (size_t i = 0; i < chunk.VIndices.size(); i += 3)
+			{
+				const auto n = FaceNormal(chunk.Positions.data(), &chunk.VIndices[i]);
+				for (uint8_t k = 0; k < 3; ++k)
+				{
+					const auto pNormal = reinterpret_cast<XMFLOAT3*>(&normals[chunk.VIndices[i + k]]);
+					XMStoreFloat3(pNormal, XMLoadFloat3(pNormal) + n);
+				}
+			}
+		}
+		chunk.Normals = move(normals);
+	}
+
+	size_t counts[3] = {};
+	auto completed = true;
+	for (auto p = pData; p < pEnd && completed;)
+	{
+		p = nextBlock(p, counts);
+		if (genNorm) chunk.NIndices = chunk.VIndices;
+		indexVertices(chunk);
+		if (m_layout == VertexLayout::SEPARATE) separateStreams();
+		if (!m_indices.empty()) completed = callback(GetVertices(), GetNumVertices(), GetIndices(), GetNumIndices());
+	}
+
+	releaseGeometry();
+
+	return completed;
+}
+
 const uint32_t ObjLoader::GetNumVertices() const
 {
-	return static_cast<uint32_t>(m_vertices.size() / GetVertexStride());
+	return m_numVertices;
 }
 
 const uint32_t ObjLoader::GetNumIndices() const
 {
-	return static_cast<uint32_t>(m_indices.size());
+	return m_cacheFile ? m_numCachedIndices : static_cast<uint32_t>(m_indices.size());
 }
 
 const uint32_t ObjLoader::GetVertexStride() const
@@ -56,363 +434,527 @@ const uint32_t ObjLoader::GetVertexStride() const
 
 const uint8_t* ObjLoader::GetVertices() const
 {
-	return m_vertices.data();
+	return m_cacheFile ? m_pCachedVertices : m_vertices.data();
 }
 
-const uint32_t* ObjLoader::GetIndices() const
+const size_t ObjLoader::GetVertexDataSize() const
 {
-	return m_indices.data();
+	return m_cacheFile ? m_cachedVertexDataSize : m_vertices.size();
 }
 
-const ObjLoader::AABB& ObjLoader::GetAABB() const
+ObjLoader::VertexStream ObjLoader::GetVertexStream(VertexAttribute attribute) const
 {
-	return m_aabb;
+	const auto i = static_cast<uint8_t>(attribute);
+	VertexStream stream = {};
+	if (m_attributeOffsets[i] == UINT32_MAX) return stream;
+
+	stream.Offset = m_layout == VertexLayout::SEPARATE ? m_streamOffsets[i] : m_attributeOffsets[i];
+	stream.Stride = m_layout == VertexLayout::SEPARATE ? AttributeSizes[i] : m_stride;
+	stream.pData = GetVertices() + stream.Offset;
+
+	return stream;
 }
 
-void ObjLoader::importGeometryFirstPass(FILE* pFile, uint32_t& numTexc, uint32_t& numNorm)
+bool ObjLoader::CopyVertexAttribute(VertexAttribute attribute, void* pDst, uint32_t dstStride) const
 {
-	auto v = 0u;
-	auto vt = 0u;
-	auto vn = 0u;
-	char buffer[256] = { 0 };
+	const auto stream = GetVertexStream(attribute);
+	if (!stream.pData) return false;
 
-	auto numVert = 0u;
-	auto numTri = 0u;
-	numTexc = 0;
-	numNorm = 0;
+	const auto size = AttributeSizes[static_cast<uint8_t>(attribute)];
+	if (stream.Stride == size && dstStride == size) memcpy(pDst, stream.pData, static_cast<size_t>(size) * m_numVertices);
+	else for (auto i = 0u; i < m_numVertices; ++i)
+		memcpy(static_cast<uint8_t*>(pDst) + static_cast<size_t>(dstStride) * i, stream.pData + static_cast<size_t>(stream.Stride) * i, size);
 
-	while (fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer))) != EOF)
-	{
-		switch (buffer[0])
-		{
-		case 'f':   // v, v//vn, v/vt, v/vt/vn.
-			fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer)));
+	return true;
+}
 
-			if (strstr(buffer, "//")) // v//vn
-			{
-				sscanf_s(buffer, "%u//%u", &v, &vn);
-				fscanf_s(pFile, "%u//%u", &v, &vn);
-				fscanf_s(pFile, "%u//%u", &v, &vn);
-				++numTri;
+const uint32_t* ObjLoader::GetIndices() const
+{
+	return m_cacheFile ? m_pCachedIndices : m_indices.data();
+}
 
-				while (fscanf_s(pFile, "%u//%u", &v, &vn) > 0) ++numTri;
-			}
-			else if (sscanf_s(buffer, "%u/%u/%u", &v, &vt, &vn) == 3) // v/vt/vn
-			{
-				fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn);
-				fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn);
-				++numTri;
+const ObjLoader::AABB& ObjLoader::GetAABB() const
+{
+	return m_aabb;
+}
 
-				while (fscanf_s(pFile, "%u/%u/%u", &v, &vt, &vn) > 0) ++numTri;
+bool ObjLoader::loadCache(const char* pszFilename, uint64_t sourceHash, uint64_t sourceSize, uint32_t options)
+{
+	auto file = make_unique<MappedFile>();
+	if (!file->Open(pszFilename) || file->GetSize() < sizeof(CacheHeader)) return false;
+
+	CacheHeader header;
+	memcpy(&header, file->GetData(), sizeof(CacheHeader));
+	if (header.Magic != CacheMagic || header.Version != CacheVersion) return false;
+	if (header.SourceHash != sourceHash || header.SourceSize != sourceSize || header.Options != options) return false;
+
+	setVertexFormat((header.Attributes & 1) != 0, (header.Attributes & 2) != 0);
+	m_numVertices = header.NumVertices;
+	const auto vertexBytes = m_layout == VertexLayout::SEPARATE ? setStreamOffsets() : static_cast<size_t>(m_stride) * m_numVertices;
+	const auto indexBytes = sizeof(uint32_t) * header.NumIndices;
+	if (header.Stride != m_stride || file->GetSize() != sizeof(CacheHeader) + vertexBytes + indexBytes) return false;
+
+	// Serve the geometry from the mapping rather than copying it out.
+	const auto pData = reinterpret_cast<const uint8_t*>(file->GetData()) + sizeof(CacheHeader);
+	m_pCachedVertices = pData;
+	m_cachedVertexDataSize = vertexBytes;
+	m_pCachedIndices = reinterpret_cast<const uint32_t*>(pData + vertexBytes);
+	m_numCachedIndices = header.NumIndices;
+	m_cacheFile = move(file);
+	m_aabb.Min = float3(header.Min);
+	m_aabb.Max = float3(header.Max);
 
-				//m_hasTexcoord = true;
-			}
-			else if (sscanf_s(buffer, "%u/%u", &v, &vt) == 2) // v/vt
-			{
-				fscanf_s(pFile, "%u/%u", &v, &vt);
-				fscanf_s(pFile, "%u/%u", &v, &vt);
-				++numTri;
+	return true;
+}
 
-				while (fscanf_s(pFile, "%u/%u", &v, &vt) > 0) ++numTri;
+void ObjLoader::releaseGeometry()
+{
+	m_vertices = vector<uint8_t>();
+	m_indices = vector<uint32_t>();
+	m_cacheFile.reset();
+	m_pCachedVertices = nullptr;
+	m_pCachedIndices = nullptr;
+	m_cachedVertexDataSize = 0;
+	m_numCachedIndices = 0;
+	m_numVertices = 0;
+}
 
-				//m_hasTexcoord = true;
-			}
-			else // v
-			{
-				fscanf_s(pFile, "%u", &v);
-				fscanf_s(pFile, "%u", &v);
-				++numTri;
+bool ObjLoader::saveCache(const char* pszFilename, uint64_t sourceHash, uint64_t sourceSize, uint32_t options) const
+{
+	CacheHeader header = {};
+	header.Magic = CacheMagic;
+	header.Version = CacheVersion;
+	header.SourceHash = sourceHash;
+	header.SourceSize = sourceSize;
+	header.Options = options;
+	header.Attributes = (m_attributeOffsets[1] != UINT32_MAX ? 1 : 0) | (m_attributeOffsets[2] != UINT32_MAX ? 2 : 0);
+	header.Stride = m_stride;
+	header.NumVertices = GetNumVertices();
+	header.NumIndices = GetNumIndices();
+	memcpy(header.Min, &m_aabb.Min, sizeof(header.Min));
+	memcpy(header.Max, &m_aabb.Max, sizeof(header.Max));
+
+	ofstream fileStream(pszFilename, ios::out | ios::binary | ios::trunc);
+	if (!fileStream) return false;
+
+	fileStream.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+	fileStream.write(reinterpret_cast<const char*>(m_vertices.data()), m_vertices.size());
+	fileStream.write(reinterpret_cast<const char*>(m_indices.data()), sizeof(uint32_t) * m_indices.size());
+
+	return static_cast<bool>(fileStream);
+}
 
-				while (fscanf_s(pFile, "%u", &v) > 0)
-					++numTri;
-			}
-			break;
+void ObjLoader::parseChunks(Chunk& result, const char* pData, size_t size, uint32_t numChunks) const
+{
+	// Split the file at line boundaries.
+	const auto pEnd = pData + size;
+	vector<const char*> bounds(numChunks + 1);
+	bounds[0] = pData;
+	bounds[numChunks] = pEnd;
+	for (auto i = 1u; i < numChunks; ++i)
+		bounds[i] = (max)(SkipLine(pData + size / numChunks * i, pEnd), bounds[i - 1]);
+
+	vector<Chunk> chunks(numChunks);
+	ForEachOnThread(numChunks, [&](uint32_t i) { parseChunk(chunks[i], bounds[i], bounds[i + 1]); });
+
+	// Prefix sums of the element counts of the chunks
+	struct Offsets
+	{
+		size_t Positions;
+		size_t Texcoords;
+		size_t Normals;
+		size_t Indices;
+	};
+
+	vector<Offsets> offsets(numChunks + 1);
+	offsets[0] = {};
+	for (auto i = 0u; i < numChunks; ++i)
+	{
+		offsets[i + 1].Positions = offsets[i].Positions + chunks[i].Positions.size();
+		offsets[i + 1].Texcoords = offsets[i].Texcoords + chunks[i].Texcoords.size();
+		offsets[i + 1].Normals = offsets[i].Normals + chunks[i].Normals.size();
+		offsets[i + 1].Indices = offsets[i].Indices + chunks[i].VIndices.size();
+	}
 
-		case 'v':   // v, vt, or vn
-			switch (buffer[1])
+	const auto& total = offsets[numChunks];
+	result.Positions.resize(total.Positions);
+	result.Texcoords.resize(total.Texcoords);
+	result.Normals.resize(total.Normals);
+	result.VIndices.resize(total.Indices);
+	result.TIndices.resize(total.Indices);
+	result.NIndices.resize(total.Indices);
+
+	// Stitch the chunks together. Relative indices were resolved against the counts within their
+	// own chunks, so they are rebased by the counts of the preceding chunks; those reaching back
+	// into a preceding chunk wrapped around below 0 and come out right modulo 2^32.
+	ForEachOnThread(numChunks, [&](uint32_t i)
+	{
+		auto& chunk = chunks[i];
+		const auto& offset = offsets[i];
+		copy(chunk.Positions.cbegin(), chunk.Positions.cend(), result.Positions.begin() + offset.Positions);
+		copy(chunk.Texcoords.cbegin(), chunk.Texcoords.cend(), result.Texcoords.begin() + offset.Texcoords);
+		copy(chunk.Normals.cbegin(), chunk.Normals.cend(), result.Normals.begin() + offset.Normals);
+
+		for (const auto j : chunk.RelVIndices) chunk.VIndices[j] += static_cast<uint32_t>(offset.Positions);
+		for (const auto j : chunk.RelTIndices) chunk.TIndices[j] += static_cast<uint32_t>(offset.Texcoords);
+		for (const auto j : chunk.RelNIndices) chunk.NIndices[j] += static_cast<uint32_t>(offset.Normals);
+		copy(chunk.VIndices.cbegin(), chunk.VIndices.cend(), result.VIndices.begin() + offset.Indices);
+		copy(chunk.TIndices.cbegin(), chunk.TIndices.cend(), result.TIndices.begin() + offset.Indices);
+		copy(chunk.NIndices.cbegin(), chunk.NIndices.cend(), result.NIndices.begin() + offset.Indices);
+
+		chunk = Chunk();
+	});
+}
+
+void ObjLoader::parseChunk(Chunk& chunk, const char* p, const char* pEnd, bool withFaces) const
+{
+	while (p < pEnd)
+	{
+		switch (ParseKeyword(p, pEnd))
+		{
+		case Keyword::V:
+		{
+			float3 v;
+			v.x = ParseFloat(p, pEnd);
+			v.y = ParseFloat(p, pEnd);
+			v.z = ParseFloat(p, pEnd);
+			chunk.Positions.emplace_back(v);
+			break;
+		}
+		case Keyword::VT:
+		{
+			float2 vt;
+			vt.x = ParseFloat(p, pEnd);
+			vt.y = ParseFloat(p, pEnd);
+			chunk.Texcoords.emplace_back(vt);
+			break;
+		}
+		case Keyword::VN:
+		{
+			float3 vn;
+			vn.x = ParseFloat(p, pEnd);
+			vn.y = ParseFloat(p, pEnd);
+			vn.z = ParseFloat(p, pEnd);
+			chunk.Normals.emplace_back(vn);
+			break;
+		}
+		case Keyword::F:
+			if (withFaces)
 			{
-			case '\0':
-				fgets(buffer, sizeof(buffer), pFile);
-				++numVert;
-				break;
-			case 't':
-				fgets(buffer, sizeof(buffer), pFile);
-				++numTexc;
-				break;
-			case 'n':
-				fgets(buffer, sizeof(buffer), pFile);
-				++numNorm;
-				break;
-			default:
-				break;
+				const size_t counts[] = { chunk.Positions.size(), chunk.Texcoords.size(), chunk.Normals.size() };
+				p = parseFace(chunk, p, pEnd, counts);
 			}
 			break;
+		default:
+			break;
+		}
+
+		p = SkipLine(p, pEnd);
+	}
+}
 
+const char* ObjLoader::parseFaces(Chunk& chunk, const char* p, const char* pEnd, size_t counts[3], size_t maxIndices) const
+{
+	while (p < pEnd && chunk.VIndices.size() < maxIndices)
+	{
+		switch (ParseKeyword(p, pEnd))
+		{
+		case Keyword::V:
+			++counts[0];
+			break;
+		case Keyword::VT:
+			++counts[1];
+			break;
+		case Keyword::VN:
+			++counts[2];
+			break;
+		case Keyword::F:
+			p = parseFace(chunk, p, pEnd, counts);
+			break;
 		default:
-			fgets(buffer, sizeof(buffer), pFile);
 			break;
 		}
+
+		p = SkipLine(p, pEnd);
 	}
 
-	// Allocate memory for the OBJ model data.
-	const auto numIdx = numTri * 3;
-	m_stride += m_stride <= sizeof(float3) && numNorm ? sizeof(float3) : 0;
-	m_stride += numTexc ? sizeof(float[2]) : 0;
-	m_vertices.reserve(m_stride * (max)((max)(numVert, numTexc), numNorm));
-	m_vertices.resize(m_stride * numVert);
-	m_indices.resize(numIdx);
+	return p;
 }
 
-void ObjLoader::importGeometrySecondPass(FILE* pFile, uint32_t numTexc, uint32_t numNorm, bool forDX, bool swapYZ)
+const char* ObjLoader::parseFace(Chunk& chunk, const char* p, const char* pEnd, const size_t counts[3]) const
 {
-	auto numVert = 0u;
-	auto numTri = 0u;
-	char buffer[256] = { 0 };
+	// v, v/vt, v//vn, or v/vt/vn, fan-triangulated
+	struct FaceVertex
+	{
+		uint32_t Indices[3];
+		bool IsRelative[3];
+	};
 
-	vector<float3> normals;
-	vector<uint32_t> tIndices, nIndices;
-	if (numTexc) tIndices.resize(m_indices.size());
-	if (numNorm) nIndices.resize(m_indices.size());
-	normals.reserve(numNorm);
+	vector<uint32_t>* const indices[] = { &chunk.VIndices, &chunk.TIndices, &chunk.NIndices };
+	vector<uint32_t>* const relIndices[] = { &chunk.RelVIndices, &chunk.RelTIndices, &chunk.RelNIndices };
 
-	while (fscanf_s(pFile, "%s", buffer, static_cast<uint32_t>(sizeof(buffer))) != EOF)
+	FaceVertex first = {}, prev = {};
+	for (auto n = 0u; ; ++n)
 	{
-		switch (buffer[0])
+		int64_t i;
+		p = SkipSpaces(p, pEnd);
+		if (!ParseInt(p, pEnd, i)) break;
+
+		FaceVertex cur = { { UINT32_MAX, UINT32_MAX, UINT32_MAX }, { false, false, false } };
+		cur.Indices[0] = ResolveIndex(i, counts[0], cur.IsRelative[0]);
+		for (uint8_t k = 1; k < 3 && p < pEnd && *p == '/'; ++k)
+			if (ParseInt(++p, pEnd, i)) cur.Indices[k] = ResolveIndex(i, counts[k], cur.IsRelative[k]);
+
+		if (n >= 2)
 		{
-		case 'f': // v, v//vn, v/vt, or v/vt/vn.
-			loadIndices(pFile, numTri, numTexc, numNorm, nIndices, tIndices);
-			break;
-		case 'v': // v, vn, or vt.
-			switch (buffer[1])
-			{
-			case '\0': // v
+			for (const auto& v : { first, prev, cur })
 			{
-				auto& p = getPosition(numVert++);
-				fscanf_s(pFile, "%f %f %f", &p.x, &p.y, &p.z);
-				if (swapYZ)
+				for (uint8_t k = 0; k < 3; ++k)
 				{
-					const auto tmp = p.y;
-					p.y = p.z;
-					p.z = tmp;
+					if (v.IsRelative[k]) relIndices[k]->emplace_back(static_cast<uint32_t>(indices[k]->size()));
+					indices[k]->emplace_back(v.Indices[k]);
 				}
-				p.z = forDX ? -p.z : p.z;
-				break;
 			}
-			case 'n':
-				normals.emplace_back();
-				fscanf_s(pFile, "%f %f %f",
-					&normals.back().x,
-					&normals.back().y,
-					&normals.back().z);
-				if (swapYZ)
-				{
-					const auto tmp = normals.back().y;
-					normals.back().y = normals.back().z;
-					normals.back().z = tmp;
-				}
-				normals.back().z = forDX ? -normals.back().z : normals.back().z;
-			default:
-				break;
-			}
-			break;
-
-		default:
-			fgets(buffer, sizeof(buffer), pFile);
-			break;
 		}
-	}
 
-	computePerVertexNormals(normals, nIndices);
+		if (n == 0) first = cur;
+		prev = cur;
+	}
 
-	if ((forDX && !swapYZ) || (!forDX && swapYZ)) reverse(m_indices.begin(), m_indices.end());
+	return p;
 }
 
-void ObjLoader::loadIndices(FILE* pFile, uint32_t& numTri, uint32_t numTexc,
-	uint32_t numNorm, vector<uint32_t>& nIndices, vector<uint32_t>& tIndices)
+void ObjLoader::loadGeometry(Chunk& chunk, bool needNorm, bool forDX, bool swapYZ)
 {
-	int64_t vi;
-	uint32_t v[3] = { 0 };
-	uint32_t vt[3] = { 0 };
-	uint32_t vn[3] = { 0 };
+	const auto numNorm = chunk.Normals.size();
+	setVertexFormat(needNorm || numNorm, !chunk.Texcoords.empty());
 
-	const auto numVert = GetNumVertices();
+	compactTriangles(chunk);
+	convertAttributes(chunk, forDX, swapYZ);
 
-	for (uint8_t i = 0; i < 3; ++i)
+	if ((forDX && !swapYZ) || (!forDX && swapYZ))
 	{
-		fscanf_s(pFile, "%lld", &vi);
-		v[i] = static_cast<uint32_t>(vi < 0 ? vi + numVert : vi - 1);
-		m_indices[numTri * 3 + i] = v[i];
+		reverse(chunk.VIndices.begin(), chunk.VIndices.end());
+		reverse(chunk.TIndices.begin(), chunk.TIndices.end());
+		reverse(chunk.NIndices.begin(), chunk.NIndices.end());
+	}
 
-		if (tIndices.size() > 0)
-		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vt[i] = static_cast<uint32_t>(vi < 0 ? vi + numTexc : vi - 1);
-			tIndices[numTri * 3 + i] = vt[i];
-		}
-		else if (nIndices.size() > 0) fscanf_s(pFile, "/");
+	if (needNorm && !numNorm) recomputeNormals(chunk);
+	indexVertices(chunk);
+}
 
-		if (nIndices.size() > 0)
-		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vn[i] = static_cast<uint32_t>(vi < 0 ? vi + numNorm : vi - 1);
-			nIndices[numTri * 3 + i] = vn[i];
-		}
+void ObjLoader::setVertexFormat(bool hasNormal, bool hasTexcoord)
+{
+	m_stride = sizeof(float3);
+	m_attributeOffsets[0] = 0;
+	m_attributeOffsets[1] = hasNormal ? m_stride : UINT32_MAX;
+	m_stride += hasNormal ? sizeof(float3) : 0;
+	m_attributeOffsets[2] = hasTexcoord ? m_stride : UINT32_MAX;
+	m_stride += hasTexcoord ? sizeof(float2) : 0;
+}
+
+size_t ObjLoader::setStreamOffsets()
+{
+	// The streams follow one another at aligned offsets in the same buffer.
+	auto size = static_cast<size_t>(0);
+	for (uint8_t i = 0; i < static_cast<uint8_t>(VertexAttribute::COUNT); ++i)
+	{
+		if (m_attributeOffsets[i] == UINT32_MAX) continue;
+		m_streamOffsets[i] = size;
+		size += (static_cast<size_t>(AttributeSizes[i]) * m_numVertices + StreamAlignment - 1) & ~(StreamAlignment - 1);
 	}
-	++numTri;
 
-	v[1] = v[2];
-	vt[1] = vt[2];
-	vn[1] = vn[2];
+	return size;
+}
 
-	while (fscanf_s(pFile, "%lld", &vi) > 0)
+void ObjLoader::separateStreams()
+{
+	vector<uint8_t> streams(setStreamOffsets());
+	ForEachRange(m_numVertices, m_numThreads, [&](uint32_t, uint32_t begin, uint32_t end)
 	{
-		v[2] = static_cast<uint32_t>(vi < 0 ? vi + numVert : vi - 1);
-		m_indices[numTri * 3] = v[0];
-		m_indices[numTri * 3 + 1] = v[1];
-		m_indices[numTri * 3 + 2] = v[2];
-		v[1] = v[2];
-
-		if (tIndices.size() > 0)
+		for (uint8_t k = 0; k < static_cast<uint8_t>(VertexAttribute::COUNT); ++k)
 		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vt[2] = static_cast<uint32_t>(vi < 0 ? vi + numTexc : vi - 1);
-			tIndices[numTri * 3] = vt[0];
-			tIndices[numTri * 3 + 1] = vt[1];
-			tIndices[numTri * 3 + 2] = vt[2];
-			vt[1] = vt[2];
+			if (m_attributeOffsets[k] == UINT32_MAX) continue;
+			const auto attributeSize = AttributeSizes[k];
+			for (auto i = begin; i < end; ++i)
+				memcpy(&streams[m_streamOffsets[k] + static_cast<size_t>(attributeSize) * i],
+					&m_vertices[static_cast<size_t>(m_stride) * i + m_attributeOffsets[k]], attributeSize);
 		}
-		else if (nIndices.size() > 0) fscanf_s(pFile, "/");
+	});
+
+	m_vertices = move(streams);
+}
+
+void ObjLoader::compactTriangles(Chunk& chunk) const
+{
+	const auto numVert = static_cast<uint32_t>(chunk.Positions.size());
 
-		if (nIndices.size() > 0)
+	// Drop the triangles with missing or out-of-range positions.
+	auto numIdx = 0u;
+	for (size_t i = 0; i + 2 < chunk.VIndices.size(); i += 3)
+	{
+		if (chunk.VIndices[i] >= numVert || chunk.VIndices[i + 1] >= numVert || chunk.VIndices[i + 2] >= numVert) continue;
+
+		for (uint8_t k = 0; k < 3; ++k)
 		{
-			fscanf_s(pFile, "/%lld", &vi);
-			vn[2] = static_cast<uint32_t>(vi < 0 ? vi + numNorm : vi - 1);
-			nIndices[numTri * 3] = vn[0];
-			nIndices[numTri * 3 + 1] = vn[1];
-			nIndices[numTri * 3 + 2] = vn[2];
-			vn[1] = vn[2];
+			chunk.VIndices[numIdx + k] = chunk.VIndices[i + k];
+			chunk.TIndices[numIdx + k] = chunk.TIndices[i + k];
+			chunk.NIndices[numIdx + k] = chunk.NIndices[i + k];
 		}
-
-		++numTri;
+		numIdx += 3;
 	}
+	chunk.VIndices.resize(numIdx);
+	chunk.TIndices.resize(chunk.Texcoords.empty() ? 0 : numIdx);
+	chunk.NIndices.resize(chunk.Normals.empty() ? 0 : numIdx);
 }
 
-void ObjLoader::computePerVertexNormals(const vector<float3>& normals, const vector<uint32_t>& nIndices)
+void ObjLoader::convertAttributes(Chunk& chunk, bool forDX, bool swapYZ) const
 {
-	if (normals.empty()) return;
+	const auto convert = [forDX, swapYZ](float3& v)
+	{
+		if (swapYZ) swap(v.y, v.z);
+		v.z = forDX ? -v.z : v.z;
+	};
 
-	const auto stride = GetVertexStride();
-	vector<uint32_t> vni(GetNumVertices(), UINT32_MAX);
+	for (auto& p : chunk.Positions) convert(p);
+	for (auto& n : chunk.Normals) convert(n);
+}
 
-	const auto numIdx = static_cast<uint32_t>(m_indices.size());
-	for (auto i = 0u; i < numIdx; i++)
+void ObjLoader::indexVertices(const Chunk& chunk)
+{
+	// Position, texcoord and normal indices of a vertex, UINT32_MAX if absent
+	struct Key
+	{
+		uint32_t V;
+		uint32_t T;
+		uint32_t N;
+	};
+
+	const auto numIdx = static_cast<uint32_t>(chunk.VIndices.size());
+	const auto numTexc = chunk.TIndices.empty() ? 0 : chunk.Texcoords.size();
+	const auto numNorm = chunk.NIndices.empty() ? 0 : chunk.Normals.size();
+
+	// Open-addressing hash table of the unique keys with linear probing, at most half full
+	size_t capacity = 1;
+	while (capacity < static_cast<size_t>(numIdx) * 2) capacity <<= 1;
+	const auto mask = capacity - 1;
+	vector<uint32_t> table(capacity, UINT32_MAX);
+
+	vector<Key> keys;
+	keys.reserve((min)(chunk.Positions.size(), static_cast<size_t>(numIdx)));
+	m_indices.resize(numIdx);
+	for (auto i = 0u; i < numIdx; ++i)
 	{
-		auto vi = m_indices[i];
-		if (vni[vi] == nIndices[i]) continue;
+		Key key = { chunk.VIndices[i], UINT32_MAX, UINT32_MAX };
+		if (numTexc && chunk.TIndices[i] < numTexc) key.T = chunk.TIndices[i];
+		if (numNorm && chunk.NIndices[i] < numNorm) key.N = chunk.NIndices[i];
 
-		if (vni[vi] < UINT32_MAX)
+		auto slot = HashVertex(key.V, key.T, key.N) & mask;
+		for (; table[slot] != UINT32_MAX; slot = (slot + 1) & mask)
 		{
-			// Split vertex
-			vi = GetNumVertices();
-			m_vertices.resize(m_vertices.size() + stride);
-			const auto pDst = getVertex(vi);
-			const auto pSrc = getVertex(m_indices[i]);
-			memcpy(pDst, pSrc, stride);
-			m_indices[i] = vi;
+			const auto& k = keys[table[slot]];
+			if (k.V == key.V && k.T == key.T && k.N == key.N) break;
 		}
-		else vni[vi] = nIndices[i];
 
-		float3 n = normals[nIndices[i]];
-		const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
-		n.x /= l;
-		n.y /= l;
-		n.z /= l;
+		if (table[slot] == UINT32_MAX)
+		{
+			table[slot] = static_cast<uint32_t>(keys.size());
+			keys.emplace_back(key);
+		}
 
-		getNormal(vi) = n;
+		m_indices[i] = table[slot];
 	}
 
-	m_vertices.shrink_to_fit();
-}
-
-void ObjLoader::recomputeNormals()
-{
-	float3 e1, e2, n;
-
-	const auto numTri = static_cast<uint32_t>(m_indices.size()) / 3;
-	for (auto i = 0u; i < numTri; i++)
-	{
-		const auto pv0 = &getPosition(m_indices[i * 3]);
-		const auto pv1 = &getPosition(m_indices[i * 3 + 1]);
-		const auto pv2 = &getPosition(m_indices[i * 3 + 2]);
-		e1.x = pv1->x - pv0->x;
-		e1.y = pv1->y - pv0->y;
-		e1.z = pv1->z - pv0->z;
-		e2.x = pv2->x - pv1->x;
-		e2.y = pv2->y - pv1->y;
-		e2.z = pv2->z - pv1->z;
-		n.x = e1.y * e2.z - e1.z * e2.y;
-		n.y = e1.z * e2.x - e1.x * e2.z;
-		n.z = e1.x * e2.y - e1.y * e2.x;
-		const auto l = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
-		n.x /= l;
-		n.y /= l;
-		n.z /= l;
-
-		const auto pVn0 = &getNormal(m_indices[i * 3]);
-		const auto pVn1 = &getNormal(m_indices[i * 3 + 1]);
-		const auto pVn2 = &getNormal(m_indices[i * 3 + 2]);
-		pVn0->x += n.x;
-		pVn0->y += n.y;
-		pVn0->z += n.z;
-		pVn1->x += n.x;
-		pVn1->y += n.y;
-		pVn1->z += n.z;
-		pVn2->x += n.x;
-		pVn2->y += n.y;
-		pVn2->z += n.z;
-	}
+	// Gather the attributes of the unique vertices.
+	const auto numVert = static_cast<uint32_t>(keys.size());
+	m_vertices.assign(static_cast<size_t>(m_stride) * numVert, 0);
+	m_numVertices = numVert;
+	ForEachRange(numVert, m_numThreads, [&](uint32_t, uint32_t begin, uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto& key = keys[i];
+			getPosition(i) = chunk.Positions[key.V];
+			if (key.T != UINT32_MAX) getTexcoord(i) = chunk.Texcoords[key.T];
+			if (key.N != UINT32_MAX) XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&getNormal(i)),
+				XMVector3Normalize(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&chunk.Normals[key.N]))));
+		}
+	});
+}
 
-	const auto numVert = GetNumVertices();
-	for (auto i = 0u; i < numVert; ++i)
+void ObjLoader::recomputeNormals(Chunk& chunk) const
+{
+	// Face normals are summed per position rather than per vertex, so that the normals stay
+	// smooth across texture seams; indexVertices() normalizes them.
+	const auto& positions = chunk.Positions;
+	const auto& indices = chunk.VIndices;
+	const auto numVert = static_cast<uint32_t>(positions.size());
+	const auto numIdx = static_cast<uint32_t>(indices.size());
+	const auto numTri = numIdx / 3;
+
+	vector<XMFLOAT3> faceNormals(numTri);
+	ForEachRange(numTri, m_numThreads, [&](uint32_t, uint32_t begin, uint32_t end)
 	{
-		const auto pVn = &getNormal(i);
-		const auto l = sqrt(pVn->x * pVn->x + pVn->y * pVn->y + pVn->z * pVn->z);
-		pVn->x /= l;
-		pVn->y /= l;
-		pVn->z /= l;
+		for (auto i = begin; i < end; ++i)
+			XMStoreFloat3(&faceNormals[i], FaceNormal(positions.data(), &indices[i * 3]));
+	});
+
+	// Gather the face normals around each position through a CSR adjacency in triangle order,
+	// which keeps the sums free of write conflicts and independent of the thread count.
+	vector<uint32_t> adjOffsets(numVert + 1, 0);
+	for (const auto i : indices) ++adjOffsets[i + 1];
+	partial_sum(adjOffsets.cbegin(), adjOffsets.cend(), adjOffsets.begin());
+
+	vector<uint32_t> adjTris(numIdx);
+	{
+		vector<uint32_t> cursors(adjOffsets.cbegin(), adjOffsets.cend() - 1);
+		for (auto i = 0u; i < numIdx; ++i) adjTris[cursors[indices[i]]++] = i / 3;
 	}
+
+	chunk.Normals.resize(numVert);
+	ForEachRange(numVert, m_numThreads, [&](uint32_t, uint32_t begin, uint32_t end)
+	{
+		for (auto i = begin; i < end; ++i)
+		{
+			auto n = XMVectorZero();
+			for (auto j = adjOffsets[i]; j < adjOffsets[i + 1]; ++j) n += XMLoadFloat3(&faceNormals[adjTris[j]]);
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&chunk.Normals[i]), n);
+		}
+	});
+	chunk.NIndices = chunk.VIndices;
 }
 
 void ObjLoader::computeAABB()
 {
-	float xMax, xMin, yMax, yMin, zMax, zMin;
-	const auto& p = getPosition(0);
-	xMax = xMin = p.x;
-	yMax = yMin = p.y;
-	zMax = zMin = p.z;
-
-	auto x = 0.0f, y = 0.0f, z = 0.0f;
-
+	// Per-range bounds, reduced in range order
 	const auto numVert = GetNumVertices();
-	for (auto i = 1u; i < numVert; ++i)
+	const auto numRanges = (min)(m_numThreads, (numVert + MinRangeSize - 1) / MinRangeSize);
+	vector<XMFLOAT3> mins(numRanges), maxs(numRanges);
+	ForEachRange(numVert, m_numThreads, [&](uint32_t range, uint32_t begin, uint32_t end)
 	{
-		const auto& p = getPosition(i);
-		x = p.x;
-		y = p.y;
-		z = p.z;
-
-		if (x < xMin) xMin = x;
-		else if (x > xMax) xMax = x;
+		auto vMin = XMVectorReplicate(FLT_MAX);
+		auto vMax = XMVectorReplicate(-FLT_MAX);
+		for (auto i = begin; i < end; ++i)
+		{
+			const auto pos = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&getPosition(i)));
+			vMin = XMVectorMin(vMin, pos);
+			vMax = XMVectorMax(vMax, pos);
+		}
 
-		if (y < yMin) yMin = y;
-		else if (y > yMax) yMax = y;
+		XMStoreFloat3(&mins[range], vMin);
+		XMStoreFloat3(&maxs[range], vMax);
+	});
 
-		if (z < zMin) zMin = z;
-		else if (z > zMax) zMax = z;
+	auto vMin = XMVectorReplicate(FLT_MAX);
+	auto vMax = XMVectorReplicate(-FLT_MAX);
+	for (auto i = 0u; i < numRanges; ++i)
+	{
+		vMin = XMVectorMin(vMin, XMLoadFloat3(&mins[i]));
+		vMax = XMVectorMax(vMax, XMLoadFloat3(&maxs[i]));
 	}
 
-	m_aabb.Min = float3(xMin, yMin, zMin);
-	m_aabb.Max = float3(xMax, yMax, zMax);
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&m_aabb.Min), vMin);
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&m_aabb.Max), vMax);
 }
 
 void* ObjLoader::getVertex(uint32_t i)
@@ -429,3 +971,8 @@ ObjLoader::float3& ObjLoader::getNormal(uint32_t i)
 {
 	return reinterpret_cast<float3*>(getVertex(i))[1];
 }
+
+ObjLoader::float2& ObjLoader::getTexcoord(uint32_t i)
+{
+	return *reinterpret_cast<float2*>(&m_vertices[GetVertexStride() * i + m_attributeOffsets[2]]);
+}
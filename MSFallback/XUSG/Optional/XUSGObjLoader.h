@@ -28,11 +28,54 @@ namespace XUSG
 			float3 Max;
 		};
 
-		ObjLoader();
+		enum class VertexLayout : uint8_t
+		{
+			INTERLEAVED,	// Position, normal (if any) and texcoord (if any) per vertex
+			SEPARATE		// A tightly packed stream per attribute, at 16-byte aligned offsets
+		};
+
+		enum class VertexAttribute : uint8_t
+		{
+			POSITION,
+			NORMAL,
+			TEXCOORD,
+
+			COUNT
+		};
+
+		struct VertexStream
+		{
+			const uint8_t* pData;	// nullptr if the attribute is absent
+			size_t Offset;			// Byte offset in GetVertices()
+			uint32_t Stride;
+		};
+
+		ObjLoader(VertexLayout layout = VertexLayout::INTERLEAVED);
 		virtual ~ObjLoader();
 
-		bool Import(const char* pszFilename, bool needNorm = true,
-			bool needAABB = true, bool forDX = true, bool swapYZ = false);
+		// Vertices are the unique position/texcoord/normal index combinations of the face corners,
+		// laid out as specified by the VertexLayout of the loader.
+		// Large files are split at line boundaries and parsed on up to numThreads threads
+		// (0 for all cores); the result is the same as that of a serial import.
+		// If a cache file is given, the processed geometry and AABB are written to it, and later
+		// imports of the same content with the same options map it instead of parsing the text.
+		// The vertices and indices are then served from the mapping, which the loader holds
+		// until the next import or its destruction.
+		bool Import(const char* pszFilename, bool needNorm = true, bool needAABB = true,
+			bool forDX = true, bool swapYZ = false, uint32_t numThreads = 1,
+			const char* pszCacheFilename = nullptr);
+
+		// Receives a block of vertices and triangle indices; returns false to stop the import.
+		using BlockCallback = std::function<bool(const uint8_t* pVertices, uint32_t numVertices,
+			const uint32_t* pIndices, uint32_t numIndices)>;
+
+		// Streams the faces in blocks of about blockTriCount triangles (a polygon is never split),
+		// each with its own vertices in the layout of Import(), so that GetVertexStream() also
+		// applies to the vertices passed to the callback. Only the OBJ attributes stay
+		// resident besides the current block. Generated normals take an extra pass over the faces.
+		// No AABB is computed, and the loader holds no geometry afterwards.
+		bool ImportStreamed(const char* pszFilename, uint32_t blockTriCount, const BlockCallback& callback,
+			bool needNorm = true, bool forDX = true, bool swapYZ = false);
 
 		const uint32_t GetNumVertices() const;
 		const uint32_t GetNumIndices() const;
@@ -40,26 +83,84 @@ namespace XUSG
 		const uint8_t* GetVertices() const;
 		const uint32_t* GetIndices() const;
 
+		// The vertex data is a single buffer in either layout, so it can be uploaded at once and
+		// bound per attribute with the offsets and strides of the streams. GetVertexStride()
+		// is the size of all attributes of a vertex.
+		const size_t GetVertexDataSize() const;
+		VertexStream GetVertexStream(VertexAttribute attribute) const;
+
+		// Copies an attribute of all the vertices with the given destination stride,
+		// e.g. into a mapped upload buffer of any layout.
+		bool CopyVertexAttribute(VertexAttribute attribute, void* pDst, uint32_t dstStride) const;
+
 		const AABB& GetAABB() const;
 
 	protected:
-		void importGeometryFirstPass(FILE* pFile, uint32_t& numTexc, uint32_t& numNorm);
-		void importGeometrySecondPass(FILE* pFile, uint32_t numTexc, uint32_t numNorm, bool forDX, bool swapYZ);
-		void loadIndices(FILE* pFile, uint32_t& numTri, uint32_t numTexc, uint32_t numNorm,
-			std::vector<uint32_t>& nIndices, std::vector<uint32_t>& tIndices);
-		void computePerVertexNormals(const std::vector<float3>& normals, const std::vector<uint32_t>& nIndices);
-		void recomputeNormals();
+		class MappedFile;
+
+		struct float2
+		{
+			float x;
+			float y;
+		};
+
+		// Geometry parsed from a range of lines, with faces fan-triangulated into 0-based indices.
+		// Relative (negative) OBJ indices are resolved against the counts within the chunk, and
+		// their locations are kept in the Rel*Indices lists for rebasing onto preceding chunks.
+		struct Chunk
+		{
+			std::vector<float3>		Positions;
+			std::vector<float2>		Texcoords;
+			std::vector<float3>		Normals;
+			std::vector<uint32_t>	VIndices;
+			std::vector<uint32_t>	TIndices;	// UINT32_MAX if absent
+			std::vector<uint32_t>	NIndices;	// UINT32_MAX if absent
+			std::vector<uint32_t>	RelVIndices;
+			std::vector<uint32_t>	RelTIndices;
+			std::vector<uint32_t>	RelNIndices;
+		};
+
+		bool loadCache(const char* pszFilename, uint64_t sourceHash, uint64_t sourceSize, uint32_t options);
+		void releaseGeometry();
+		bool saveCache(const char* pszFilename, uint64_t sourceHash, uint64_t sourceSize, uint32_t options) const;
+		void parseChunks(Chunk& result, const char* pData, size_t size, uint32_t numChunks) const;
+		void parseChunk(Chunk& chunk, const char* p, const char* pEnd, bool withFaces = true) const;
+		const char* parseFaces(Chunk& chunk, const char* p, const char* pEnd, size_t counts[3], size_t maxIndices) const;
+		const char* parseFace(Chunk& chunk, const char* p, const char* pEnd, const size_t counts[3]) const;
+		void loadGeometry(Chunk& chunk, bool needNorm, bool forDX, bool swapYZ);
+		void setVertexFormat(bool hasNormal, bool hasTexcoord);
+		size_t setStreamOffsets();
+		void separateStreams();
+		void compactTriangles(Chunk& chunk) const;
+		void convertAttributes(Chunk& chunk, bool forDX, bool swapYZ) const;
+		void indexVertices(const Chunk& chunk);
+		void recomputeNormals(Chunk& chunk) const;
 		void computeAABB();
 
 		void* getVertex(uint32_t i);
 		float3& getPosition(uint32_t i);
 		float3& getNormal(uint32_t i);
+		float2& getTexcoord(uint32_t i);
 
 		std::vector<uint8_t>	m_vertices;
 		std::vector<uint32_t>	m_indices;
 
+		// Geometry of an import served from the mapped cache file instead of the vectors above
+		std::unique_ptr<MappedFile> m_cacheFile;
+		const uint8_t*			m_pCachedVertices;
+		const uint32_t*			m_pCachedIndices;
+		size_t					m_cachedVertexDataSize;
+		uint32_t				m_numCachedIndices;
+
+		VertexLayout m_layout;
+
+		uint32_t	m_numVertices;
 		uint32_t	m_stride;
+		uint32_t	m_attributeOffsets[static_cast<uint8_t>(VertexAttribute::COUNT)];	// UINT32_MAX if absent
+		size_t		m_streamOffsets[static_cast<uint8_t>(VertexAttribute::COUNT)];
 
 		AABB		m_aabb;
+
+		uint32_t	m_numThreads;
 	};
 }
@@ -0,0 +1,699 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Optional/XUSGObjLoader.h"
+#include "ClusterLodBuilder.h"
+#include "CullDataGenerator.h"
+#include "Meshletizer.h"
+#include "MeshletCuller.h"
+#include "MeshletSort.h"
+#include "MeshSimplifier.h"
+#include "PrimitivePacker.h"
+#include "VertexQuantizer.h"
+#include "SharedConst.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	void PrintUsage()
+	{
+		wcout << L"Usage: MeshletBuilder <input.obj> <output.bin> [options]" << endl;
+		wcout << L"  -verts <n>     Max vertices per meshlet (default " << MAX_VERTS << L")" << endl;
+		wcout << L"  -prims <n>     Max primitives per meshlet (default " << MAX_PRIMS << L")" << endl;
+		wcout << L"  -threads <n>   Worker threads, 0 for all cores (default 0)" << endl;
+		wcout << L"  -lods <n>      Also write n coarser LODs as <output>_LOD1.bin... (default 0)" << endl;
+		wcout << L"  -lodratio <r>  Triangle ratio between successive LODs (default 0.5)" << endl;
+		wcout << L"  -clusterlods <n> Build up to n cluster LOD levels per region into the output for the AS to select" << endl;
+		wcout << L"  -lodselect <n> Check the cluster LOD selection over n views at three viewport heights" << endl;
+		wcout << L"  -cullbench <n> Regenerate the cull data n times and report the throughput" << endl;
+		wcout << L"  -batchstats <n> Report AS batch culling over n views before and after sorting" << endl;
+		wcout << L"  -soabench <n>  Compare AoS and SoA CPU culling of the meshlets over n views" << endl;
+		wcout << L"  -cpucull <n>   Check the multithreaded CPU culler against the scalar test over n views" << endl;
+		wcout << L"  -quantstats    Report the errors of the quantized vertex formats" << endl;
+		wcout << L"  -primstats     Verify and report the sizes of the packed primitive encodings" << endl;
+		wcout << L"  -cache         Cache the imported geometry as <input>.cache for later runs" << endl;
+		wcout << L"  -swapyz        Swap the Y and Z axes of the input" << endl;
+		wcout << L"  -rh            Keep the right-handed coordinates of the input" << endl;
+	}
+
+	struct BatchStats
+	{
+		uint64_t Batches;
+		uint64_t CulledBatches;
+		uint64_t MixedBatches;
+		uint64_t Meshlets;
+		uint64_t CulledMeshlets;
+	};
+
+	double Elapsed(chrono::steady_clock::time_point& start)
+	{
+		const auto now = chrono::steady_clock::now();
+		const auto seconds = chrono::duration<double>(now - start).count();
+		start = now;
+
+		return seconds;
+	}
+
+	// Center and radius of the bounding spheres of all meshlets
+	void GetCullBounds(XMVECTOR& center, float& radius, const MeshData& mesh)
+	{
+		center = XMVectorZero();
+		for (const auto& cullData : mesh.CullingData) center += XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&cullData.BoundingSphere));
+		center /= static_cast<float>(mesh.CullingData.size());
+
+		radius = 0.0f;
+		for (const auto& cullData : mesh.CullingData)
+			radius = (max)(XMVectorGetX(XMVector3Length(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&cullData.BoundingSphere)) - center))
+				+ cullData.BoundingSphere.w, radius);
+	}
+
+	// Frustum planes of the v-th of viewCount views orbiting the bounds at distance bounding radii.
+	// The narrow field of view makes both the frustum and the normal-cone tests reject meshlets.
+	void GetOrbitView(XMVECTOR planes[6], XMVECTOR& eyePt, FXMVECTOR center, float radius,
+		uint32_t v, uint32_t viewCount, float distance = 2.0f)
+	{
+		// Fibonacci sphere of view directions
+		const auto y = 1.0f - 2.0f * (v + 0.5f) / viewCount;
+		const auto r = sqrtf(1.0f - y * y);
+		const auto phi = 2.39996323f * v;
+		eyePt = center + XMVectorSet(cosf(phi) * r, y, sinf(phi) * r, 0.0f) * radius * distance;
+		const auto up = fabsf(y) > 0.99f ? g_XMIdentityR0.v : g_XMIdentityR1.v;
+		const auto viewProj = XMMatrixLookAtRH(eyePt, center, up) * XMMatrixPerspectiveFovRH(XM_PI / 8.0f, 1.0f, radius * 0.01f, radius * (distance + 2.0f));
+
+		const auto vp = XMMatrixTranspose(viewProj);
+		planes[0] = XMPlaneNormalize(vp.r[3] + vp.r[0]);
+		planes[1] = XMPlaneNormalize(vp.r[3] - vp.r[0]);
+		planes[2] = XMPlaneNormalize(vp.r[3] + vp.r[1]);
+		planes[3] = XMPlaneNormalize(vp.r[3] - vp.r[1]);
+		planes[4] = XMPlaneNormalize(vp.r[2]);
+		planes[5] = XMPlaneNormalize(vp.r[3] - vp.r[2]);
+	}
+
+	// Cull view of the v-th of viewCount views orbiting the bounds, with an identity world transform
+	void GetOrbitView(CullView& view, FXMVECTOR center, float radius, uint32_t v, uint32_t viewCount)
+	{
+		XMVECTOR planes[6], eyePt;
+		GetOrbitView(planes, eyePt, center, radius, v, viewCount);
+
+		XMStoreFloat4x4(&view.World, XMMatrixIdentity());
+		view.Scale = 1.0f;
+		for (uint8_t i = 0; i < 6; ++i) XMStoreFloat4(&view.Planes[i], planes[i]);
+		XMStoreFloat3(&view.ViewPosition, eyePt);
+		view.Flags = CULL_FLAG;
+	}
+
+	// Counts how AS batches of AS_GROUP_SIZE meshlets are culled from views orbiting the mesh.
+	BatchStats ComputeBatchStats(const MeshData& mesh, uint32_t viewCount)
+	{
+		BatchStats stats = {};
+		const auto meshletCount = static_cast<uint32_t>(mesh.Meshlets.size());
+		if (meshletCount == 0) return stats;
+
+		XMVECTOR center;
+		float radius;
+		GetCullBounds(center, radius, mesh);
+
+		for (auto v = 0u; v < viewCount; ++v)
+		{
+			CullView view;
+			GetOrbitView(view, center, radius, v, viewCount);
+
+			for (auto i = 0u; i < meshletCount; i += AS_GROUP_SIZE)
+			{
+				const auto batchSize = (min)(meshletCount - i, static_cast<uint32_t>(AS_GROUP_SIZE));
+				auto culled = 0u;
+				for (auto j = 0u; j < batchSize; ++j) culled += IsMeshletVisible(mesh.CullingData[i + j], view) ? 0 : 1;
+
+				++stats.Batches;
+				stats.CulledBatches += culled == batchSize ? 1 : 0;
+				stats.MixedBatches += culled > 0 && culled < batchSize ? 1 : 0;
+				stats.Meshlets += batchSize;
+				stats.CulledMeshlets += culled;
+			}
+		}
+
+		return stats;
+	}
+
+	// Culls the meshlets from orbiting views with the scalar test on CullData and with the
+	// SoA kernel, and reports both throughputs. Returns the number of views on which they disagree.
+	uint32_t RunSoACullBenchmark(const MeshData& mesh, uint32_t viewCount)
+	{
+		const auto meshletCount = static_cast<uint32_t>(mesh.CullingData.size());
+		CullDataSoA cullDataSoA;
+		ConvertCullData(cullDataSoA, mesh.CullingData.data(), meshletCount);
+
+		XMVECTOR center;
+		float radius;
+		GetCullBounds(center, radius, mesh);
+
+		vector<CullView> views(viewCount);
+		for (auto v = 0u; v < viewCount; ++v) GetOrbitView(views[v], center, radius, v, viewCount);
+
+		vector<uint32_t> visibleAoS(meshletCount), visibleSoA(meshletCount);
+		auto timeAoS = 0.0, timeSoA = 0.0;
+		auto mismatches = 0u;
+		for (const auto& view : views)
+		{
+			auto start = chrono::steady_clock::now();
+			auto countAoS = 0u;
+			for (auto i = 0u; i < meshletCount; ++i)
+				if (IsMeshletVisible(mesh.CullingData[i], view)) visibleAoS[countAoS++] = i;
+			timeAoS += Elapsed(start);
+
+			const auto countSoA = CullMeshlets(visibleSoA.data(), cullDataSoA, 0, meshletCount, view);
+			timeSoA += Elapsed(start);
+
+			mismatches += countAoS == countSoA && equal(visibleAoS.cbegin(), visibleAoS.cbegin() + countAoS, visibleSoA.cbegin()) ? 0 : 1;
+		}
+
+		const auto meshletsTested = static_cast<double>(meshletCount) * viewCount;
+		wcout << L"AoS cull: " << meshletsTested / timeAoS / 1.0e6 << L" M meshlets/s, SoA cull: "
+			<< meshletsTested / timeSoA / 1.0e6 << L" M meshlets/s (" << timeAoS / timeSoA << L"x)";
+		if (mismatches > 0) wcout << L", " << mismatches << L" views mismatch";
+		wcout << endl;
+
+		return mismatches;
+	}
+
+	// Culls the meshlets of instances with varying transforms from orbiting views with the
+	// multithreaded MeshletCuller, and checks its DispatchArgs bit for bit against the scalar
+	// per-meshlet test. Every 8th view runs without CULL_FLAG. Returns the number of mismatching batches.
+	uint32_t RunCpuCullCheck(const MeshData& mesh, uint32_t viewCount, uint32_t numThreads)
+	{
+		const auto meshletCount = static_cast<uint32_t>(mesh.CullingData.size());
+		CullDataSoA cullDataSoA;
+		ConvertCullData(cullDataSoA, mesh.CullingData.data(), meshletCount);
+
+		XMVECTOR center;
+		float radius;
+		GetCullBounds(center, radius, mesh);
+
+		const MeshletCuller culler(numThreads);
+		const auto batchCount = MeshletCuller::GetBatchCount(meshletCount);
+		vector<DispatchArgs> dispatchArgs(batchCount), referenceArgs(batchCount);
+		auto timeReference = 0.0, timeCuller = 0.0;
+		auto mismatches = 0u;
+		for (auto v = 0u; v < viewCount; ++v)
+		{
+			CullView view;
+			view.Scale = 0.5f + 0.5f * (v % 4);
+			const auto world = XMMatrixAffineTransformation(XMVectorReplicate(view.Scale), center,
+				XMQuaternionRotationRollPitchYaw(0.3f * v, 0.7f * v, 1.1f * v), XMVectorSet(1.0f, -2.0f, 3.0f, 0.0f) * radius);
+			XMStoreFloat4x4(&view.World, world);
+			view.Flags = v % 8 == 7 ? 0 : CULL_FLAG;
+
+			XMVECTOR planes[6], eyePt;
+			GetOrbitView(planes, eyePt, XMVector3Transform(center, world), radius * view.Scale, v, viewCount);
+			for (uint8_t i = 0; i < 6; ++i) XMStoreFloat4(&view.Planes[i], planes[i]);
+			XMStoreFloat3(&view.ViewPosition, eyePt);
+
+			auto start = chrono::steady_clock::now();
+			for (auto i = 0u; i < batchCount; ++i)
+			{
+				auto& args = referenceArgs[i];
+				auto visibleCount = 0u;
+				const auto end = (min)(AS_GROUP_SIZE * (i + 1), meshletCount);
+				for (auto j = AS_GROUP_SIZE * i; j < end; ++j)
+					if (IsMeshletVisible(mesh.CullingData[j], view)) args.ASDispatchArgs.MeshletIndices[visibleCount++] = j;
+				MeshletCuller::SetDispatchArgs(args, i, visibleCount);
+			}
+			timeReference += Elapsed(start);
+
+			culler.Cull(dispatchArgs.data(), cullDataSoA, view);
+			timeCuller += Elapsed(start);
+
+			for (auto i = 0u; i < batchCount; ++i)
+			{
+				const auto size = offsetof(DispatchArgs, ASDispatchArgs.MeshletIndices) + sizeof(uint32_t) * referenceArgs[i].ASDispatchArgs.x;
+				mismatches += memcmp(&dispatchArgs[i], &referenceArgs[i], size) == 0 ? 0 : 1;
+			}
+		}
+
+		const auto meshletsTested = static_cast<double>(meshletCount) * viewCount;
+		wcout << L"CPU cull: " << meshletsTested / timeCuller / 1.0e6 << L" M meshlets/s (scalar reference "
+			<< meshletsTested / timeReference / 1.0e6 << L" M meshlets/s), " << mismatches
+			<< L" of " << static_cast<uint64_t>(batchCount) * viewCount << L" batches mismatch" << endl;
+
+		return mismatches;
+	}
+
+	// Selects the cluster LODs as the AS does, from views at 1 to 64 bounding radii around the mesh,
+	// and checks that every region is drawn at exactly one level. The triangle counts per view
+	// should grow with the viewport height rather than with the triangle count of the asset.
+	// Returns the number of regions not drawn exactly once.
+	uint32_t RunLodSelectCheck(const MeshData& mesh, uint32_t viewCount)
+	{
+		XMVECTOR center;
+		float radius;
+		GetCullBounds(center, radius, mesh);
+
+		const auto subsetCount = static_cast<uint32_t>(mesh.MeshletSubsets.size());
+		vector<uint32_t> subsetTriCounts(subsetCount);
+		for (auto s = 0u; s < subsetCount; ++s)
+		{
+			const auto& subset = mesh.MeshletSubsets[s];
+			for (auto i = subset.Offset; i < subset.Offset + subset.Count; ++i) subsetTriCounts[s] += mesh.Meshlets[i].PrimCount;
+		}
+
+		const auto projScale = 1.0f / tanf(XM_PI / 8.0f); // 45-degree vertical field of view
+		auto failures = 0u;
+		for (const auto viewportHeight : { 540.0f, 1080.0f, 2160.0f })
+		{
+			LodView view;
+			XMStoreFloat4x4(&view.World, XMMatrixIdentity());
+			view.Scale = 1.0f;
+			view.ErrorThreshold = g_lodErrorThreshold;
+			view.ErrorScale = 0.5f * projScale * viewportHeight;
+
+			uint64_t triCount = 0;
+			auto mismatches = 0u;
+			for (auto v = 0u; v < viewCount; ++v)
+			{
+				// Exponentially spaced distances
+				XMVECTOR planes[6], eyePt;
+				GetOrbitView(planes, eyePt, center, radius, v, viewCount, exp2f(6.0f * v / (max)(viewCount - 1, 1u)));
+				XMStoreFloat3(&view.ViewPosition, eyePt);
+
+				// The levels of a region are consecutive subsets, ending at the one without a parent.
+				auto selectedCount = 0u;
+				for (auto s = 0u; s < subsetCount; ++s)
+				{
+					const auto& lod = mesh.SubsetLods[s];
+					if (IsLodSelected(lod, view))
+					{
+						++selectedCount;
+						triCount += subsetTriCounts[s];
+					}
+
+					if (lod.ParentError == FLT_MAX)
+					{
+						mismatches += selectedCount == 1 ? 0 : 1;
+						selectedCount = 0;
+					}
+				}
+			}
+
+			wcout << L"LOD select at " << static_cast<uint32_t>(viewportHeight) << L"p: "
+				<< static_cast<double>(triCount) / viewCount << L" triangles per view";
+			if (mismatches > 0) wcout << L", " << mismatches << L" regions not drawn exactly once";
+			wcout << endl;
+			failures += mismatches;
+		}
+
+		return failures;
+	}
+
+	void PrintBatchStats(const wchar_t* label, const BatchStats& stats)
+	{
+		wcout << label << L"batches fully culled " << 100.0 * stats.CulledBatches / stats.Batches
+			<< L"%, partially culled " << 100.0 * stats.MixedBatches / stats.Batches
+			<< L"%, meshlets culled " << 100.0 * stats.CulledMeshlets / stats.Meshlets << L"%" << endl;
+	}
+
+	// Quantizes the vertices as the renderer does and checks the decoded positions against
+	// the half-step bound of 16-bit unorms, and the normals against the angle of a half step
+	// in octahedral space. Returns the number of vertices out of bounds.
+	uint32_t PrintQuantizationStats(const uint8_t* pVertices, uint32_t stride, uint32_t vertexCount,
+		uint32_t positionOffset, uint32_t normalOffset, uint32_t numThreads)
+	{
+		const VertexQuantizer quantizer(numThreads);
+		auto failures = 0u;
+		for (const uint8_t normalBits : { 8, 16 })
+		{
+			vector<uint8_t> quantized;
+			XMFLOAT3 positionBias, positionScale;
+			if (!quantizer.Quantize(quantized, positionBias, positionScale, pVertices, stride,
+				vertexCount, positionOffset, normalOffset, normalBits))
+			{
+				wcerr << L"Failed to quantize to oct" << normalBits << L" normals." << endl;
+				failures += vertexCount;
+				continue;
+			}
+
+			const auto quantizedStride = VertexQuantizer::GetStride(normalBits);
+			const auto halfStep = XMLoadFloat3(&positionScale) * 0.5f;
+
+			// Allow for the float rounding of the encoding and of bias + unorm * scale.
+			const auto bound = halfStep + (XMVectorAbs(XMLoadFloat3(&positionBias)) + halfStep * 131070.0f) * 2.0e-6f;
+
+			// A half step of both octahedral coordinates moves the normal by at most 3 times its
+			// length in radians: sqrt(3) from unfolding the octahedron, and sqrt(3) from normalizing.
+			// The chord is compared, since a dot product cannot resolve the 16-bit bound in floats.
+			const auto normalBound = 3.0f * sqrtf(2.0f) / ((1u << normalBits) - 1) + 1.0e-5f;
+
+			auto maxPositionError = 0.0f;
+			auto minNormalDot = 1.0f;
+			auto exceeded = 0u;
+			auto normalsExceeded = 0u;
+			for (auto i = 0u; i < vertexCount; ++i)
+			{
+				XMFLOAT3 position, normal;
+				VertexQuantizer::Dequantize(position, normal, &quantized[static_cast<size_t>(quantizedStride) * i],
+					positionBias, positionScale, normalBits);
+
+				const auto pVertex = &pVertices[static_cast<size_t>(stride) * i];
+				const auto p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pVertex[positionOffset]));
+				const auto n = XMVector3Normalize(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pVertex[normalOffset])));
+				const auto error = XMVectorAbs(XMLoadFloat3(&position) - p);
+				const auto decodedNormal = XMLoadFloat3(&normal);
+				const auto normalDot = XMVectorGetX(XMVector3Dot(n, decodedNormal));
+				exceeded += XMVector3LessOrEqual(error, bound) ? 0 : 1;
+				normalsExceeded += XMVectorGetX(XMVector3Length(decodedNormal - n)) <= normalBound ? 0 : 1;
+				maxPositionError = (max)(XMVectorGetX(XMVector3Length(error)), maxPositionError);
+				minNormalDot = (min)(normalDot, minNormalDot);
+			}
+
+			wcout << L"Q16 + oct" << normalBits << L": " << stride << L" -> " << quantizedStride
+				<< L" bytes per vertex, max position error " << maxPositionError << L" (bound "
+				<< XMVectorGetX(XMVector3Length(halfStep)) << L"), max normal error "
+				<< XMConvertToDegrees(acosf((max)(minNormalDot, -1.0f))) << L" degrees (bound "
+				<< XMConvertToDegrees(normalBound) << L")";
+			if (exceeded > 0) wcout << L", " << exceeded << L" positions exceed the bound";
+			if (normalsExceeded > 0) wcout << L", " << normalsExceeded << L" normals exceed the bound";
+			wcout << endl;
+			failures += exceeded + normalsExceeded;
+		}
+
+		return failures;
+	}
+
+	// Packs the primitives with each encoding that holds their indices, and checks that every
+	// triangle unpacks, the way the shader does, to the original 10-bit PackedTriangle. Returns
+	// the number of triangles that do not round-trip.
+	uint32_t PrintPrimitiveStats(const vector<PackedTriangle>& primitiveIndices)
+	{
+		auto failures = 0u;
+		const auto primitiveCount = primitiveIndices.size();
+		const auto minIndexBits = GetPrimitiveIndexBits(primitiveIndices.data(), primitiveCount);
+		for (const auto indexBits : { 6u, 8u, 10u })
+		{
+			if (indexBits < minIndexBits) continue;
+
+			vector<uint8_t> packed;
+			PackPrimitives(packed, primitiveIndices.data(), primitiveCount, indexBits);
+
+			auto mismatches = 0u;
+			for (size_t i = 0; i < primitiveCount; ++i)
+			{
+				uint32_t indices[3];
+				UnpackPrimitive(indices, packed.data(), i, indexBits);
+				const auto& prim = primitiveIndices[i];
+				mismatches += indices[0] == prim.i0 && indices[1] == prim.i1 && indices[2] == prim.i2 ? 0 : 1;
+			}
+
+			wcout << indexBits << L"-bit primitive indices: " << packed.size() << L" bytes ("
+				<< 100.0 * packed.size() / (sizeof(PackedTriangle) * primitiveCount) << L"%)"
+				<< (indexBits == minIndexBits ? L", selected" : L"");
+			if (mismatches > 0) wcout << L", " << mismatches << L" triangles mismatch";
+			wcout << endl;
+			failures += mismatches;
+		}
+
+		return failures;
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+
+		return 1;
+	}
+
+	auto maxVerts = static_cast<uint32_t>(MAX_VERTS);
+	auto maxPrims = static_cast<uint32_t>(MAX_PRIMS);
+	auto numThreads = 0u;
+	auto lodCount = 0u;
+	auto lodRatio = 0.5f;
+	auto cullBenchIterations = 0u;
+	auto batchStatsViews = 0u;
+	auto soaBenchViews = 0u;
+	auto cpuCullViews = 0u;
+	auto clusterLodCount = 0u;
+	auto lodSelectViews = 0u;
+	auto quantStats = false;
+	auto primStats = false;
+	auto useCache = false;
+	auto swapYZ = false;
+	auto forDX = true;
+
+	for (auto i = 3; i < argc; ++i)
+	{
+		if (_wcsicmp(argv[i], L"-verts") == 0 && i + 1 < argc) maxVerts = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-prims") == 0 && i + 1 < argc) maxPrims = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-threads") == 0 && i + 1 < argc) numThreads = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-lods") == 0 && i + 1 < argc) lodCount = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-lodratio") == 0 && i + 1 < argc) lodRatio = wcstof(argv[++i], nullptr);
+		else if (_wcsicmp(argv[i], L"-clusterlods") == 0 && i + 1 < argc) clusterLodCount = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-lodselect") == 0 && i + 1 < argc) lodSelectViews = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-cullbench") == 0 && i + 1 < argc) cullBenchIterations = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-batchstats") == 0 && i + 1 < argc) batchStatsViews = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-quantstats") == 0) quantStats = true;
+		else if (_wcsicmp(argv[i], L"-primstats") == 0) primStats = true;
+		else if (_wcsicmp(argv[i], L"-soabench") == 0 && i + 1 < argc) soaBenchViews = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-cpucull") == 0 && i + 1 < argc) cpuCullViews = wcstoul(argv[++i], nullptr, 10);
+		else if (_wcsicmp(argv[i], L"-cache") == 0) useCache = true;
+		else if (_wcsicmp(argv[i], L"-swapyz") == 0) swapYZ = true;
+		else if (_wcsicmp(argv[i], L"-rh") == 0) forDX = false;
+		else
+		{
+			PrintUsage();
+
+			return 1;
+		}
+	}
+
+	// The meshlet shaders output at most MAX_VERTS vertices and MAX_PRIMS primitives per group.
+	if (maxVerts < 3 || maxVerts > MAX_VERTS || maxPrims < 1 || maxPrims > MAX_PRIMS)
+	{
+		wcerr << L"Meshlet limits must be within " << MAX_VERTS << L" vertices and " << MAX_PRIMS << L" primitives." << endl;
+
+		return 1;
+	}
+
+	if (lodRatio <= 0.0f || lodRatio >= 1.0f)
+	{
+		wcerr << L"The LOD ratio must be between 0 and 1." << endl;
+
+		return 1;
+	}
+
+	auto start = chrono::steady_clock::now();
+
+	// Import the OBJ file.
+	XUSG::ObjLoader objLoader;
+	char fileName[MAX_PATH];
+	size_t length;
+	wcstombs_s(&length, fileName, argv[1], _TRUNCATE);
+	const auto cacheName = string(fileName) + ".cache";
+	if (!objLoader.Import(fileName, true, false, forDX, swapYZ, numThreads, useCache ? cacheName.c_str() : nullptr))
+	{
+		wcerr << L"Failed to import " << argv[1] << L"." << endl;
+
+		return 1;
+	}
+
+	const auto importTime = Elapsed(start);
+	struct _stat64 fileStat = {};
+	_wstat64(argv[1], &fileStat);
+
+	// Take the attribute offsets from the vertex streams of the loader. The builders take
+	// interleaved vertices, so separate streams are interleaved first, in the same order.
+	typedef XUSG::ObjLoader::VertexAttribute VertexAttribute;
+	const auto attributeCount = static_cast<uint8_t>(VertexAttribute::COUNT);
+	const uint32_t attributes[] = { Attribute::Position, Attribute::Normal, Attribute::TexCoord };
+	const uint32_t attributeSizes[] = { sizeof(float3), sizeof(float3), sizeof(float2) };
+	const auto vertexStride = objLoader.GetVertexStride();
+	auto isInterleaved = true;
+	for (uint8_t i = 0; i < attributeCount; ++i)
+	{
+		const auto stream = objLoader.GetVertexStream(static_cast<VertexAttribute>(i));
+		if (stream.pData && stream.Stride != vertexStride) isInterleaved = false;
+	}
+
+	MeshData mesh = {};
+	fill_n(mesh.AttributeOffsets, static_cast<uint32_t>(Attribute::Count), UINT32_MAX);
+	vector<uint8_t> interleaved(isInterleaved ? 0 : static_cast<size_t>(vertexStride) * objLoader.GetNumVertices());
+	auto offset = 0u;
+	for (uint8_t i = 0; i < attributeCount; ++i)
+	{
+		const auto stream = objLoader.GetVertexStream(static_cast<VertexAttribute>(i));
+		if (!stream.pData) continue;
+
+		mesh.AttributeOffsets[attributes[i]] = isInterleaved ? static_cast<uint32_t>(stream.Offset) : offset;
+		if (!isInterleaved) objLoader.CopyVertexAttribute(static_cast<VertexAttribute>(i), &interleaved[offset], vertexStride);
+		offset += attributeSizes[i];
+	}
+	const auto pVertices = isInterleaved ? objLoader.GetVertices() : interleaved.data();
+
+	// With cluster LODs, every level of every region is a meshlet subset of the output.
+	const Meshletizer meshletizer(maxVerts, maxPrims, numThreads);
+	const ClusterLodBuilder clusterLodBuilder(maxVerts, maxPrims, numThreads);
+	if (clusterLodCount > 0 ? !clusterLodBuilder.Build(mesh, pVertices, vertexStride,
+		objLoader.GetNumVertices(), objLoader.GetIndices(), objLoader.GetNumIndices(), clusterLodCount, lodRatio) :
+		!meshletizer.Build(mesh, pVertices, vertexStride, objLoader.GetNumVertices(),
+		objLoader.GetIndices(), objLoader.GetNumIndices()))
+	{
+		wcerr << L"Failed to build meshlets for " << argv[1] << L"." << endl;
+
+		return 1;
+	}
+
+	// Sort the meshlets spatially so that AS batches are culled coherently.
+	BatchStats unsortedStats = {};
+	if (batchStatsViews > 0) unsortedStats = ComputeBatchStats(mesh, batchStatsViews);
+	SortMeshlets(mesh);
+
+	const auto buildTime = Elapsed(start);
+
+	if (!Model::SaveToFile(argv[2], &mesh, 1))
+	{
+		wcerr << L"Failed to write " << argv[2] << L"." << endl;
+
+		return 1;
+	}
+
+	const auto saveTime = Elapsed(start);
+
+	// Report the meshlet statistics.
+	const auto meshletCount = static_cast<uint32_t>(mesh.Meshlets.size());
+	const auto triCount = mesh.IndexCount / 3;
+	wcout << fixed << setprecision(2);
+	const auto cornerCount = objLoader.GetNumIndices();
+	wcout << L"Vertices:  " << mesh.VertexCount << L" (" << objLoader.GetNumVertices() << L" unique of "
+		<< cornerCount << L" face corners, " << (cornerCount ? 100.0 * objLoader.GetNumVertices() / cornerCount : 0.0)
+		<< L"%)" << endl;
+	wcout << L"Triangles: " << triCount << endl;
+	wcout << L"Meshlets:  " << meshletCount << endl;
+	if (!mesh.SubsetLods.empty())
+	{
+		auto regionCount = 0u;
+		for (const auto& lod : mesh.SubsetLods) regionCount += lod.ParentError == FLT_MAX ? 1 : 0;
+		wcout << L"Cluster LODs: " << mesh.SubsetLods.size() << L" levels in " << regionCount << L" regions" << endl;
+	}
+	if (meshletCount > 0)
+	{
+		auto vertCount = 0.0;
+		for (const auto& meshlet : mesh.Meshlets) vertCount += meshlet.VertCount;
+		wcout << L"Avg verts per meshlet: " << vertCount / meshletCount << L" / " << maxVerts << endl;
+		wcout << L"Avg prims per meshlet: " << static_cast<double>(triCount) / meshletCount << L" / " << maxPrims << endl;
+	}
+	wcout << L"Import: " << importTime * 1000.0 << L" ms (" << fileStat.st_size / importTime / 1.0e6
+		<< L" MB/s), build: " << buildTime * 1000.0
+		<< L" ms, save: " << saveTime * 1000.0 << L" ms" << endl;
+
+	// Failures of the checks below make the run fail once the outputs are written.
+	auto checkFailures = 0u;
+
+	if (batchStatsViews > 0 && meshletCount > 0)
+	{
+		PrintBatchStats(L"Unsorted: ", unsortedStats);
+		PrintBatchStats(L"Sorted:   ", ComputeBatchStats(mesh, batchStatsViews));
+		Elapsed(start);
+	}
+
+	// Benchmark the cull data generation.
+	if (cullBenchIterations > 0 && meshletCount > 0)
+	{
+		const CullDataGenerator cullDataGenerator(numThreads);
+		Elapsed(start);
+		for (auto i = 0u; i < cullBenchIterations; ++i) cullDataGenerator.Generate(mesh);
+		const auto cullTime = Elapsed(start);
+
+		wcout << L"Cull data: " << static_cast<double>(meshletCount) * cullBenchIterations / cullTime / 1.0e6
+			<< L" M meshlets/s over " << cullBenchIterations << L" iterations" << endl;
+	}
+
+	if (soaBenchViews > 0 && meshletCount > 0)
+	{
+		checkFailures += RunSoACullBenchmark(mesh, soaBenchViews);
+		Elapsed(start);
+	}
+
+	if (cpuCullViews > 0 && meshletCount > 0)
+	{
+		checkFailures += RunCpuCullCheck(mesh, cpuCullViews, numThreads);
+		Elapsed(start);
+	}
+
+	if (lodSelectViews > 0 && !mesh.SubsetLods.empty())
+	{
+		checkFailures += RunLodSelectCheck(mesh, lodSelectViews);
+		Elapsed(start);
+	}
+
+	if (quantStats && objLoader.GetNumVertices() > 0)
+	{
+		wcout << setprecision(6);
+		checkFailures += PrintQuantizationStats(pVertices, vertexStride, objLoader.GetNumVertices(),
+			mesh.AttributeOffsets[Attribute::Position], mesh.AttributeOffsets[Attribute::Normal], numThreads);
+		wcout << setprecision(2);
+		Elapsed(start);
+	}
+
+	if (primStats && meshletCount > 0)
+	{
+		checkFailures += PrintPrimitiveStats(mesh.PrimitiveIndices);
+		Elapsed(start);
+	}
+
+	// Simplify the imported mesh for each coarser LOD.
+	const MeshSimplifier simplifier(numThreads);
+	auto targetTriCount = static_cast<float>(objLoader.GetNumIndices() / 3);
+	for (auto lod = 1u; lod <= lodCount; ++lod)
+	{
+		targetTriCount *= lodRatio;
+
+		vector<uint8_t> vertices;
+		vector<uint32_t> indices;
+		if (!simplifier.Simplify(vertices, indices, pVertices, vertexStride, objLoader.GetNumVertices(),
+			objLoader.GetIndices(), objLoader.GetNumIndices(), mesh.AttributeOffsets[Attribute::Position],
+			mesh.AttributeOffsets[Attribute::Normal], static_cast<uint32_t>(targetTriCount)) || indices.empty())
+		{
+			wcerr << L"Failed to simplify LOD" << lod << L"." << endl;
+
+			return 1;
+		}
+
+		MeshData lodMesh = {};
+		copy_n(mesh.AttributeOffsets, static_cast<uint32_t>(Attribute::Count), lodMesh.AttributeOffsets);
+		const auto fileName = Model::GetLodFileName(argv[2], lod);
+		if (!meshletizer.Build(lodMesh, vertices.data(), vertexStride, static_cast<uint32_t>(vertices.size() / vertexStride),
+			indices.data(), static_cast<uint32_t>(indices.size())))
+		{
+			wcerr << L"Failed to build " << fileName << L"." << endl;
+
+			return 1;
+		}
+
+		SortMeshlets(lodMesh);
+		if (!Model::SaveToFile(fileName.c_str(), &lodMesh, 1))
+		{
+			wcerr << L"Failed to write " << fileName << L"." << endl;
+
+			return 1;
+		}
+
+		wcout << L"LOD" << lod << L": " << lodMesh.IndexCount / 3 << L" triangles, " << lodMesh.Meshlets.size()
+			<< L" meshlets -> " << fileName << L" (" << Elapsed(start) * 1000.0 << L" ms)" << endl;
+	}
+
+	if (checkFailures > 0)
+	{
+		wcerr << checkFailures << L" checks failed." << endl;
+
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Checks the CPU meshlet culler against the scalar reference IsMeshletVisible() on synthetic
+// cull data: random spheres and normal cones, seen through random transforms and frusta.
+
+#include "MeshletCuller.h"
+
+#include <random>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	const auto MeshletCount = 1000u; // Not a multiple of AS_GROUP_SIZE, so the last batch is partial
+	const auto ViewCount = 200u;
+
+	// Row-vector world matrix of a uniform scale, a rotation about a unit axis, and a translation
+	XMFLOAT4X4 MakeWorld(float scale, const XMFLOAT3& axis, float angle, const XMFLOAT3& translation)
+	{
+		const auto c = cosf(angle);
+		const auto s = sinf(angle);
+		const auto t = 1.0f - c;
+		const auto& a = axis;
+
+		return XMFLOAT4X4(
+			scale * (t * a.x * a.x + c), scale * (t * a.x * a.y + s * a.z), scale * (t * a.x * a.z - s * a.y), 0.0f,
+			scale * (t * a.x * a.y - s * a.z), scale * (t * a.y * a.y + c), scale * (t * a.y * a.z + s * a.x), 0.0f,
+			scale * (t * a.x * a.z + s * a.y), scale * (t * a.y * a.z - s * a.x), scale * (t * a.z * a.z + c), 0.0f,
+			translation.x, translation.y, translation.z, 1.0f);
+	}
+
+	XMFLOAT3 RandomUnitVector(mt19937& rng)
+	{
+		normal_distribution<float> gaussian;
+		XMFLOAT3 v(gaussian(rng), gaussian(rng), gaussian(rng));
+		const auto length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+
+		return length > 0.0f ? XMFLOAT3(v.x / length, v.y / length, v.z / length) : XMFLOAT3(0.0f, 0.0f, 1.0f);
+	}
+
+	uint8_t ToSnorm8(float v)
+	{
+		return static_cast<uint8_t>(lroundf((v * 0.5f + 0.5f) * 255.0f));
+	}
+
+	vector<CullData> CreateCullData(mt19937& rng)
+	{
+		uniform_real_distribution<float> position(-10.0f, 10.0f), radius(0.0f, 3.0f), unit(0.0f, 1.0f);
+		vector<CullData> cullData(MeshletCount);
+		for (auto& data : cullData)
+		{
+			data.BoundingSphere = XMFLOAT4(position(rng), position(rng), position(rng), radius(rng));
+
+			// One in eight cones is degenerate, and the others span any angle.
+			const auto axis = RandomUnitVector(rng);
+			data.NormalCone[0] = ToSnorm8(axis.x);
+			data.NormalCone[1] = ToSnorm8(axis.y);
+			data.NormalCone[2] = ToSnorm8(axis.z);
+			data.NormalCone[3] = rng() % 8 == 0 ? 0xff : static_cast<uint8_t>(rng() % 255);
+			data.ApexOffset = data.BoundingSphere.w * 2.0f * unit(rng);
+		}
+
+		return cullData;
+	}
+
+	// An oriented box of random extent around a random point, as 6 inward-facing planes
+	void SetRandomPlanes(CullView& view, mt19937& rng)
+	{
+		uniform_real_distribution<float> position(-8.0f, 8.0f), extent(1.0f, 12.0f);
+		const XMFLOAT3 center(position(rng), position(rng), position(rng));
+		const auto box = MakeWorld(1.0f, RandomUnitVector(rng), 6.2831853f * (rng() % 1024) / 1024.0f, center);
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const XMFLOAT3 n(box.m[i][0], box.m[i][1], box.m[i][2]);
+			const auto d = n.x * center.x + n.y * center.y + n.z * center.z;
+			const auto e = extent(rng);
+			view.Planes[2 * i] = XMFLOAT4(n.x, n.y, n.z, e - d);
+			view.Planes[2 * i + 1] = XMFLOAT4(-n.x, -n.y, -n.z, e + d);
+		}
+	}
+
+	// Hand-made cases with known outcomes, so that the reference itself is checked.
+	void CheckKnownCases()
+	{
+		CullView view = {};
+		view.World = MakeWorld(1.0f, XMFLOAT3(0.0f, 0.0f, 1.0f), 0.0f, XMFLOAT3(0.0f, 0.0f, 0.0f));
+		view.Scale = 1.0f;
+		view.ViewPosition = XMFLOAT3(0.0f, 0.0f, 10.0f);
+		view.Flags = CULL_FLAG;
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			XMFLOAT3 n(0.0f, 0.0f, 0.0f);
+			(&n.x)[i] = 1.0f;
+			view.Planes[2 * i] = XMFLOAT4(n.x, n.y, n.z, 5.0f);
+			view.Planes[2 * i + 1] = XMFLOAT4(-n.x, -n.y, -n.z, 5.0f);
+		}
+
+		CullData data = {};
+		data.NormalCone[3] = 0xff;
+
+		// Inside, touching and outside the box
+		data.BoundingSphere = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		CHECK(IsMeshletVisible(data, view));
+		data.BoundingSphere = XMFLOAT4(5.5f, 0.0f, 0.0f, 1.0f);
+		CHECK(IsMeshletVisible(data, view));
+		data.BoundingSphere = XMFLOAT4(6.5f, 0.0f, 0.0f, 1.0f);
+		CHECK(!IsMeshletVisible(data, view));
+
+		// Unless culling is off
+		view.Flags = 0;
+		CHECK(IsMeshletVisible(data, view));
+		view.Flags = CULL_FLAG;
+
+		// A narrow cone facing away from the viewer is culled, and one facing it is not.
+		data.BoundingSphere = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		data.NormalCone[0] = ToSnorm8(0.0f);
+		data.NormalCone[1] = ToSnorm8(0.0f);
+		data.NormalCone[2] = ToSnorm8(-1.0f);
+		data.NormalCone[3] = 64;
+		CHECK(!IsMeshletVisible(data, view));
+		data.NormalCone[2] = ToSnorm8(1.0f);
+		CHECK(IsMeshletVisible(data, view));
+	}
+}
+
+int main()
+{
+	CheckKnownCases();
+
+	mt19937 rng(5489u);
+	const auto cullData = CreateCullData(rng);
+	CullDataSoA cullDataSoA;
+	ConvertCullData(cullDataSoA, cullData.data(), MeshletCount);
+
+	// The conversion round-trips.
+	vector<CullData> converted;
+	ConvertCullData(converted, cullDataSoA);
+	CHECK(converted.size() == cullData.size());
+	CHECK(memcmp(converted.data(), cullData.data(), sizeof(CullData) * MeshletCount) == 0);
+
+	const auto batchCount = MeshletCuller::GetBatchCount(MeshletCount);
+	vector<DispatchArgs> dispatchArgs(batchCount);
+	vector<uint32_t> visible(MeshletCount), reference(MeshletCount);
+	uint64_t visibleTotal = 0;
+	for (auto v = 0u; v < ViewCount; ++v)
+	{
+		uniform_real_distribution<float> scale(0.25f, 2.0f), position(-20.0f, 20.0f);
+		CullView view;
+		view.Scale = scale(rng);
+		view.World = MakeWorld(view.Scale, RandomUnitVector(rng), 6.2831853f * (rng() % 1024) / 1024.0f,
+			XMFLOAT3(position(rng), position(rng), position(rng)));
+		view.ViewPosition = XMFLOAT3(position(rng), position(rng), position(rng));
+		view.Flags = v % 16 == 15 ? 0 : CULL_FLAG;
+		SetRandomPlanes(view, rng);
+
+		// The batched culler fills the dispatch arguments of each batch like the reference.
+		const MeshletCuller culler(1 + v % 4);
+		const auto visibleCount = culler.Cull(dispatchArgs.data(), cullDataSoA, view);
+		auto referenceCount = 0u;
+		for (auto i = 0u; i < batchCount; ++i)
+		{
+			DispatchArgs referenceArgs;
+			auto batchVisibleCount = 0u;
+			const auto end = (min)(AS_GROUP_SIZE * (i + 1), MeshletCount);
+			for (auto j = AS_GROUP_SIZE * i; j < end; ++j)
+				if (IsMeshletVisible(cullData[j], view)) referenceArgs.ASDispatchArgs.MeshletIndices[batchVisibleCount++] = j;
+			MeshletCuller::SetDispatchArgs(referenceArgs, i, batchVisibleCount);
+			referenceCount += batchVisibleCount;
+
+			const auto size = offsetof(DispatchArgs, ASDispatchArgs.MeshletIndices) + sizeof(uint32_t) * batchVisibleCount;
+			CHECK(memcmp(&dispatchArgs[i], &referenceArgs, size) == 0);
+		}
+		CHECK(visibleCount == referenceCount);
+		visibleTotal += visibleCount;
+
+		// So does the kernel over any range starting at a whole vector.
+		const auto begin = static_cast<uint32_t>(rng() % (MeshletCount / CullDataSoA::Width)) * CullDataSoA::Width;
+		const auto end = begin + static_cast<uint32_t>(rng() % (MeshletCount - begin + 1));
+		auto count = 0u;
+		for (auto i = begin; i < end; ++i)
+			if (IsMeshletVisible(cullData[i], view)) reference[count++] = i;
+		CHECK(CullMeshlets(visible.data(), cullDataSoA, begin, end, view) == count);
+		CHECK(equal(reference.cbegin(), reference.cbegin() + count, visible.cbegin()));
+	}
+
+	// The views must neither cull everything nor nothing, or the comparison proves little.
+	CHECK(visibleTotal > 0 && visibleTotal < uint64_t(MeshletCount) * ViewCount);
+	printf("%u views of %u meshlets match, %.1f%% visible\n", ViewCount, MeshletCount,
+		100.0 * visibleTotal / (uint64_t(MeshletCount) * ViewCount));
+
+	return 0;
+}
@@ -0,0 +1,214 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Stand-alone driver of the model fuzzer for toolchains without libFuzzer.
+//   ModelFuzzerReplay                  checks generated models and runs mutations of them
+//   ModelFuzzerReplay <file>...        replays the files, e.g. crashes found by libFuzzer
+//   ModelFuzzerReplay -seed <file>     writes a generated model as a seed for the corpus
+
+#include "Model.h"
+
+#include <fstream>
+
+using namespace std;
+using namespace DirectX;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace
+{
+	const auto MutationCount = 200000u;
+
+	template <typename T>
+	void AppendIndex(vector<uint8_t>& indices, uint32_t index)
+	{
+		const auto value = static_cast<T>(index);
+		const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		indices.insert(indices.end(), bytes, bytes + sizeof(T));
+	}
+
+	// A grid of quads in one meshlet per row, with an optional LOD level per row.
+	MeshData CreateGridMesh(uint32_t quadsPerRow, uint32_t rowCount, uint32_t indexSize, bool hasLods)
+	{
+		MeshData mesh = {};
+		mesh.VertexStride = 24;
+		mesh.IndexSize = indexSize;
+		for (auto& offset : mesh.AttributeOffsets) offset = uint32_t(-1);
+		mesh.AttributeOffsets[Attribute::Position] = 0;
+		mesh.AttributeOffsets[Attribute::Normal] = 12;
+
+		const auto appendIndex = [&](vector<uint8_t>& indices, uint32_t index)
+		{
+			indexSize == 4 ? AppendIndex<uint32_t>(indices, index) : AppendIndex<uint16_t>(indices, index);
+		};
+
+		const auto rowVerts = 2 * (quadsPerRow + 1);
+		for (auto row = 0u; row < rowCount; ++row)
+		{
+			const auto firstVert = row * rowVerts;
+			for (auto i = 0u; i < rowVerts; ++i)
+			{
+				const float vertex[] = { float(i / 2), float(row + i % 2), 0.0f, 0.0f, 0.0f, 1.0f };
+				const auto bytes = reinterpret_cast<const uint8_t*>(vertex);
+				mesh.Vertices.insert(mesh.Vertices.end(), bytes, bytes + sizeof(vertex));
+				appendIndex(mesh.UniqueVertexIndices, firstVert + i);
+			}
+
+			Meshlet meshlet = { rowVerts, firstVert, 2 * quadsPerRow, 2 * quadsPerRow * row };
+			for (auto i = 0u; i < quadsPerRow; ++i)
+			{
+				const uint32_t v = 2 * i;
+				const uint32_t triangles[2][3] = { { v, v + 1, v + 2 }, { v + 2, v + 1, v + 3 } };
+				for (const auto& tri : triangles)
+				{
+					PackedTriangle prim = {};
+					prim.i0 = tri[0];
+					prim.i1 = tri[1];
+					prim.i2 = tri[2];
+					mesh.PrimitiveIndices.push_back(prim);
+					for (const auto index : tri) appendIndex(mesh.Indices, firstVert + index);
+				}
+			}
+
+			CullData cull = {};
+			cull.BoundingSphere = XMFLOAT4(0.5f * quadsPerRow, row + 0.5f, 0.0f, 0.5f * quadsPerRow + 1.0f);
+			cull.NormalCone[2] = 255;
+			cull.NormalCone[3] = 0;
+
+			mesh.Meshlets.push_back(meshlet);
+			mesh.CullingData.push_back(cull);
+			mesh.MeshletSubsets.push_back({ row, 1 });
+
+			if (hasLods)
+			{
+				LodBounds lod = { cull.BoundingSphere, 0.0f, FLT_MAX };
+				mesh.SubsetLods.push_back(lod);
+			}
+		}
+
+		mesh.VertexCount = rowVerts * rowCount;
+		mesh.IndexCount = static_cast<uint32_t>(mesh.Indices.size()) / indexSize;
+		mesh.IndexSubsets.push_back({ 0, mesh.IndexCount });
+		mesh.UniqueVertexIndices.resize((mesh.UniqueVertexIndices.size() + 3) & ~size_t(3));
+
+		return mesh;
+	}
+
+	// Seeds cover both file versions and both index sizes.
+	vector<vector<uint8_t>> CreateSeeds()
+	{
+		const MeshData meshes[] =
+		{
+			CreateGridMesh(3, 2, 2, true),
+			CreateGridMesh(2, 3, 4, true),
+		};
+
+		vector<vector<uint8_t>> seeds(3);
+		Model::SaveToMemory(seeds[0], meshes, 2);
+		Model::SaveToMemory(seeds[1], &meshes[1], 1);
+
+		MeshData mesh = CreateGridMesh(4, 1, 2, false);
+		Model::SaveToMemory(seeds[2], &mesh, 1);
+
+		return seeds;
+	}
+
+	void CheckSeed(const vector<uint8_t>& seed, uint32_t meshCount)
+	{
+		Model model;
+		CHECK(model.LoadFromMemory(seed.data(), seed.size()));
+		CHECK(model.GetMeshCount() == meshCount);
+		CHECK(model.GetLoadError().Code == ModelError::None);
+	}
+
+	// Byte-level mutations in the spirit of libFuzzer's, biased to the 32-bit fields of the format.
+	void Mutate(vector<uint8_t>& data, uint64_t& state)
+	{
+		const auto next = [&state]()
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+
+			return static_cast<uint32_t>(state >> 32);
+		};
+
+		const uint32_t interesting[] = { 0, 1, 2, 3, 4, 0xff, 0x3ff, 0xffff, 0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff };
+		for (auto n = next() % 4 + 1; n > 0 && !data.empty(); --n)
+		{
+			const auto size = static_cast<uint32_t>(data.size());
+			switch (next() % 5)
+			{
+			case 0:
+				data[next() % size] ^= 1 << (next() % 8);
+				break;
+			case 1:
+				if (size >= 4)
+				{
+					const auto value = interesting[next() % (sizeof(interesting) / sizeof(interesting[0]))];
+					memcpy(&data[(next() % (size / 4)) * 4], &value, sizeof(value));
+				}
+				break;
+			case 2:
+				if (size >= 4)
+				{
+					uint32_t value;
+					const auto offset = (next() % (size / 4)) * 4;
+					memcpy(&value, &data[offset], sizeof(value));
+					value += next() % 2 ? 1 : -1;
+					memcpy(&data[offset], &value, sizeof(value));
+				}
+				break;
+			case 3:
+				data.resize(next() % size);
+				break;
+			default:
+				data.insert(data.begin() + next() % size, next() % 16, static_cast<uint8_t>(next()));
+				break;
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const auto seeds = CreateSeeds();
+
+	if (argc == 3 && strcmp(argv[1], "-seed") == 0)
+	{
+		ofstream stream(argv[2], ios::binary);
+		stream.write(reinterpret_cast<const char*>(seeds[0].data()), seeds[0].size());
+
+		return stream.good() ? 0 : 1;
+	}
+
+	if (argc > 1)
+	{
+		for (auto i = 1; i < argc; ++i)
+		{
+			ifstream stream(argv[i], ios::binary);
+			const vector<uint8_t> data((istreambuf_iterator<char>(stream)), istreambuf_iterator<char>());
+			CHECK(stream.good() || stream.eof());
+			LLVMFuzzerTestOneInput(data.data(), data.size());
+		}
+
+		return 0;
+	}
+
+	CheckSeed(seeds[0], 2);
+	CheckSeed(seeds[1], 1);
+	CheckSeed(seeds[2], 1);
+
+	uint64_t state = 0x9e3779b97f4a7c15;
+	for (auto i = 0u; i < MutationCount; ++i)
+	{
+		auto data = seeds[i % seeds.size()];
+		Mutate(data, state);
+		LLVMFuzzerTestOneInput(data.data(), data.size());
+	}
+
+	printf("%u mutations of %zu seeds passed\n", MutationCount, seeds.size());
+
+	return 0;
+}
@@ -0,0 +1,145 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Checks that IsLodSelected() draws exactly one level of every region on synthetic LOD chains,
+// from inside the bounds out to where only the coarsest level remains, at several viewport heights.
+
+#include "MeshletCuller.h"
+
+#include <random>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	const auto RegionCount = 500u;
+	const auto DistanceCount = 64u;
+
+	// Levels of one region, finest first, as ClusterLodBuilder lays them out
+	struct Region
+	{
+		vector<LodBounds> Levels;
+	};
+
+	Region CreateRegion(const XMFLOAT4& sphere, const vector<float>& errors)
+	{
+		Region region;
+		for (size_t l = 0; l < errors.size(); ++l)
+			region.Levels.push_back({ sphere, errors[l], l + 1 < errors.size() ? errors[l + 1] : FLT_MAX });
+
+		return region;
+	}
+
+	vector<Region> CreateRegions(mt19937& rng)
+	{
+		uniform_real_distribution<float> position(-50.0f, 50.0f), radius(0.0f, 10.0f), growth(1.2f, 4.0f);
+		vector<Region> regions;
+
+		// Edge cases: a single level, equal errors at the finest level, and at coarser ones
+		const XMFLOAT4 sphere(1.0f, 2.0f, 3.0f, 4.0f);
+		regions.push_back(CreateRegion(sphere, { 0.0f }));
+		regions.push_back(CreateRegion(sphere, { 0.0f, 0.0f, 0.5f }));
+		regions.push_back(CreateRegion(sphere, { 0.0f, 0.25f, 0.25f, 0.25f, 1.0f }));
+		regions.push_back(CreateRegion(sphere, { 0.0f, 0.0f, 0.0f }));
+
+		while (regions.size() < RegionCount)
+		{
+			// Errors never decrease toward the coarsest level; one in four repeats the previous one.
+			vector<float> errors(1 + rng() % 6);
+			auto error = 0.01f * radius(rng);
+			for (size_t l = 1; l < errors.size(); ++l)
+			{
+				if (rng() % 4 != 0) error *= growth(rng);
+				errors[l] = error;
+			}
+			regions.push_back(CreateRegion(XMFLOAT4(position(rng), position(rng), position(rng), radius(rng)), errors));
+		}
+
+		return regions;
+	}
+
+	// Index of the only selected level, or -1 if the region is drawn other than exactly once
+	int GetSelectedLevel(const Region& region, const LodView& view)
+	{
+		auto selected = -1;
+		for (size_t l = 0; l < region.Levels.size(); ++l)
+		{
+			if (!IsLodSelected(region.Levels[l], view)) continue;
+			if (selected >= 0) return -1;
+			selected = static_cast<int>(l);
+		}
+
+		return selected;
+	}
+
+	// The finest level whose parent is coarser than the finest level itself
+	int GetFinestDistinctLevel(const Region& region)
+	{
+		auto l = 0;
+		while (region.Levels[l].ParentError == region.Levels[0].Error) ++l;
+
+		return l;
+	}
+}
+
+int main()
+{
+	mt19937 rng(5489u);
+	const auto regions = CreateRegions(rng);
+
+	const auto projScale = 1.0f / tanf(XM_PI / 8.0f); // 45-degree vertical field of view, as the builder
+	uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto selectionCount = 0u;
+	for (const auto viewportHeight : { 1.0f, 540.0f, 1080.0f, 2160.0f })
+	{
+		for (const auto scale : { 0.5f, 1.0f, 3.0f })
+		{
+			LodView view;
+			view.World = XMFLOAT4X4(scale, 0.0f, 0.0f, 0.0f, 0.0f, scale, 0.0f, 0.0f, 0.0f, 0.0f, scale, 0.0f,
+				unit(rng), unit(rng), unit(rng), 1.0f);
+			view.Scale = scale;
+			view.ErrorThreshold = 1.0f;
+			view.ErrorScale = 0.5f * projScale * viewportHeight;
+
+			for (const auto& region : regions)
+			{
+				// Views from a random direction, from inside the sphere out along the ray
+				XMFLOAT3 dir(unit(rng), unit(rng), unit(rng));
+				const auto length = sqrtf(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+				if (length == 0.0f) dir = XMFLOAT3(1.0f, 0.0f, 0.0f);
+				else dir = XMFLOAT3(dir.x / length, dir.y / length, dir.z / length);
+
+				const auto& sphere = region.Levels[0].BoundingSphere;
+				const auto& m = view.World.m;
+				const XMFLOAT3 center(sphere.x * scale + m[3][0], sphere.y * scale + m[3][1], sphere.z * scale + m[3][2]);
+
+				auto prevLevel = 0;
+				for (auto d = 0u; d < DistanceCount; ++d)
+				{
+					// Distance 0 at the center and on the surface, then exponentially spaced
+					const auto offset = d == 0 ? 0.0f : sphere.w * scale + (d == 1 ? 0.0f : 1.0e-3f * exp2f(0.5f * d));
+					view.ViewPosition = XMFLOAT3(center.x + dir.x * offset, center.y + dir.y * offset, center.z + dir.z * offset);
+
+					const auto level = GetSelectedLevel(region, view);
+					CHECK(level >= 0);
+
+					// Coarser levels only as the viewer recedes
+					CHECK(level >= prevLevel);
+					prevLevel = level;
+
+					if (d == 0) CHECK(level == GetFinestDistinctLevel(region));
+					++selectionCount;
+				}
+
+				// Far enough away, only the coarsest level remains.
+				CHECK(prevLevel + 1 == static_cast<int>(region.Levels.size()));
+			}
+		}
+	}
+
+	printf("%u selections over %u regions select exactly one level\n", selectionCount, RegionCount);
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Model.h"
+
+using namespace DirectX;
+
+// libFuzzer entry point. Any file the parser accepts must be safe to walk the way the renderer
+// and the tools do, so every view is read in full; the sanitizers catch what validation missed.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	Model model;
+	if (!model.LoadFromMemory(data, size)) return 0;
+
+	auto sum = 0u;
+	for (auto& mesh : model)
+	{
+		// Every vertex the indices reach, through every attribute stream
+		const auto readVertex = [&](uint32_t index)
+		{
+			for (auto j = 0u; j < Attribute::Count; ++j)
+			{
+				const auto stream = mesh.AttributeStreams[j];
+				if (stream == uint32_t(-1)) continue;
+
+				const auto addr = mesh.Vertices[stream].data() + size_t(mesh.VertexStrides[stream]) * index + mesh.AttributeOffsets[j];
+				uint32_t word;
+				memcpy(&word, addr, sizeof(word));
+				sum += word;
+			}
+		};
+
+		for (const auto& subset : mesh.IndexSubsets)
+			for (auto j = subset.Offset; j < subset.Offset + subset.Count; ++j)
+				readVertex(mesh.IndexSize == 4 ? reinterpret_cast<const uint32_t*>(mesh.Indices.data())[j] :
+					reinterpret_cast<const uint16_t*>(mesh.Indices.data())[j]);
+
+		for (const auto& subset : mesh.MeshletSubsets)
+		{
+			for (auto j = subset.Offset; j < subset.Offset + subset.Count; ++j)
+			{
+				const auto& meshlet = mesh.Meshlets[j];
+				sum += mesh.CullingData[j].NormalCone[3];
+				for (auto k = 0u; k < meshlet.PrimCount; ++k)
+				{
+					uint32_t i0, i1, i2;
+					mesh.GetPrimitive(meshlet.PrimOffset + k, i0, i1, i2);
+					readVertex(mesh.GetVertexIndex(meshlet.VertOffset + i0));
+					readVertex(mesh.GetVertexIndex(meshlet.VertOffset + i1));
+					readVertex(mesh.GetVertexIndex(meshlet.VertOffset + i2));
+				}
+			}
+		}
+
+		for (const auto& lod : mesh.SubsetLods) sum += lod.Error > 0.0f;
+	}
+
+	// Keep the reads observable
+	volatile auto sink = sum;
+	(void)sink;
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Round-trips triangles through PackPrimitives() and UnpackPrimitive() at 6, 8 and 10 bits per
+// index: the exact bits of triangles straddling words, and the padding after the last triangle.
+
+#include "PrimitivePacker.h"
+
+#include <memory>
+#include <random>
+
+using namespace std;
+
+namespace
+{
+	PackedTriangle MakeTriangle(uint32_t i0, uint32_t i1, uint32_t i2)
+	{
+		PackedTriangle prim = {};
+		prim.i0 = i0;
+		prim.i1 = i1;
+		prim.i2 = i2;
+
+		return prim;
+	}
+
+	vector<uint32_t> Pack(const vector<PackedTriangle>& prims, uint32_t indexBits)
+	{
+		vector<uint8_t> packed;
+		PackPrimitives(packed, prims.data(), prims.size(), indexBits);
+		CHECK(packed.size() == GetPackedPrimitiveSize(prims.size(), indexBits));
+		CHECK(packed.size() % sizeof(uint32_t) == 0);
+
+		vector<uint32_t> words(packed.size() / sizeof(uint32_t));
+		memcpy(words.data(), packed.data(), packed.size());
+
+		return words;
+	}
+
+	// Unpacks from a buffer of exactly the packed size, so that a read past it trips the sanitizer.
+	void CheckRoundTrip(const vector<PackedTriangle>& prims, uint32_t indexBits)
+	{
+		vector<uint8_t> packed;
+		PackPrimitives(packed, prims.data(), prims.size(), indexBits);
+		const unique_ptr<uint8_t[]> exact(new uint8_t[packed.size()]);
+		memcpy(exact.get(), packed.data(), packed.size());
+
+		for (size_t i = 0; i < prims.size(); ++i)
+		{
+			uint32_t indices[3];
+			UnpackPrimitive(indices, exact.get(), i, indexBits);
+			CHECK(indices[0] == prims[i].i0 && indices[1] == prims[i].i1 && indices[2] == prims[i].i2);
+		}
+
+		// The padding word and the bits past the last triangle stay clear.
+		const auto usedBits = static_cast<uint64_t>(GetPrimitiveStride(indexBits)) * prims.size();
+		const auto words = Pack(prims, indexBits);
+		CHECK(words.back() == 0);
+		if (usedBits % 32) CHECK(words[usedBits / 32] >> (usedBits % 32) == 0);
+	}
+
+	void CheckIndexBits()
+	{
+		CHECK(GetPrimitiveIndexBits(nullptr, 0) == 6);
+
+		const PackedTriangle prims[] = { MakeTriangle(0, 63, 1), MakeTriangle(64, 0, 0), MakeTriangle(0, 0, 255),
+			MakeTriangle(256, 0, 0), MakeTriangle(0, 1023, 0) };
+		const uint32_t expected[] = { 6, 8, 8, 10, 10 };
+		for (auto i = 0u; i < 5; ++i)
+		{
+			CHECK(GetPrimitiveIndexBits(prims, i + 1) == expected[i]);
+			CHECK(GetPrimitiveIndexBits(&prims[i], 1) == expected[i]);
+		}
+
+		CHECK(GetPrimitiveStride(6) == 18 && GetPrimitiveStride(8) == 24 && GetPrimitiveStride(10) == 32);
+	}
+
+	// The second triangle straddles the first two words at 6 and 8 bits.
+	void CheckStraddlingWords()
+	{
+		const vector<PackedTriangle> prims = { MakeTriangle(1, 2, 3), MakeTriangle(4, 5, 6) };
+
+		// 18 bits each: (1 | 2 << 6 | 3 << 12) | (4 | 5 << 6 | 6 << 12) << 18, then its top 4 bits
+		auto words = Pack(prims, 6);
+		CHECK(words.size() == 3);
+		CHECK(words[0] == 0x85103081 && words[1] == 0x1 && words[2] == 0);
+
+		// 24 bits each: (1 | 2 << 8 | 3 << 16) | 4 << 24, then 5 | 6 << 8
+		words = Pack(prims, 8);
+		CHECK(words.size() == 3);
+		CHECK(words[0] == 0x04030201 && words[1] == 0x605 && words[2] == 0);
+
+		// A full word each, in the layout of PackedTriangle
+		words = Pack(prims, 10);
+		CHECK(words.size() == 3);
+		CHECK(memcmp(words.data(), prims.data(), sizeof(PackedTriangle) * prims.size()) == 0 && words[2] == 0);
+
+		for (const auto indexBits : { 6u, 8u, 10u }) CheckRoundTrip(prims, indexBits);
+	}
+
+	// Triangle counts that end the stream exactly on a word leave only the padding word to read.
+	void CheckLastTrianglePadding()
+	{
+		for (const auto indexBits : { 6u, 8u, 10u })
+		{
+			const auto maxIndex = (1u << indexBits) - 1;
+			const auto stride = GetPrimitiveStride(indexBits);
+			const auto alignedCount = 32 / (stride & (~stride + 1)); // Triangles per whole number of words
+			for (auto count = alignedCount - 1; count <= alignedCount + 1; ++count)
+			{
+				vector<PackedTriangle> prims(count, MakeTriangle(maxIndex, maxIndex, maxIndex));
+				if (count > 0) prims.back() = MakeTriangle(maxIndex, 0, maxIndex);
+				CHECK(GetPackedPrimitiveSize(count, indexBits) == sizeof(uint32_t) * ((stride * count + 31) / 32 + 1));
+				CheckRoundTrip(prims, indexBits);
+			}
+		}
+	}
+
+	void CheckRandomTriangles()
+	{
+		mt19937 rng(5489u);
+		for (const auto indexBits : { 6u, 8u, 10u })
+		{
+			for (auto count = 0u; count <= 130; ++count)
+			{
+				vector<PackedTriangle> prims(count);
+				for (auto& prim : prims)
+					prim = MakeTriangle(rng() >> (32 - indexBits), rng() >> (32 - indexBits), rng() >> (32 - indexBits));
+				if (count > 0) CHECK(GetPrimitiveIndexBits(prims.data(), count) <= indexBits);
+				CheckRoundTrip(prims, indexBits);
+			}
+		}
+	}
+}
+
+int main()
+{
+	CheckIndexBits();
+	CheckStraddlingWords();
+	CheckLastTrianglePadding();
+	CheckRandomTriangles();
+
+	printf("Primitive packing round trips passed\n");
+
+	return 0;
+}
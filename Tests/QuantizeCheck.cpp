@@ -0,0 +1,198 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Round-trips fixed vertices through VertexQuantizer::Quantize() and Dequantize() with 8- and
+// 16-bit normals: the bounds, a flat axis, the octahedral folds, and the error bounds.
+
+#include "VertexQuantizer.h"
+
+#include <random>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	// Interleaved as in an OBJ with padding around the attributes, to exercise the offsets
+	struct Vertex
+	{
+		float    Pad0;
+		XMFLOAT3 Position;
+		XMFLOAT3 Normal;
+		float    Pad1;
+	};
+
+	const auto PositionOffset = static_cast<uint32_t>(offsetof(Vertex, Position));
+	const auto NormalOffset = static_cast<uint32_t>(offsetof(Vertex, Normal));
+
+	// Smallest cosine between a unit normal and its decoded code
+	const float MinNormalDot8 = 0.9999f;     // About 0.8 degrees
+	const float MinNormalDot16 = 0.9999995f; // About 0.06 degrees, near the resolution of a float cosine
+
+	XMFLOAT3 Normalize(float x, float y, float z)
+	{
+		const auto length = sqrtf(x * x + y * y + z * z);
+
+		return XMFLOAT3(x / length, y / length, z / length);
+	}
+
+	uint32_t LoadWord(const vector<uint8_t>& quantized, size_t index)
+	{
+		uint32_t word;
+		memcpy(&word, &quantized[sizeof(uint32_t) * index], sizeof(word));
+
+		return word;
+	}
+
+	// The fixed input: the corners of the bounds, normals along the axes and on both sides of the
+	// octahedral folds (z < 0), and one with a flat x axis.
+	vector<Vertex> CreateVertices()
+	{
+		const Vertex vertices[] =
+		{
+			{ 0.0f, XMFLOAT3(-1.0f, 2.0f, -3.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), 0.0f },
+			{ 0.0f, XMFLOAT3(3.0f, 6.0f, 5.0f), XMFLOAT3(0.0f, 0.0f, -1.0f), 0.0f },
+			{ 0.0f, XMFLOAT3(1.0f, 4.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), 0.0f },
+			{ 0.0f, XMFLOAT3(-1.0f, 6.0f, 5.0f), XMFLOAT3(0.0f, -1.0f, 0.0f), 0.0f },
+			{ 0.0f, XMFLOAT3(2.0f, 2.5f, 0.0f), Normalize(1.0f, 1.0f, 1.0f), 0.0f },
+			{ 0.0f, XMFLOAT3(0.1f, 5.9f, -2.9f), Normalize(-1.0f, -2.0f, -3.0f), 0.0f },
+			{ 0.0f, XMFLOAT3(2.9f, 2.1f, 4.9f), XMFLOAT3(-1.0f, 0.0f, 0.0f), 0.0f },
+			{ 0.0f, XMFLOAT3(0.0f, 3.0f, 0.0f), XMFLOAT3(0.6f, 0.0f, -0.8f), 0.0f },
+			{ 0.0f, XMFLOAT3(0.5f, 3.5f, 0.5f), Normalize(1.0f, -1.0f, -1.0e-4f), 0.0f },
+			{ 0.0f, XMFLOAT3(1.5f, 4.5f, 1.5f), Normalize(-1.0e-4f, 1.0f, -1.0f), 0.0f }
+		};
+
+		return vector<Vertex>(vertices, vertices + sizeof(vertices) / sizeof(vertices[0]));
+	}
+
+	// Returns the smallest cosine between the input and decoded normals.
+	float CheckRoundTrip(const vector<Vertex>& vertices, const vector<uint8_t>& quantized,
+		const XMFLOAT3& bias, const XMFLOAT3& scale, uint8_t normalBits)
+	{
+		const auto stride = VertexQuantizer::GetStride(normalBits);
+		CHECK(quantized.size() == size_t(stride) * vertices.size());
+
+		auto minDot = 1.0f;
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			XMFLOAT3 position, normal;
+			VertexQuantizer::Dequantize(position, normal, &quantized[stride * i], bias, scale, normalBits);
+
+			// Positions are within half a step, with a little room for the rounding of the scale.
+			const auto& p = vertices[i].Position;
+			CHECK(fabsf(position.x - p.x) <= 0.5001f * scale.x + 1.0e-6f);
+			CHECK(fabsf(position.y - p.y) <= 0.5001f * scale.y + 1.0e-6f);
+			CHECK(fabsf(position.z - p.z) <= 0.5001f * scale.z + 1.0e-6f);
+
+			const auto& n = vertices[i].Normal;
+			CHECK(fabsf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z - 1.0f) < 1.0e-5f);
+			minDot = (min)(normal.x * n.x + normal.y * n.y + normal.z * n.z, minDot);
+		}
+
+		return minDot;
+	}
+
+	void CheckFixedVertices(uint8_t normalBits)
+	{
+		const auto vertices = CreateVertices();
+		const VertexQuantizer quantizer(1);
+		vector<uint8_t> quantized;
+		XMFLOAT3 bias, scale;
+		CHECK(quantizer.Quantize(quantized, bias, scale, reinterpret_cast<const uint8_t*>(vertices.data()), sizeof(Vertex),
+			static_cast<uint32_t>(vertices.size()), PositionOffset, NormalOffset, normalBits));
+
+		// The bounds are (-1, 2, -3) to (3, 6, 5).
+		CHECK(bias.x == -1.0f && bias.y == 2.0f && bias.z == -3.0f);
+		CHECK(scale.x == 4.0f / 65535.0f && scale.y == 4.0f / 65535.0f && scale.z == 8.0f / 65535.0f);
+
+		// The minimum corner is all zeros, the maximum all ones, and (-1, 6, 5) mixes both.
+		const auto words = VertexQuantizer::GetStride(normalBits) / sizeof(uint32_t);
+		CHECK(LoadWord(quantized, 0) == 0 && (LoadWord(quantized, 1) & 0xffff) == 0);
+		CHECK(LoadWord(quantized, words) == 0xffffffff && (LoadWord(quantized, words + 1) & 0xffff) == 0xffff);
+		CHECK(LoadWord(quantized, 3 * words) == 0xffff0000 && (LoadWord(quantized, 3 * words + 1) & 0xffff) == 0xffff);
+
+		const auto minDot = CheckRoundTrip(vertices, quantized, bias, scale, normalBits);
+		CHECK(minDot >= (normalBits == 8 ? MinNormalDot8 : MinNormalDot16));
+	}
+
+	// A flat axis has no extent: its scale is 0, and it decodes exactly.
+	void CheckFlatAxis(uint8_t normalBits)
+	{
+		auto vertices = CreateVertices();
+		for (auto& vertex : vertices) vertex.Position.x = 7.25f;
+
+		const VertexQuantizer quantizer(1);
+		vector<uint8_t> quantized;
+		XMFLOAT3 bias, scale;
+		CHECK(quantizer.Quantize(quantized, bias, scale, reinterpret_cast<const uint8_t*>(vertices.data()), sizeof(Vertex),
+			static_cast<uint32_t>(vertices.size()), PositionOffset, NormalOffset, normalBits));
+		CHECK(bias.x == 7.25f && scale.x == 0.0f);
+
+		const auto stride = VertexQuantizer::GetStride(normalBits);
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			CHECK((LoadWord(quantized, stride / sizeof(uint32_t) * i) & 0xffff) == 0);
+
+			XMFLOAT3 position, normal;
+			VertexQuantizer::Dequantize(position, normal, &quantized[stride * i], bias, scale, normalBits);
+			CHECK(position.x == 7.25f);
+		}
+	}
+
+	// Random normals bound the error of every direction, and the threads must not change the result.
+	void CheckRandomVertices(uint8_t normalBits)
+	{
+		mt19937 rng(5489u);
+		normal_distribution<float> gaussian;
+		vector<Vertex> vertices(10000);
+		for (auto& vertex : vertices)
+		{
+			vertex = { 0.0f, XMFLOAT3(gaussian(rng), gaussian(rng), gaussian(rng)), XMFLOAT3(), 0.0f };
+			XMFLOAT3 n;
+			do n = XMFLOAT3(gaussian(rng), gaussian(rng), gaussian(rng));
+			while (n.x * n.x + n.y * n.y + n.z * n.z < 1.0e-6f);
+			vertex.Normal = Normalize(n.x, n.y, n.z);
+		}
+
+		vector<uint8_t> quantized, quantizedMT;
+		XMFLOAT3 bias, scale, biasMT, scaleMT;
+		const auto pVertices = reinterpret_cast<const uint8_t*>(vertices.data());
+		const auto count = static_cast<uint32_t>(vertices.size());
+		CHECK(VertexQuantizer(1).Quantize(quantized, bias, scale, pVertices, sizeof(Vertex), count, PositionOffset, NormalOffset, normalBits));
+		CHECK(VertexQuantizer(4).Quantize(quantizedMT, biasMT, scaleMT, pVertices, sizeof(Vertex), count, PositionOffset, NormalOffset, normalBits));
+		CHECK(quantized == quantizedMT);
+		CHECK(memcmp(&bias, &biasMT, sizeof(bias)) == 0 && memcmp(&scale, &scaleMT, sizeof(scale)) == 0);
+
+		const auto minDot = CheckRoundTrip(vertices, quantized, bias, scale, normalBits);
+		CHECK(minDot >= (normalBits == 8 ? MinNormalDot8 : MinNormalDot16));
+		printf("%u-bit normals: max error %.4f degrees\n", normalBits, acosf((min)(minDot, 1.0f)) * 180.0f / XM_PI);
+	}
+}
+
+int main()
+{
+	CHECK(VertexQuantizer::GetStride(8) == 8);
+	CHECK(VertexQuantizer::GetStride(16) == 12);
+
+	for (const uint8_t normalBits : { 8, 16 })
+	{
+		CheckFixedVertices(normalBits);
+		CheckFlatAxis(normalBits);
+		CheckRandomVertices(normalBits);
+	}
+
+	// Unsupported normal sizes and attributes past the stride are refused.
+	const auto vertices = CreateVertices();
+	const auto pVertices = reinterpret_cast<const uint8_t*>(vertices.data());
+	const VertexQuantizer quantizer(1);
+	vector<uint8_t> quantized;
+	XMFLOAT3 bias, scale;
+	CHECK(!quantizer.Quantize(quantized, bias, scale, pVertices, sizeof(Vertex), 1, PositionOffset, NormalOffset, 10));
+	CHECK(!quantizer.Quantize(quantized, bias, scale, pVertices, sizeof(Vertex), 1, PositionOffset, sizeof(Vertex) - 8, 8));
+	CHECK(!quantizer.Quantize(quantized, bias, scale, pVertices, sizeof(Vertex), 1, sizeof(Vertex) - 8, NormalOffset, 16));
+
+	printf("Quantization round trips passed\n");
+
+	return 0;
+}
@@ -0,0 +1,30 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Portable stand-in for stdafx.h, force-included into the shared sources built by the checks.
+
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// SharedConst.h aligns its constant buffers for the upload heap with the MSVC spelling, which the
+// checks do not upload.
+#ifndef _MSC_VER
+#define _declspec(x)
+#endif
+
+// Fails the check with the failing expression and its location.
+#define CHECK(x) \
+	do { if (!(x)) { std::fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x); std::exit(1); } } while (false)